@@ -67,6 +67,7 @@ class AVBot(ToxAV):
         super(AVBot, self).__init__(self.core)
 
         self.toxav_video_frame_format_set(self.TOXAV_VIDEO_FRAME_FORMAT_BGR)
+        self.toxav_video_abr_set([(1000, 640, 480, 25), (500, 480, 360, 20), (250, 320, 240, 15), (0, 160, 120, 10)])
 
         self.iterate_thread = threading.Thread(target = self.iterate_cb)
         self.iterate_thread.start()
@@ -145,7 +146,7 @@ class AVBot(ToxAV):
                     for call in itervalues(self.calls):
                         if call.video_enabled:
                             try:
-                                self.toxav_video_send_bgr_frame(call.friend_number, width, height, frame.tostring())
+                                self.toxav_video_send_bgr_frame(call.friend_number, width, height, frame)
                             except ToxAVException as e:
                                 self.core.verbose("ToxAVException: {0}".format(e))
             except Exception as e:
@@ -563,14 +563,17 @@ class EchoBot(ToxCore):
             raise NotImplementedError("Unknown control: {0}".format(control))
 
 
-    def tox_recvfile_cb(self, friend_number, file_number, path, filename, status):
+    def tox_recvfile_cb(self, friend_number, file_number, path, filename, status, digest):
         """
         Контроль выполнения tox_recvfile
 
         Аргументы:
             friend_number (int) -- Номер друга
             file_number   (int) -- Номер файла (случайный номер в рамках передачи)
+            path          (str) -- Путь к файлу
+            filename      (str) -- Имя файла
             status        (int) -- Статус получения файла
+            digest        (str) -- SHA-256 полученных данных или None
         """
         friend_name = self.tox_friend_get_name(friend_number)
 
@@ -582,10 +585,16 @@ class EchoBot(ToxCore):
             if os.path.isfile(path):
                 self.tox_sendfile(friend_number, ToxCore.TOX_FILE_KIND_DATA, path, filename, 60)
 
+        elif status == ToxCore.TOX_RECVFILE_CACHED:
+            self.verbose("recvfile cached to {0}/{1}: number = {2}, digest = {3}".format(friend_name, friend_number, file_number, digest))
+            self.tox_sendfile(friend_number, ToxCore.TOX_FILE_KIND_DATA, path, filename, 60)
+
         elif status == ToxCore.TOX_RECVFILE_TIMEOUT:
             self.verbose("recvfile timeout to {0}/{1}: number = {2}".format(friend_name, friend_number, file_number))
         elif status == ToxCore.TOX_RECVFILE_ERROR:
             self.verbose("recvfile error to {0}/{1}: number = {2}".format(friend_name, friend_number, file_number))
+        elif status == ToxCore.TOX_RECVFILE_CORRUPTED:
+            self.verbose("recvfile corrupted to {0}/{1}: number = {2}, digest = {3}".format(friend_name, friend_number, file_number, digest))
         else:
             raise NotImplementedError("Unknown status: {0}".format(status))
 
@@ -135,6 +135,8 @@ PyMODINIT_FUNC initpytoxcore(void)
     // initialize pytoxav
     //
 
+    toxcolor_init();
+
     ToxAV_install_dict();
 
     if (PyType_Ready(&ToxAVType) < 0) {
@@ -145,6 +147,14 @@ PyMODINIT_FUNC initpytoxcore(void)
     Py_INCREF(&ToxAVType);
     PyModule_AddObject(module, "ToxAV", (PyObject*)&ToxAVType);
 
+    if (PyType_Ready(&ToxAVFrameType) < 0) {
+        fprintf(stderr, "Invalid PyTypeObject 'ToxAVFrameType'\n");
+        goto error;
+    }
+
+    Py_INCREF(&ToxAVFrameType);
+    PyModule_AddObject(module, "ToxAVFrame", (PyObject*)&ToxAVFrameType);
+
     ToxAVException = PyErr_NewException("pytoxcore.ToxAVException", NULL, NULL);
     PyModule_AddObject(module, "ToxAVException", (PyObject*)ToxAVException);
 
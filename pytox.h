@@ -50,10 +50,12 @@
 #endif
 //----------------------------------------------------------------------------------------------
 #if PY_MAJOR_VERSION < 3
+    #define PYSTRING_Check(o)          (PyString_Check(o) || PyUnicode_Check(o))
     #define PYSTRING_FromString        PyString_FromString
     #define PYSTRING_FromStringAndSize PyString_FromStringAndSize
     #define PYBYTES_FromStringAndSize  PyString_FromStringAndSize
 #else
+    #define PYSTRING_Check(o)          PyUnicode_Check(o)
     #define PYSTRING_FromString        PyUnicode_FromString
     #define PYSTRING_FromStringAndSize PyUnicode_FromStringAndSize
     #define PYBYTES_FromStringAndSize  PyBytes_FromStringAndSize
@@ -18,6 +18,8 @@
  */
 //----------------------------------------------------------------------------------------------
 #include "pytoxav.h"
+#include <structmember.h>
+#include <time.h>
 //----------------------------------------------------------------------------------------------
 #define CHECK_TOXAV(self)                                        \
     if ((self)->av == NULL) {                                    \
@@ -28,203 +30,547 @@
 PyObject* ToxAVException;
 //----------------------------------------------------------------------------------------------
 
-inline static uint8_t rgb_to_y(int r, int g, int b)
+static pthread_mutex_t* mutex_alloc(void)
 {
-    int y = ((9798 * r + 19235 * g + 3736 * b) >> 15);
-    return y > 255 ? 255 : y < 0 ? 0 : y;
+    pthread_mutex_t* mutex = NULL;
+
+    mutex = malloc(sizeof(pthread_mutex_t));
+    if (mutex == NULL)
+        return NULL;
+
+    if (pthread_mutex_init(mutex, NULL) != 0) {
+        free(mutex);
+        return NULL;
+    }
+
+    return mutex;
 }
 //----------------------------------------------------------------------------------------------
 
-inline static uint8_t rgb_to_u(int r, int g, int b)
+static void mutex_free(pthread_mutex_t* mutex)
 {
-    int u = ((-5538 * r + -10846 * g + 16351 * b) >> 15) + 128;
-    return u > 255 ? 255 : u < 0 ? 0 : u;
+    pthread_mutex_destroy(mutex);
+    free(mutex);
 }
 //----------------------------------------------------------------------------------------------
 
-inline static uint8_t rgb_to_v(int r, int g, int b)
+static uint64_t av_clock(void)
 {
-    int v = ((16351 * r + -13697 * g + -2664 * b) >> 15) + 128;
-    return v > 255 ? 255 : v < 0 ? 0 : v;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 //----------------------------------------------------------------------------------------------
 
-static void bgr_to_yuv420(uint8_t* plane_y, uint8_t* plane_u, uint8_t* plane_v, uint8_t* bgr, uint16_t width, uint16_t height)
+inline static vpx_image_t* vpx_image_realloc(vpx_image_t* image, uint32_t width, uint32_t height)
 {
-    uint16_t x;
-    uint16_t y;
-    uint8_t* p;
-    uint8_t  b;
-    uint8_t  g;
-    uint8_t  r;
+    if (image == NULL || image->d_w != width || image->d_h != height) {
+        vpx_img_free(image);
+        return vpx_img_alloc(NULL, VPX_IMG_FMT_I420, width, height, 1);
+    }
+
+    return image;
+}
+//----------------------------------------------------------------------------------------------
 
-    for (y = 0; y != height; y += 2) {
-        p = bgr;
-        for (x = 0; x != width; x++) {
-            b = *bgr++;
-            g = *bgr++;
-            r = *bgr++;
+static bool video_frame_format_color(TOXAV_VIDEO_FRAME_FORMAT format, TOXCOLOR_FORMAT* color)
+{
+    switch (format) {
+        case TOXAV_VIDEO_FRAME_FORMAT_BGR:
+            *color = TOXCOLOR_FORMAT_BGR;
+            return true;
+        case TOXAV_VIDEO_FRAME_FORMAT_RGB:
+            *color = TOXCOLOR_FORMAT_RGB;
+            return true;
+        case TOXAV_VIDEO_FRAME_FORMAT_BGRA:
+            *color = TOXCOLOR_FORMAT_BGRA;
+            return true;
+        case TOXAV_VIDEO_FRAME_FORMAT_RGBA:
+            *color = TOXCOLOR_FORMAT_RGBA;
+            return true;
+        default:
+            return false;
+    }
+}
+//----------------------------------------------------------------------------------------------
 
-            *plane_y++ = rgb_to_y(r, g, b);
-        }
+static ToxAVFramePool* frame_pool_new(size_t limit)
+{
+    ToxAVFramePool* pool = malloc(sizeof(ToxAVFramePool));
+    if (pool == NULL)
+        return NULL;
+
+    memset(pool, 0, sizeof(ToxAVFramePool));
 
-        for (x = 0; x != width / 2; x++) {
-            b = *bgr++;
-            g = *bgr++;
-            r = *bgr++;
+    if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
+        free(pool);
+        return NULL;
+    }
 
-            *plane_y++ = rgb_to_y(r, g, b);
+    pool->refs  = 1;
+    pool->limit = limit;
 
-            b = *bgr++;
-            g = *bgr++;
-            r = *bgr++;
+    return pool;
+}
+//----------------------------------------------------------------------------------------------
 
-            *plane_y++ = rgb_to_y(r, g, b);
+static void frame_pool_trim(ToxAVFramePool* pool, size_t keep)
+{
+    while (pool->idle_count > keep) {
+        pool->idle_count--;
+        free(pool->idle[pool->idle_count]);
+    }
 
-            b = ((int)b + (int)*(bgr - 6) + (int)*p + (int)*(p + 3) + 2) / 4; p++;
-            g = ((int)g + (int)*(bgr - 5) + (int)*p + (int)*(p + 3) + 2) / 4; p++;
-            r = ((int)r + (int)*(bgr - 4) + (int)*p + (int)*(p + 3) + 2) / 4; p++;
+    if (pool->idle_count == 0) {
+        free(pool->idle);
+        pool->idle = NULL;
+    }
+}
+//----------------------------------------------------------------------------------------------
 
-            *plane_u++ = rgb_to_u(r, g, b);
-            *plane_v++ = rgb_to_v(r, g, b);
+static void frame_pool_ref(ToxAVFramePool* pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->refs++;
+    pthread_mutex_unlock(&pool->mutex);
+}
+//----------------------------------------------------------------------------------------------
 
-            p += 3;
-        }
+static void frame_pool_unref(ToxAVFramePool* pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+
+    pool->refs--;
+    if (pool->refs > 0) {
+        pthread_mutex_unlock(&pool->mutex);
+        return;
     }
+
+    frame_pool_trim(pool, 0);
+
+    pthread_mutex_unlock(&pool->mutex);
+    pthread_mutex_destroy(&pool->mutex);
+
+    free(pool);
 }
 //----------------------------------------------------------------------------------------------
 
-static void rgb_to_yuv420(uint8_t* plane_y, uint8_t* plane_u, uint8_t* plane_v, uint8_t* rgb, uint16_t width, uint16_t height)
+static uint8_t* frame_pool_acquire(ToxAVFramePool* pool, size_t size)
 {
-    uint16_t x;
-    uint16_t y;
-    uint8_t* p;
-    uint8_t  r;
-    uint8_t  g;
-    uint8_t  b;
+    uint8_t* data = NULL;
 
-    for (y = 0; y != height; y += 2) {
-        p = rgb;
-        for (x = 0; x != width; x++) {
-            r = *rgb++;
-            g = *rgb++;
-            b = *rgb++;
+    pthread_mutex_lock(&pool->mutex);
 
-            *plane_y++ = rgb_to_y(r, g, b);
-        }
+    // resolution changed - idle buffers are of no use anymore
+    if (pool->size != size) {
+        frame_pool_trim(pool, 0);
+        pool->size = size;
+    }
 
-        for (x = 0; x != width / 2; x++) {
-            r = *rgb++;
-            g = *rgb++;
-            b = *rgb++;
+    if (pool->idle_count > 0) {
+        pool->idle_count--;
+        data = pool->idle[pool->idle_count];
+    }
 
-            *plane_y++ = rgb_to_y(r, g, b);
+    pthread_mutex_unlock(&pool->mutex);
 
-            r = *rgb++;
-            g = *rgb++;
-            b = *rgb++;
+    if (data == NULL)
+        data = malloc(size);
 
-            *plane_y++ = rgb_to_y(r, g, b);
+    return data;
+}
+//----------------------------------------------------------------------------------------------
 
-            r = ((int)b + (int)*(rgb - 6) + (int)*p + (int)*(p + 3) + 2) / 4; p++;
-            g = ((int)g + (int)*(rgb - 5) + (int)*p + (int)*(p + 3) + 2) / 4; p++;
-            b = ((int)r + (int)*(rgb - 4) + (int)*p + (int)*(p + 3) + 2) / 4; p++;
+static void frame_pool_release(ToxAVFramePool* pool, uint8_t* data, size_t size)
+{
+    pthread_mutex_lock(&pool->mutex);
 
-            *plane_u++ = rgb_to_u(r, g, b);
-            *plane_v++ = rgb_to_v(r, g, b);
+    if (pool->size == size && pool->idle_count < pool->limit) {
+        if (pool->idle == NULL)
+            pool->idle = malloc(pool->limit * sizeof(uint8_t*));
 
-            p += 3;
+        if (pool->idle != NULL) {
+            pool->idle[pool->idle_count] = data;
+            pool->idle_count++;
+            data = NULL;
         }
     }
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    free(data);
 }
 //----------------------------------------------------------------------------------------------
 
-static void yuv420_to_bgr(uint16_t width, uint16_t height, const uint8_t* y, const uint8_t* u, const uint8_t* v, unsigned int ystride, unsigned int ustride, unsigned int vstride, uint8_t* bgr)
+static void frame_pool_limit(ToxAVFramePool* pool, size_t limit)
 {
-    unsigned long int i;
-    unsigned long int j;
+    pthread_mutex_lock(&pool->mutex);
 
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            uint8_t* point = bgr + 3 * ((i * width) + j);
+    frame_pool_trim(pool, limit);
 
-            int t_y = y[((i * ystride) + j)];
-            int t_u = u[(((i / 2) * ustride) + (j / 2))];
-            int t_v = v[(((i / 2) * vstride) + (j / 2))];
+    // idle array was sized for the previous limit
+    if (pool->idle != NULL && limit > pool->limit) {
+        uint8_t** idle = realloc(pool->idle, limit * sizeof(uint8_t*));
+        if (idle != NULL)
+            pool->idle = idle;
+        else
+            limit = pool->limit;
+    }
 
-            t_y = t_y < 16 ? 16 : t_y;
+    pool->limit = limit;
 
-            int b = (298 * (t_y - 16) + 516 * (t_u - 128) + 128) >> 8;
-            int g = (298 * (t_y - 16) - 100 * (t_u - 128) - 208 * (t_v - 128) + 128) >> 8;
-            int r = (298 * (t_y - 16) + 409 * (t_v - 128) + 128) >> 8;
+    pthread_mutex_unlock(&pool->mutex);
+}
+//----------------------------------------------------------------------------------------------
 
-            point[0] = b > 255 ? 255 : b < 0 ? 0 : b;
-            point[1] = g > 255 ? 255 : g < 0 ? 0 : g;
-            point[2] = r > 255 ? 255 : r < 0 ? 0 : r;
+static ToxAVCall* av_call_new(uint32_t friend_number, size_t pool_limit)
+{
+    ToxAVCall* call = malloc(sizeof(ToxAVCall));
+    if (call == NULL)
+        return NULL;
+
+    memset(call, 0, sizeof(ToxAVCall));
+
+    call->friend_number = friend_number;
+    call->refs          = 1;
+    call->rung          = SIZE_MAX;
+
+    call->pool = frame_pool_new(pool_limit);
+    if (call->pool == NULL)
+        goto ERROR_POOL;
+
+    if (pthread_mutex_init(&call->send_mutex, NULL) != 0)
+        goto ERROR_SEND;
+
+    if (pthread_mutex_init(&call->recv_mutex, NULL) != 0)
+        goto ERROR_RECV;
+
+    return call;
+
+ERROR_RECV:
+    pthread_mutex_destroy(&call->send_mutex);
+ERROR_SEND:
+    frame_pool_unref(call->pool);
+ERROR_POOL:
+    free(call);
+
+    return NULL;
+}
+//----------------------------------------------------------------------------------------------
+
+static void av_call_free(ToxAVCall* call)
+{
+    pthread_mutex_destroy(&call->send_mutex);
+    pthread_mutex_destroy(&call->recv_mutex);
+
+    vpx_img_free(call->frame);
+    free(call->rgb);
+
+    // frames still held by Python keep the pool alive, but it stops keeping buffers
+    frame_pool_limit(call->pool, 0);
+    frame_pool_unref(call->pool);
+
+    free(call);
+}
+//----------------------------------------------------------------------------------------------
+
+static void av_call_unref(ToxCoreAV* self, ToxAVCall* call)
+{
+    pthread_mutex_lock(self->calls_mutex);
+    size_t refs = --call->refs;
+    pthread_mutex_unlock(self->calls_mutex);
+
+    if (refs == 0)
+        av_call_free(call);
+}
+//----------------------------------------------------------------------------------------------
+
+// calls_mutex must be held, the call is not referenced
+static ToxAVCall* av_calls_find(ToxCoreAV* self, uint32_t friend_number)
+{
+    size_t i;
+    for (i = 0; i < self->calls_count; i++)
+        if (self->calls[i]->friend_number == friend_number)
+            return self->calls[i];
+
+    return NULL;
+}
+//----------------------------------------------------------------------------------------------
+
+/**
+ * Find the buffers of a call with friend (creating them if asked to). Returned call is
+ * referenced by the caller and must be released with av_call_unref.
+ */
+static ToxAVCall* av_calls_get(ToxCoreAV* self, uint32_t friend_number, bool create, bool* created)
+{
+    pthread_mutex_lock(self->calls_mutex);
+
+    ToxAVCall* call = av_calls_find(self, friend_number);
+
+    if (created != NULL)
+        *created = false;
+
+    if (call == NULL && create == true) {
+        ToxAVCall** calls = realloc(self->calls, (self->calls_count + 1) * sizeof(ToxAVCall*));
+        if (calls != NULL) {
+            self->calls = calls;
+
+            call = av_call_new(friend_number, self->pool_limit);
+            if (call != NULL) {
+                self->calls[self->calls_count] = call;
+                self->calls_count++;
+
+                if (created != NULL)
+                    *created = true;
+            }
         }
     }
+
+    if (call != NULL)
+        call->refs++;
+
+    pthread_mutex_unlock(self->calls_mutex);
+
+    return call;
 }
 //----------------------------------------------------------------------------------------------
 
-static void yuv420_to_rgb(uint16_t width, uint16_t height, const uint8_t* y, const uint8_t* u, const uint8_t* v, unsigned int ystride, unsigned int ustride, unsigned int vstride, uint8_t* rgb)
+static void av_calls_remove(ToxCoreAV* self, uint32_t friend_number)
 {
-    unsigned long int i;
-    unsigned long int j;
+    ToxAVCall* call = NULL;
 
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            uint8_t* point = rgb + 3 * ((i * width) + j);
+    pthread_mutex_lock(self->calls_mutex);
 
-            int t_y = y[((i * ystride) + j)];
-            int t_u = u[(((i / 2) * ustride) + (j / 2))];
-            int t_v = v[(((i / 2) * vstride) + (j / 2))];
+    size_t i;
+    for (i = 0; i < self->calls_count; i++)
+        if (self->calls[i]->friend_number == friend_number) {
+            call = self->calls[i];
+
+            self->calls_count--;
+            self->calls[i] = self->calls[self->calls_count];
+            break;
+        }
 
-            t_y = t_y < 16 ? 16 : t_y;
+    pthread_mutex_unlock(self->calls_mutex);
 
-            int r = (298 * (t_y - 16) + 409 * (t_v - 128) + 128) >> 8;
-            int g = (298 * (t_y - 16) - 100 * (t_u - 128) - 208 * (t_v - 128) + 128) >> 8;
-            int b = (298 * (t_y - 16) + 516 * (t_u - 128) + 128) >> 8;
+    // threads still converting a frame of this call free it when done
+    if (call != NULL)
+        av_call_unref(self, call);
+}
+//----------------------------------------------------------------------------------------------
 
-            point[0] = r > 255 ? 255 : r < 0 ? 0 : r;
-            point[1] = g > 255 ? 255 : g < 0 ? 0 : g;
-            point[2] = b > 255 ? 255 : b < 0 ? 0 : b;
+static void av_calls_clear(ToxCoreAV* self)
+{
+    while (self->calls_count > 0)
+        av_calls_remove(self, self->calls[self->calls_count - 1]->friend_number);
+
+    free(self->calls);
+
+    self->calls = NULL;
+}
+//----------------------------------------------------------------------------------------------
+
+/**
+ * Adaptive bit rate controller. Every call follows the ladder rung matching its video bit rate:
+ * congestion events lower the rate and step down at once, while probes raise the rate back by
+ * abr_margin percent every abr_hold and step up one rung at a time, only after abr_hold passed
+ * since the last step and with abr_margin percent over the rung bit rate. All of it runs under
+ * calls_mutex, toxav itself is never called with calls_mutex held.
+ */
+static void abr_rung_select(ToxCoreAV* self, ToxAVCall* call, uint64_t now)
+{
+    size_t rung = 0;
+    while (rung + 1 < self->abr_count && call->bit_rate < self->abr[rung].bit_rate)
+        rung++;
+
+    if (call->rung < self->abr_count && rung < call->rung) {
+        uint64_t threshold = (uint64_t)self->abr[call->rung - 1].bit_rate * (100 + self->abr_margin);
+
+        // probing stops at the configured rate, reaching it counts as meeting the margin
+        if (call->bit_rate_max > 0)
+            threshold = MIN(threshold, (uint64_t)call->bit_rate_max * 100);
+
+        if (now - call->rung_time < self->abr_hold || (uint64_t)call->bit_rate * 100 < threshold)
+            return;
+
+        rung = call->rung - 1;
+    }
+
+    if (rung == call->rung)
+        return;
+
+    call->rung           = rung;
+    call->rung_time      = now;
+    call->send_width     = self->abr[rung].width;
+    call->send_height    = self->abr[rung].height;
+    call->frame_interval = (self->abr[rung].fps > 0 ? 1000000 / self->abr[rung].fps : 0);
+}
+//----------------------------------------------------------------------------------------------
+
+// drops the rung (and the send size and frame rate it set), picking a new one if enabled
+static void abr_rung_reset(ToxCoreAV* self, ToxAVCall* call)
+{
+    call->rung           = SIZE_MAX;
+    call->send_width     = 0;
+    call->send_height    = 0;
+    call->frame_interval = 0;
+
+    if (self->abr_count > 0 && call->bit_rate > 0)
+        abr_rung_select(self, call, av_clock());
+}
+//----------------------------------------------------------------------------------------------
+
+// video bit rate set by the application becomes both the current rate and the probing ceiling
+static void abr_bit_rate_set(ToxCoreAV* self, uint32_t friend_number, uint32_t bit_rate)
+{
+    pthread_mutex_lock(self->calls_mutex);
+
+    ToxAVCall* call = av_calls_find(self, friend_number);
+    if (call != NULL) {
+        call->bit_rate     = bit_rate;
+        call->bit_rate_max = bit_rate;
+        call->probe_time   = av_clock();
+
+        // a manual send size is kept unless the controller owns it
+        if (self->abr_count > 0)
+            abr_rung_reset(self, call);
+    }
+
+    pthread_mutex_unlock(self->calls_mutex);
+}
+//----------------------------------------------------------------------------------------------
+
+// updates the video bit rate to apply for a congestion event, false when the controller is off
+static bool abr_congestion(ToxCoreAV* self, uint32_t friend_number, int32_t* bit_rate)
+{
+    bool result = false;
+
+    pthread_mutex_lock(self->calls_mutex);
+
+    ToxAVCall* call = av_calls_find(self, friend_number);
+
+    if (self->abr_count > 0 && call != NULL) {
+        // audio only calls keep video off, and video is never switched off otherwise
+        if (call->bit_rate_max == 0)
+            *bit_rate = -1;
+        else {
+            uint64_t now = av_clock();
+
+            call->bit_rate   = MAX(MIN((uint32_t)*bit_rate, call->bit_rate_max), 1);
+            call->probe_time = now;
+
+            abr_rung_select(self, call, now);
+
+            *bit_rate = call->bit_rate;
         }
+
+        result = true;
     }
+
+    pthread_mutex_unlock(self->calls_mutex);
+
+    return result;
 }
 //----------------------------------------------------------------------------------------------
 
-static pthread_mutex_t* mutex_alloc(void)
+static void abr_probe(ToxCoreAV* self)
 {
-    pthread_mutex_t* mutex = NULL;
+    uint32_t friend_number = 0;
+    uint32_t bit_rate      = 0;
 
-    mutex = malloc(sizeof(pthread_mutex_t));
-    if (mutex == NULL)
-        return NULL;
+    pthread_mutex_lock(self->calls_mutex);
 
-    if (pthread_mutex_init(mutex, NULL) != 0) {
-        free(mutex);
-        return NULL;
+    if (self->abr_count > 0) {
+        uint64_t now = av_clock();
+
+        // one call per iteration is plenty with probes abr_hold apart
+        size_t i;
+        for (i = 0; i < self->calls_count; i++) {
+            ToxAVCall* call = self->calls[i];
+
+            if (call->bit_rate >= call->bit_rate_max || now - call->probe_time < self->abr_hold)
+                continue;
+
+            call->bit_rate   = MIN((uint64_t)call->bit_rate * (100 + self->abr_margin) / 100 + 1, call->bit_rate_max);
+            call->probe_time = now;
+
+            abr_rung_select(self, call, now);
+
+            friend_number = call->friend_number;
+            bit_rate      = call->bit_rate;
+            break;
+        }
     }
 
-    return mutex;
+    pthread_mutex_unlock(self->calls_mutex);
+
+    if (bit_rate > 0)
+        toxav_bit_rate_set(self->av, friend_number, -1, bit_rate, NULL);
 }
 //----------------------------------------------------------------------------------------------
 
-static void mutex_free(pthread_mutex_t* mutex)
+// calls_mutex must be held
+static bool av_call_skip_frame(ToxAVCall* call)
 {
-    pthread_mutex_destroy(mutex);
-    free(mutex);
+    if (call->frame_interval == 0)
+        return false;
+
+    uint64_t now = av_clock();
+
+    // a quarter of the interval absorbs capture jitter
+    if (now + call->frame_interval / 4 < call->frame_due)
+        return true;
+
+    // a stalled source does not get a burst of frames afterwards
+    call->frame_due = MAX(call->frame_due, now - MIN(now, call->frame_interval / 2)) + call->frame_interval;
+
+    return false;
 }
 //----------------------------------------------------------------------------------------------
 
-inline static vpx_image_t* vpx_image_realloc(vpx_image_t* image, uint32_t width, uint32_t height)
+static void callback_video_receive_pooled(ToxCoreAV* self, ToxAVCall* call, TOXCOLOR_FORMAT format, uint16_t width, uint16_t height, const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t ystride, uint32_t ustride, uint32_t vstride)
 {
-    if (image == NULL || image->d_w != width || image->d_h != height) {
-        vpx_img_free(image);
-        return vpx_img_alloc(NULL, VPX_IMG_FMT_I420, width, height, 1);
+    size_t bpp  = toxcolor_format_bpp(format);
+    size_t size = (size_t)width * height * bpp;
+
+    ToxAVFramePool* pool = call->pool;
+    frame_pool_ref(pool);
+
+    uint8_t* data = frame_pool_acquire(pool, size);
+    if (data == NULL) {
+        frame_pool_unref(pool);
+        return;
     }
 
-    return image;
+    toxcolor_from_yuv420(toxcolor_kernel, format, width, height, y, u, v, ystride, ustride, vstride, data, bpp * width);
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+
+    ToxAVFrame* frame = (ToxAVFrame*)ToxAVFrameType.tp_alloc(&ToxAVFrameType, 0);
+    if (frame != NULL) {
+        // frame owns the buffer and the pool reference from now on
+        frame->pool       = pool;
+        frame->data       = data;
+        frame->size       = size;
+        frame->width      = width;
+        frame->height     = height;
+        frame->shape[0]   = height;
+        frame->shape[1]   = width;
+        frame->shape[2]   = bpp;
+        frame->strides[0] = bpp * width;
+        frame->strides[1] = bpp;
+        frame->strides[2] = 1;
+
+        PyObject_CallMethod((PyObject*)self, "toxav_video_receive_frame_cb", "IIIO", call->friend_number, width, height, frame);
+
+        Py_DECREF(frame);
+    } else {
+        frame_pool_release(pool, data, size);
+        frame_pool_unref(pool);
+    }
+
+    PyGILState_Release(gil);
 }
 //----------------------------------------------------------------------------------------------
 
@@ -238,6 +584,9 @@ static void callback_call(ToxAV* av, uint32_t friend_number, bool audio_enabled,
 
 static void callback_call_state(ToxAV* av, uint32_t friend_number, uint32_t state, void* self)
 {
+    if (state == TOXAV_FRIEND_CALL_STATE_FINISHED || state == TOXAV_FRIEND_CALL_STATE_ERROR)
+        av_calls_remove((ToxCoreAV*)self, friend_number);
+
     PyGILState_STATE gil = PyGILState_Ensure();
     PyObject_CallMethod((PyObject*)self, "toxav_call_state_cb", "II", friend_number, state);
     PyGILState_Release(gil);
@@ -246,6 +595,11 @@ static void callback_call_state(ToxAV* av, uint32_t friend_number, uint32_t stat
 
 static void callback_bit_rate_status(ToxAV* av, uint32_t friend_number, uint32_t audio_bit_rate, uint32_t video_bit_rate, void* self)
 {
+    // toxav mutex is recursive, so the suggestion is applied right from its own event
+    int32_t bit_rate = video_bit_rate;
+    if (abr_congestion((ToxCoreAV*)self, friend_number, &bit_rate))
+        toxav_bit_rate_set(av, friend_number, audio_bit_rate, bit_rate, NULL);
+
     PyGILState_STATE gil = PyGILState_Ensure();
     PyObject_CallMethod((PyObject*)self, "toxav_bit_rate_status_cb", "III", friend_number, audio_bit_rate, video_bit_rate);
     PyGILState_Release(gil);
@@ -270,36 +624,47 @@ static void callback_video_receive_frame(ToxAV* av, uint32_t friend_number, uint
     uint32_t ustride_abs = abs(ustride);
     uint32_t vstride_abs = abs(vstride);
 
-    if (av_self->format == TOXAV_VIDEO_FRAME_FORMAT_BGR ||
-        av_self->format == TOXAV_VIDEO_FRAME_FORMAT_RGB) {
+    TOXCOLOR_FORMAT format;
 
-        size_t size = width * height * 3;
+    if (video_frame_format_color(av_self->format, &format) == true) {
+        ToxAVCall* call = av_calls_get(av_self, friend_number, false, NULL);
+        if (call == NULL)
+            return;
 
-        pthread_mutex_lock(av_self->rgb_mutex);
+        if (av_self->pool_limit > 0) {
+            callback_video_receive_pooled(av_self, call, format, width, height, y, u, v, ystride_abs, ustride_abs, vstride_abs);
+            av_call_unref(av_self, call);
+            return;
+        }
+
+        size_t bpp  = toxcolor_format_bpp(format);
+        size_t size = width * height * bpp;
 
-        if (av_self->rgb_size != size || av_self->rgb == NULL) {
-            uint8_t* rgb = realloc(av_self->rgb, size);
+        pthread_mutex_lock(&call->recv_mutex);
+
+        if (call->rgb_size != size || call->rgb == NULL) {
+            uint8_t* rgb = realloc(call->rgb, size);
             if (rgb != NULL) {
-                av_self->rgb      = rgb;
-                av_self->rgb_size = size;
+                call->rgb      = rgb;
+                call->rgb_size = size;
             } else {
-                pthread_mutex_unlock(av_self->rgb_mutex);
+                pthread_mutex_unlock(&call->recv_mutex);
+                av_call_unref(av_self, call);
                 return;
             }
         }
 
-        if (av_self->format == TOXAV_VIDEO_FRAME_FORMAT_BGR)
-            yuv420_to_bgr(width, height, y, u, v, ystride_abs, ustride_abs, vstride_abs, av_self->rgb);
-        else if (av_self->format == TOXAV_VIDEO_FRAME_FORMAT_RGB)
-            yuv420_to_rgb(width, height, y, u, v, ystride_abs, ustride_abs, vstride_abs, av_self->rgb);
+        toxcolor_from_yuv420(toxcolor_kernel, format, width, height, y, u, v, ystride_abs, ustride_abs, vstride_abs, call->rgb, bpp * width);
 
         PyGILState_STATE gil = PyGILState_Ensure();
 
-        PyObject_CallMethod((PyObject*)self, "toxav_video_receive_frame_cb", "III" BUF_TCS, friend_number, width, height, av_self->rgb, av_self->rgb_size);
+        PyObject_CallMethod((PyObject*)self, "toxav_video_receive_frame_cb", "III" BUF_TCS, friend_number, width, height, call->rgb, call->rgb_size);
 
-        pthread_mutex_unlock(av_self->rgb_mutex);
+        pthread_mutex_unlock(&call->recv_mutex);
 
         PyGILState_Release(gil);
+
+        av_call_unref(av_self, call);
     } else if (av_self->format == TOXAV_VIDEO_FRAME_FORMAT_YUV420) {
         uint32_t width_half  = width / 2;
         uint32_t height_half = height / 2;
@@ -372,26 +737,17 @@ static PyObject* ToxAV_toxav_kill(ToxCoreAV* self, PyObject* args)
         self->core = NULL;
     }
 
-    if (self->frame != NULL) {
-        vpx_img_free(self->frame);
-        self->frame = NULL;
-    }
+    if (self->calls_mutex != NULL) {
+        av_calls_clear(self);
 
-    if (self->frame_mutex != NULL) {
-        mutex_free(self->frame_mutex);
-        self->frame_mutex = NULL;
+        mutex_free(self->calls_mutex);
+        self->calls_mutex = NULL;
     }
 
-    if (self->rgb != NULL) {
-        free(self->rgb);
-        self->rgb      = NULL;
-        self->rgb_size = 0;
-    }
+    free(self->abr);
 
-    if (self->rgb_mutex != NULL) {
-        mutex_free(self->rgb_mutex);
-        self->rgb_mutex = NULL;
-    }
+    self->abr       = NULL;
+    self->abr_count = 0;
 
     Py_RETURN_NONE;
 }
@@ -419,6 +775,7 @@ static PyObject* ToxAV_toxav_iterate(ToxCoreAV* self, PyObject* args)
 
     PyThreadState* gil = PyEval_SaveThread();
     toxav_iterate(self->av);
+    abr_probe(self);
     PyEval_RestoreThread(gil);
 
     if (PyErr_Occurred() != NULL)
@@ -441,9 +798,22 @@ static PyObject* ToxAV_toxav_call(ToxCoreAV* self, PyObject* args)
 
     PyThreadState* gil = PyEval_SaveThread();
 
+    // buffers must exist before the first frame of the call may arrive
+    bool       created;
+    ToxAVCall* call = av_calls_get(self, friend_number, true, &created);
+
     TOXAV_ERR_CALL error;
     bool result = toxav_call(self->av, friend_number, audio_bit_rate, video_bit_rate, &error);
 
+    // failed call attempt must not tear down a call already in progress
+    if (call != NULL) {
+        av_call_unref(self, call);
+        if (result == false && created == true)
+            av_calls_remove(self, friend_number);
+        else if (result == true)
+            abr_bit_rate_set(self, friend_number, video_bit_rate);
+    }
+
     PyEval_RestoreThread(gil);
 
     bool success = false;
@@ -491,9 +861,22 @@ static PyObject* ToxAV_toxav_answer(ToxCoreAV* self, PyObject* args)
 
     PyThreadState* gil = PyEval_SaveThread();
 
+    // buffers must exist before the first frame of the call may arrive
+    bool       created;
+    ToxAVCall* call = av_calls_get(self, friend_number, true, &created);
+
     TOXAV_ERR_ANSWER error;
     bool result = toxav_answer(self->av, friend_number, audio_bit_rate, video_bit_rate, &error);
 
+    // failed call attempt must not tear down a call already in progress
+    if (call != NULL) {
+        av_call_unref(self, call);
+        if (result == false && created == true)
+            av_calls_remove(self, friend_number);
+        else if (result == true)
+            abr_bit_rate_set(self, friend_number, video_bit_rate);
+    }
+
     PyEval_RestoreThread(gil);
 
     bool success = false;
@@ -540,6 +923,9 @@ static PyObject* ToxAV_toxav_call_control(ToxCoreAV* self, PyObject* args)
     TOXAV_ERR_CALL_CONTROL error;
     bool result = toxav_call_control(self->av, friend_number, control, &error);
 
+    if (result == true && control == TOXAV_CALL_CONTROL_CANCEL)
+        av_calls_remove(self, friend_number);
+
     PyEval_RestoreThread(gil);
 
     bool success = false;
@@ -584,6 +970,10 @@ static PyObject* ToxAV_toxav_bit_rate_set(ToxCoreAV* self, PyObject* args)
     TOXAV_ERR_BIT_RATE_SET error;
     bool result = toxav_bit_rate_set(self->av, friend_number, audio_bit_rate, video_bit_rate, &error);
 
+    // -1 leaves the video bit rate as is
+    if (result == true && (int32_t)video_bit_rate >= 0)
+        abr_bit_rate_set(self, friend_number, video_bit_rate);
+
     PyEval_RestoreThread(gil);
 
     bool success = false;
@@ -629,6 +1019,10 @@ static PyObject* ToxAV_toxav_video_frame_format_set(ToxCoreAV* self, PyObject* a
         self->format = TOXAV_VIDEO_FRAME_FORMAT_RGB;
     else if (format == TOXAV_VIDEO_FRAME_FORMAT_YUV420)
         self->format = TOXAV_VIDEO_FRAME_FORMAT_YUV420;
+    else if (format == TOXAV_VIDEO_FRAME_FORMAT_BGRA)
+        self->format = TOXAV_VIDEO_FRAME_FORMAT_BGRA;
+    else if (format == TOXAV_VIDEO_FRAME_FORMAT_RGBA)
+        self->format = TOXAV_VIDEO_FRAME_FORMAT_RGBA;
     else {
         PyErr_SetString(ToxAVException, "Unknown video frame format.");
         return NULL;
@@ -638,6 +1032,171 @@ static PyObject* ToxAV_toxav_video_frame_format_set(ToxCoreAV* self, PyObject* a
 }
 //----------------------------------------------------------------------------------------------
 
+static PyObject* ToxAV_toxav_video_frame_pool_set(ToxCoreAV* self, PyObject* args)
+{
+    CHECK_TOXAV(self);
+
+    uint32_t limit;
+    if (PyArg_ParseTuple(args, "I", &limit) == false)
+        return NULL;
+
+    pthread_mutex_lock(self->calls_mutex);
+
+    self->pool_limit = limit;
+
+    size_t i;
+    for (i = 0; i < self->calls_count; i++)
+        frame_pool_limit(self->calls[i]->pool, limit);
+
+    pthread_mutex_unlock(self->calls_mutex);
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxAV_toxav_video_send_size_set(ToxCoreAV* self, PyObject* args)
+{
+    CHECK_TOXAV(self);
+
+    uint32_t friend_number;
+    uint32_t width;
+    uint32_t height;
+
+    if (PyArg_ParseTuple(args, "III", &friend_number, &width, &height) == false)
+        return NULL;
+
+    if ((width == 0) != (height == 0)) {
+        PyErr_SetString(ToxAVException, "Invalid send size - both width and height must be zero or non zero.");
+        return NULL;
+    }
+
+    pthread_mutex_lock(self->calls_mutex);
+
+    ToxAVCall* call = av_calls_find(self, friend_number);
+    if (call != NULL) {
+        call->send_width  = width;
+        call->send_height = height;
+    }
+
+    pthread_mutex_unlock(self->calls_mutex);
+
+    if (call == NULL) {
+        PyErr_SetString(ToxAVException, "This client is currently not in a call with the friend.");
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static int abr_rung_compare(const void* a, const void* b)
+{
+    uint32_t x = ((const ToxAVRung*)a)->bit_rate;
+    uint32_t y = ((const ToxAVRung*)b)->bit_rate;
+
+    // descending bit rate
+    return (x < y) - (x > y);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxAV_toxav_video_abr_set(ToxCoreAV* self, PyObject* args)
+{
+    CHECK_TOXAV(self);
+
+    PyObject* ladder;
+    uint32_t  margin = TOXAV_ABR_MARGIN;
+    uint32_t  hold   = TOXAV_ABR_HOLD;
+
+    if (PyArg_ParseTuple(args, "O|II", &ladder, &margin, &hold) == false)
+        return NULL;
+
+    PyObject*  seq   = NULL;
+    ToxAVRung* abr   = NULL;
+    size_t     count = 0;
+
+    if (ladder != Py_None) {
+        seq = PySequence_Fast(ladder, "Invalid ladder - must be a sequence of (bit_rate, width, height, fps) tuples.");
+        if (seq == NULL)
+            return NULL;
+
+        count = PySequence_Fast_GET_SIZE(seq);
+
+        if (count > 0) {
+            abr = calloc(count, sizeof(ToxAVRung));
+            if (abr == NULL) {
+                PyErr_SetString(ToxAVException, "A resource allocation error occurred while trying to allocate bit rate ladder.");
+                goto ERROR;
+            }
+        }
+
+        size_t i;
+        for (i = 0; i < count; i++) {
+            ToxAVRung* rung = &abr[i];
+
+            if (PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, i), "IIII", &rung->bit_rate, &rung->width, &rung->height, &rung->fps) == false)
+                goto ERROR;
+
+            if ((rung->width == 0) != (rung->height == 0)) {
+                PyErr_SetString(ToxAVException, "Invalid rung size - both width and height must be zero or non zero.");
+                goto ERROR;
+            }
+        }
+
+        Py_DECREF(seq);
+
+        qsort(abr, count, sizeof(ToxAVRung), abr_rung_compare);
+    }
+
+    pthread_mutex_lock(self->calls_mutex);
+
+    ToxAVRung* old = self->abr;
+
+    self->abr        = abr;
+    self->abr_count  = count;
+    self->abr_margin = margin;
+    self->abr_hold   = (uint64_t)hold * 1000;
+
+    size_t i;
+    for (i = 0; i < self->calls_count; i++)
+        abr_rung_reset(self, self->calls[i]);
+
+    pthread_mutex_unlock(self->calls_mutex);
+
+    free(old);
+
+    Py_RETURN_NONE;
+
+ERROR:
+    Py_DECREF(seq);
+    free(abr);
+
+    return NULL;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxAV_toxav_video_threads_set(ToxCoreAV* self, PyObject* args)
+{
+    uint32_t threads;
+    uint32_t threshold = TOXCOLOR_POOL_THRESHOLD;
+
+    if (PyArg_ParseTuple(args, "I|I", &threads, &threshold) == false)
+        return NULL;
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    bool result = toxcolor_threads_set(threads, threshold);
+
+    PyEval_RestoreThread(gil);
+
+    if (result == false) {
+        PyErr_SetString(ToxAVException, "A resource allocation error occurred while trying to start conversion threads.");
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
 static PyObject* parse_TOXAV_ERR_SEND_FRAME(bool result, TOXAV_ERR_SEND_FRAME error)
 {
     bool success = false;
@@ -767,6 +1326,16 @@ static PyObject* ToxAV_toxav_video_send_yuv420_frame(ToxCoreAV* self, PyObject*
         return NULL;
     }
 
+    pthread_mutex_lock(self->calls_mutex);
+
+    ToxAVCall* call = av_calls_find(self, friend_number);
+    bool       skip = (call != NULL && av_call_skip_frame(call));
+
+    pthread_mutex_unlock(self->calls_mutex);
+
+    if (skip)
+        Py_RETURN_NONE;
+
     PyThreadState* gil = PyEval_SaveThread();
 
     TOXAV_ERR_SEND_FRAME error;
@@ -778,17 +1347,160 @@ static PyObject* ToxAV_toxav_video_send_yuv420_frame(ToxCoreAV* self, PyObject*
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxAV_toxav_video_send_bgr_frame(ToxCoreAV* self, PyObject* args)
+/**
+ * Find the row stride of a frame of packed bpp byte pixels exposed with buffer protocol. Accepts
+ * flat buffers, (height, width * bpp) and (height, width, bpp) arrays with any (even negative)
+ * row stride. Returns false when pixels of a row are not adjacent and a contiguous copy is needed.
+ */
+static bool video_buffer_stride(const Py_buffer* view, uint32_t width, uint32_t height, size_t bpp, ptrdiff_t* stride)
+{
+    if (view->strides == NULL || PyBuffer_IsContiguous((Py_buffer*)view, 'C')) {
+        *stride = bpp * width;
+        return true;
+    }
+
+    if (view->ndim == 2 && view->shape[0] == height && view->shape[1] == bpp * width && view->strides[1] == 1) {
+        *stride = view->strides[0];
+        return true;
+    }
+
+    if (view->ndim == 3 && view->shape[0] == height && view->shape[1] == width && view->shape[2] == bpp &&
+        view->strides[1] == bpp && view->strides[2] == 1) {
+        *stride = view->strides[0];
+        return true;
+    }
+
+    return false;
+}
+//----------------------------------------------------------------------------------------------
+
+static void video_send_size(const ToxAVCall* call, const ToxAVVideoSource* source, uint32_t width, uint32_t height, uint32_t* send_width, uint32_t* send_height)
+{
+    *send_width  = width;
+    *send_height = height;
+
+    // only packed RGB goes through the scaler, frames are never scaled up
+    if (source->layout != TOXAV_VIDEO_SOURCE_PACKED || source->format == TOXCOLOR_FORMAT_YUYV || call->send_width == 0)
+        return;
+
+    if (width <= call->send_width && height <= call->send_height)
+        return;
+
+    // fit into the bounding box keeping the aspect ratio
+    if ((uint64_t)width * call->send_height > (uint64_t)height * call->send_width) {
+        *send_width  = call->send_width;
+        *send_height = MAX((uint64_t)height * call->send_width / width, 1);
+    } else {
+        *send_width  = MAX((uint64_t)width * call->send_height / height, 1);
+        *send_height = call->send_height;
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* video_send_source(ToxCoreAV* self, uint32_t friend_number, uint32_t width, uint32_t height, const ToxAVVideoSource* source)
 {
+    ToxAVCall* call = av_calls_get(self, friend_number, false, NULL);
+    if (call == NULL) {
+        PyErr_SetString(ToxAVException, "This client is currently not in a call with the friend.");
+        return NULL;
+    }
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    pthread_mutex_lock(&call->send_mutex);
+
+    uint32_t send_width;
+    uint32_t send_height;
+
+    pthread_mutex_lock(self->calls_mutex);
+
+    bool skip = av_call_skip_frame(call);
+    video_send_size(call, source, width, height, &send_width, &send_height);
+
+    pthread_mutex_unlock(self->calls_mutex);
+
+    // dropped before any conversion work
+    if (skip) {
+        pthread_mutex_unlock(&call->send_mutex);
+        av_call_unref(self, call);
+
+        PyEval_RestoreThread(gil);
+
+        Py_RETURN_NONE;
+    }
+
+    call->frame = vpx_image_realloc(call->frame, send_width, send_height);
+
+    vpx_image_t*         image   = call->frame;
+    bool                 scaled  = true;
+    bool                 success = false;
+    TOXAV_ERR_SEND_FRAME error;
+
+    if (image != NULL) {
+        uint8_t* y = image->planes[VPX_PLANE_Y];
+        uint8_t* u = image->planes[VPX_PLANE_U];
+        uint8_t* v = image->planes[VPX_PLANE_V];
+
+        uint32_t ystride = image->stride[VPX_PLANE_Y];
+        uint32_t ustride = image->stride[VPX_PLANE_U];
+        uint32_t vstride = image->stride[VPX_PLANE_V];
+
+        switch (source->layout) {
+            case TOXAV_VIDEO_SOURCE_PACKED:
+                if (send_width != width || send_height != height)
+                    scaled = toxcolor_scale_to_yuv420(toxcolor_kernel, source->format, width, height, source->planes[0], source->strides[0], send_width, send_height, y, u, v, ystride, ustride, vstride);
+                else
+                    toxcolor_to_yuv420(toxcolor_kernel, source->format, width, height, source->planes[0], source->strides[0], y, u, v, ystride, ustride, vstride);
+                break;
+            case TOXAV_VIDEO_SOURCE_NV12:
+                toxcolor_nv12_to_yuv420(toxcolor_kernel, width, height, source->planes[0], source->planes[1], source->strides[0], source->strides[1], y, u, v, ystride, ustride, vstride);
+                break;
+            case TOXAV_VIDEO_SOURCE_I422:
+                toxcolor_i422_to_yuv420(toxcolor_kernel, width, height, source->planes[0], source->planes[1], source->planes[2], source->strides[0], source->strides[1], source->strides[2], y, u, v, ystride, ustride, vstride);
+                break;
+        }
+
+        if (scaled)
+            success = toxav_video_send_frame(self->av, friend_number, send_width, send_height, y, u, v, &error);
+    }
+
+    pthread_mutex_unlock(&call->send_mutex);
+    av_call_unref(self, call);
+
+    PyEval_RestoreThread(gil);
+
+    if (image == NULL) {
+        PyErr_SetString(ToxAVException, "A resource allocation error occurred while trying to allocate image frame.");
+        return NULL;
+    }
+
+    if (scaled == false) {
+        PyErr_SetString(ToxAVException, "A resource allocation error occurred while trying to allocate scaler rows.");
+        return NULL;
+    }
+
+    return parse_TOXAV_ERR_SEND_FRAME(success, error);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* video_send_packed_frame(ToxCoreAV* self, PyObject* args, TOXCOLOR_FORMAT format)
+{
+    static const char* names[TOXCOLOR_FORMAT_COUNT] = {
+        [TOXCOLOR_FORMAT_BGR]  = "BGR",
+        [TOXCOLOR_FORMAT_RGB]  = "RGB",
+        [TOXCOLOR_FORMAT_BGRA] = "BGRA",
+        [TOXCOLOR_FORMAT_RGBA] = "RGBA",
+        [TOXCOLOR_FORMAT_YUYV] = "YUYV"
+    };
+
     CHECK_TOXAV(self);
 
-    uint32_t   friend_number;
-    uint32_t   width;
-    uint32_t   height;
-    uint8_t*   bgr;
-    Py_ssize_t bgr_len;
+    uint32_t  friend_number;
+    uint32_t  width;
+    uint32_t  height;
+    PyObject* frame;
 
-    if (PyArg_ParseTuple(args, "IIIs#", &friend_number, &width, &height, &bgr, &bgr_len) == false)
+    if (PyArg_ParseTuple(args, "IIIO", &friend_number, &width, &height, &frame) == false)
         return NULL;
 
     if (width < 1 || width > 0xFFFF) {
@@ -801,51 +1513,96 @@ static PyObject* ToxAV_toxav_video_send_bgr_frame(ToxCoreAV* self, PyObject* arg
         return NULL;
     }
 
-    if (bgr_len != 3 * width * height) {
-        PyErr_SetString(ToxAVException, "Invalid BGR size - must be height * width * 3.");
+    // YUYV pixel pairs share chroma
+    if (format == TOXCOLOR_FORMAT_YUYV && width % 2 != 0) {
+        PyErr_SetString(ToxAVException, "Invalid width - must be even for YUYV frame.");
         return NULL;
     }
 
-    PyThreadState* gil = PyEval_SaveThread();
+    size_t bpp = toxcolor_format_bpp(format);
 
-    pthread_mutex_lock(self->frame_mutex);
+    Py_buffer view;
+    if (PyObject_GetBuffer(frame, &view, PyBUF_STRIDES | PyBUF_FORMAT) != 0)
+        return NULL;
 
-    self->frame = vpx_image_realloc(self->frame, width, height);
+    PyObject* result = NULL;
+    uint8_t*  copy   = NULL;
 
-    if (self->frame == NULL) {
-        pthread_mutex_unlock(self->frame_mutex);
+    if (view.itemsize != 1 || view.len != (Py_ssize_t)bpp * width * height) {
+        PyErr_Format(ToxAVException, "Invalid %s size - must be height * width * %u bytes.", names[format], (unsigned)bpp);
+        goto EXIT;
+    }
 
-        PyEval_RestoreThread(gil);
+    const uint8_t* pixels = view.buf;
+    ptrdiff_t      stride;
 
-        PyErr_SetString(ToxAVException, "A resource allocation error occurred while trying to allocate image frame.");
+    if (video_buffer_stride(&view, width, height, bpp, &stride) == false) {
+        copy = malloc(view.len);
+        if (copy == NULL) {
+            PyErr_NoMemory();
+            goto EXIT;
+        }
 
-        return NULL;
+        if (PyBuffer_ToContiguous(copy, &view, view.len, 'C') != 0)
+            goto EXIT;
+
+        pixels = copy;
+        stride = bpp * width;
     }
 
-    bgr_to_yuv420(self->frame->planes[0], self->frame->planes[1], self->frame->planes[2], bgr, self->frame->d_w, self->frame->d_h);
+    ToxAVVideoSource source = { TOXAV_VIDEO_SOURCE_PACKED, format, { pixels, NULL, NULL }, { stride, 0, 0 } };
 
-    TOXAV_ERR_SEND_FRAME error;
-    bool result = toxav_video_send_frame(self->av, friend_number, self->frame->d_w, self->frame->d_h, self->frame->planes[0], self->frame->planes[1], self->frame->planes[2], &error);
+    result = video_send_source(self, friend_number, width, height, &source);
 
-    pthread_mutex_unlock(self->frame_mutex);
+EXIT:
+    free(copy);
+    PyBuffer_Release(&view);
 
-    PyEval_RestoreThread(gil);
+    return result;
+}
+//----------------------------------------------------------------------------------------------
 
-    return parse_TOXAV_ERR_SEND_FRAME(result, error);
+static PyObject* ToxAV_toxav_video_send_bgr_frame(ToxCoreAV* self, PyObject* args)
+{
+    return video_send_packed_frame(self, args, TOXCOLOR_FORMAT_BGR);
 }
 //----------------------------------------------------------------------------------------------
 
 static PyObject* ToxAV_toxav_video_send_rgb_frame(ToxCoreAV* self, PyObject* args)
+{
+    return video_send_packed_frame(self, args, TOXCOLOR_FORMAT_RGB);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxAV_toxav_video_send_bgra_frame(ToxCoreAV* self, PyObject* args)
+{
+    return video_send_packed_frame(self, args, TOXCOLOR_FORMAT_BGRA);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxAV_toxav_video_send_rgba_frame(ToxCoreAV* self, PyObject* args)
+{
+    return video_send_packed_frame(self, args, TOXCOLOR_FORMAT_RGBA);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxAV_toxav_video_send_yuyv_frame(ToxCoreAV* self, PyObject* args)
+{
+    return video_send_packed_frame(self, args, TOXCOLOR_FORMAT_YUYV);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxAV_toxav_video_send_nv12_frame(ToxCoreAV* self, PyObject* args)
 {
     CHECK_TOXAV(self);
 
-    uint32_t   friend_number;
-    uint32_t   width;
-    uint32_t   height;
-    uint8_t*   rgb;
-    Py_ssize_t rgb_len;
+    uint32_t  friend_number;
+    uint32_t  width;
+    uint32_t  height;
+    PyObject* y;
+    PyObject* uv;
 
-    if (PyArg_ParseTuple(args, "IIIs#", &friend_number, &width, &height, &rgb, &rgb_len) == false)
+    if (PyArg_ParseTuple(args, "IIIOO", &friend_number, &width, &height, &y, &uv) == false)
         return NULL;
 
     if (width < 1 || width > 0xFFFF) {
@@ -858,37 +1615,100 @@ static PyObject* ToxAV_toxav_video_send_rgb_frame(ToxCoreAV* self, PyObject* arg
         return NULL;
     }
 
-    if (rgb_len != 3 * width * height) {
-        PyErr_SetString(ToxAVException, "Invalid RGB size - must be height * width * 3.");
-        return NULL;
+    uint32_t cw = (width + 1) / 2;
+    uint32_t ch = (height + 1) / 2;
+
+    Py_buffer views[2];
+    memset(views, 0, sizeof(views));
+
+    PyObject* result = NULL;
+
+    if (PyObject_GetBuffer(y, &views[0], PyBUF_SIMPLE) != 0 || PyObject_GetBuffer(uv, &views[1], PyBUF_SIMPLE) != 0)
+        goto EXIT;
+
+    if (views[0].len != (Py_ssize_t)width * height) {
+        PyErr_SetString(ToxAVException, "Invalid Y-plane size - must be height * width.");
+        goto EXIT;
     }
 
-    PyThreadState* gil = PyEval_SaveThread();
+    if (views[1].len != (Py_ssize_t)2 * cw * ch) {
+        PyErr_SetString(ToxAVException, "Invalid UV-plane size - must be ((height + 1) / 2) * ((width + 1) / 2) * 2.");
+        goto EXIT;
+    }
 
-    pthread_mutex_lock(self->frame_mutex);
+    ToxAVVideoSource source = { TOXAV_VIDEO_SOURCE_NV12, TOXCOLOR_FORMAT_COUNT, { views[0].buf, views[1].buf, NULL }, { width, 2 * cw, 0 } };
 
-    self->frame = vpx_image_realloc(self->frame, width, height);
+    result = video_send_source(self, friend_number, width, height, &source);
 
-    if (self->frame == NULL) {
-        pthread_mutex_unlock(self->frame_mutex);
+EXIT:
+    PyBuffer_Release(&views[0]);
+    PyBuffer_Release(&views[1]);
 
-        PyEval_RestoreThread(gil);
+    return result;
+}
+//----------------------------------------------------------------------------------------------
 
-        PyErr_SetString(ToxAVException, "A resource allocation error occurred while trying to allocate image frame.");
+static PyObject* ToxAV_toxav_video_send_i422_frame(ToxCoreAV* self, PyObject* args)
+{
+    CHECK_TOXAV(self);
+
+    uint32_t  friend_number;
+    uint32_t  width;
+    uint32_t  height;
+    PyObject* y;
+    PyObject* u;
+    PyObject* v;
+
+    if (PyArg_ParseTuple(args, "IIIOOO", &friend_number, &width, &height, &y, &u, &v) == false)
+        return NULL;
+
+    if (width < 1 || width > 0xFFFF) {
+        PyErr_SetString(ToxAVException, "Invalid width - must be 16 bit unsigned.");
+        return NULL;
+    }
 
+    if (height < 1 || height > 0xFFFF) {
+        PyErr_SetString(ToxAVException, "Invalid height - must be 16 bit unsigned.");
         return NULL;
     }
 
-    rgb_to_yuv420(self->frame->planes[0], self->frame->planes[1], self->frame->planes[2], rgb, self->frame->d_w, self->frame->d_h);
+    uint32_t cw = (width + 1) / 2;
 
-    TOXAV_ERR_SEND_FRAME error;
-    bool result = toxav_video_send_frame(self->av, friend_number, self->frame->d_w, self->frame->d_h, self->frame->planes[0], self->frame->planes[1], self->frame->planes[2], &error);
+    Py_buffer views[3];
+    memset(views, 0, sizeof(views));
 
-    pthread_mutex_unlock(self->frame_mutex);
+    PyObject* result = NULL;
 
-    PyEval_RestoreThread(gil);
+    if (PyObject_GetBuffer(y, &views[0], PyBUF_SIMPLE) != 0 ||
+        PyObject_GetBuffer(u, &views[1], PyBUF_SIMPLE) != 0 ||
+        PyObject_GetBuffer(v, &views[2], PyBUF_SIMPLE) != 0)
+        goto EXIT;
 
-    return parse_TOXAV_ERR_SEND_FRAME(result, error);
+    if (views[0].len != (Py_ssize_t)width * height) {
+        PyErr_SetString(ToxAVException, "Invalid Y-plane size - must be height * width.");
+        goto EXIT;
+    }
+
+    if (views[1].len != (Py_ssize_t)cw * height) {
+        PyErr_SetString(ToxAVException, "Invalid U-plane size - must be height * ((width + 1) / 2).");
+        goto EXIT;
+    }
+
+    if (views[2].len != (Py_ssize_t)cw * height) {
+        PyErr_SetString(ToxAVException, "Invalid V-plane size - must be height * ((width + 1) / 2).");
+        goto EXIT;
+    }
+
+    ToxAVVideoSource source = { TOXAV_VIDEO_SOURCE_I422, TOXCOLOR_FORMAT_COUNT, { views[0].buf, views[1].buf, views[2].buf }, { width, cw, cw } };
+
+    result = video_send_source(self, friend_number, width, height, &source);
+
+EXIT:
+    PyBuffer_Release(&views[0]);
+    PyBuffer_Release(&views[1]);
+    PyBuffer_Release(&views[2]);
+
+    return result;
 }
 //----------------------------------------------------------------------------------------------
 
@@ -1011,6 +1831,33 @@ PyMethodDef ToxAV_methods[] = {
         "toxav_video_frame_format_set(format)\n"
         "Set the video frame format passed to toxav_video_receive_frame_cb."
     },
+    {
+        "toxav_video_frame_pool_set", (PyCFunction)ToxAV_toxav_video_frame_pool_set, METH_VARARGS,
+        "toxav_video_frame_pool_set(size)\n"
+        "Pass packed frames to toxav_video_receive_frame_cb as ToxAVFrame buffer protocol objects "
+        "backed by per call pools keeping up to size recycled buffers. Zero (default) disables pools."
+    },
+    {
+        "toxav_video_send_size_set", (PyCFunction)ToxAV_toxav_video_send_size_set, METH_VARARGS,
+        "toxav_video_send_size_set(friend_number, width, height)\n"
+        "Scale BGR, RGB, BGRA and RGBA frames sent to the friend down to fit into width x height keeping "
+        "the aspect ratio, bilinear scaling is fused with the YUV420 conversion. Zero size (default) disables scaling. "
+        "Overridden by toxav_video_abr_set when enabled."
+    },
+    {
+        "toxav_video_abr_set", (PyCFunction)ToxAV_toxav_video_abr_set, METH_VARARGS,
+        "toxav_video_abr_set(ladder[, margin[, hold]])\n"
+        "Apply bit rates suggested by toxav_bit_rate_status_cb automatically and follow the ladder of "
+        "(bit_rate, width, height, fps) rungs: the send size and frame rate of the highest rung not above "
+        "the video bit rate are used. Rates are probed back up by margin percent (20 by default) every hold "
+        "milliseconds (5000 by default) without congestion, stepping up one rung at a time. None disables it."
+    },
+    {
+        "toxav_video_threads_set", (PyCFunction)ToxAV_toxav_video_threads_set, METH_VARARGS | METH_STATIC,
+        "toxav_video_threads_set(threads[, threshold])\n"
+        "Set the number of worker threads used to convert video frames of at least threshold pixels "
+        "(1280 * 720 by default) by row bands. Zero threads (default) disables the pool."
+    },
     {
         "toxav_audio_send_frame", (PyCFunction)ToxAV_toxav_audio_send_frame, METH_VARARGS,
         "toxav_audio_send_frame(friend_number, pcm, sample_count, channels, sampling_rate)\n"
@@ -1036,12 +1883,39 @@ PyMethodDef ToxAV_methods[] = {
     {
         "toxav_video_send_bgr_frame", (PyCFunction)ToxAV_toxav_video_send_bgr_frame, METH_VARARGS,
         "toxav_video_send_bgr_frame(friend_number, width, height, bgr)\n"
-        "Send a BGR video frame to a friend."
+        "Send a BGR video frame to a friend. Frame may be any buffer protocol object (bytes, memoryview, "
+        "numpy array) of height * width * 3 bytes, rows may be padded or views non-contiguous."
     },
     {
         "toxav_video_send_rgb_frame", (PyCFunction)ToxAV_toxav_video_send_rgb_frame, METH_VARARGS,
         "toxav_video_send_rgb_frame(friend_number, width, height, rgb)\n"
-        "Send a RGB video frame to a friend."
+        "Send a RGB video frame to a friend. Frame may be any buffer protocol object (bytes, memoryview, "
+        "numpy array) of height * width * 3 bytes, rows may be padded or views non-contiguous."
+    },
+    {
+        "toxav_video_send_bgra_frame", (PyCFunction)ToxAV_toxav_video_send_bgra_frame, METH_VARARGS,
+        "toxav_video_send_bgra_frame(friend_number, width, height, bgra)\n"
+        "Send a BGRA (BGRX) video frame of height * width * 4 bytes to a friend, alpha is ignored."
+    },
+    {
+        "toxav_video_send_rgba_frame", (PyCFunction)ToxAV_toxav_video_send_rgba_frame, METH_VARARGS,
+        "toxav_video_send_rgba_frame(friend_number, width, height, rgba)\n"
+        "Send a RGBA (RGBX) video frame of height * width * 4 bytes to a friend, alpha is ignored."
+    },
+    {
+        "toxav_video_send_yuyv_frame", (PyCFunction)ToxAV_toxav_video_send_yuyv_frame, METH_VARARGS,
+        "toxav_video_send_yuyv_frame(friend_number, width, height, yuyv)\n"
+        "Send a YUYV (YUY2) video frame of height * width * 2 bytes to a friend, width must be even."
+    },
+    {
+        "toxav_video_send_nv12_frame", (PyCFunction)ToxAV_toxav_video_send_nv12_frame, METH_VARARGS,
+        "toxav_video_send_nv12_frame(friend_number, width, height, y, uv)\n"
+        "Send a NV12 video frame (Y plane and interleaved UV plane) to a friend."
+    },
+    {
+        "toxav_video_send_i422_frame", (PyCFunction)ToxAV_toxav_video_send_i422_frame, METH_VARARGS,
+        "toxav_video_send_i422_frame(friend_number, width, height, y, u, v)\n"
+        "Send a planar YUV 4:2:2 video frame to a friend."
     },
     {
         NULL
@@ -1092,12 +1966,8 @@ static int init_helper(ToxCoreAV* self, PyObject* args)
 
     Py_INCREF(self->core);
 
-    self->frame_mutex = mutex_alloc();
-    if (self->frame_mutex == NULL)
-        return -1;
-
-    self->rgb_mutex = mutex_alloc();
-    if (self->rgb_mutex == NULL)
+    self->calls_mutex = mutex_alloc();
+    if (self->calls_mutex == NULL)
         return -1;
 
     toxav_callback_call(av, callback_call, self);
@@ -1116,12 +1986,15 @@ static PyObject* ToxAV_new(PyTypeObject* type, PyObject* args, PyObject* kwds)
 
     self->av          = NULL;
     self->core        = NULL;
-    self->frame       = NULL;
-    self->frame_mutex = NULL;
     self->format      = TOXAV_VIDEO_FRAME_FORMAT_BGR;
-    self->rgb         = NULL;
-    self->rgb_mutex   = NULL;
-    self->rgb_size    = 0;
+    self->calls       = NULL;
+    self->calls_count = 0;
+    self->calls_mutex = NULL;
+    self->pool_limit  = 0;
+    self->abr         = NULL;
+    self->abr_count   = 0;
+    self->abr_margin  = TOXAV_ABR_MARGIN;
+    self->abr_hold    = TOXAV_ABR_HOLD * 1000;
 
     if (init_helper(self, args) == -1)
         return NULL;
@@ -1144,6 +2017,100 @@ static int ToxAV_dealloc(ToxCoreAV* self)
 }
 //----------------------------------------------------------------------------------------------
 
+static int ToxAVFrame_getbuffer(ToxAVFrame* self, Py_buffer* view, int flags)
+{
+    // rows are never padded, so any request (contiguous or not) can be served
+    view->obj        = (PyObject*)self;
+    view->buf        = self->data;
+    view->len        = self->size;
+    view->readonly   = 0;
+    view->itemsize   = 1;
+    view->format     = ((flags & PyBUF_FORMAT) == PyBUF_FORMAT ? (char*)"B" : NULL);
+    view->ndim       = ((flags & PyBUF_ND) == PyBUF_ND ? 3 : 1);
+    view->shape      = ((flags & PyBUF_ND) == PyBUF_ND ? self->shape : NULL);
+    view->strides    = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL);
+    view->suboffsets = NULL;
+    view->internal   = NULL;
+
+    Py_INCREF(self);
+
+    return 0;
+}
+//----------------------------------------------------------------------------------------------
+
+static void ToxAVFrame_dealloc(ToxAVFrame* self)
+{
+    if (self->pool != NULL) {
+        frame_pool_release(self->pool, self->data, self->size);
+        frame_pool_unref(self->pool);
+    } else
+        free(self->data);
+
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyBufferProcs ToxAVFrame_as_buffer = {
+#if PY_MAJOR_VERSION < 3
+    0,                                          /* bf_getreadbuffer  */
+    0,                                          /* bf_getwritebuffer */
+    0,                                          /* bf_getsegcount    */
+    0,                                          /* bf_getcharbuffer  */
+#endif
+    (getbufferproc)ToxAVFrame_getbuffer,        /* bf_getbuffer      */
+    0                                           /* bf_releasebuffer  */
+};
+//----------------------------------------------------------------------------------------------
+
+static PyMemberDef ToxAVFrame_members[] = {
+    {"width",  T_UINT, offsetof(ToxAVFrame, width),  READONLY, "Frame width"},
+    {"height", T_UINT, offsetof(ToxAVFrame, height), READONLY, "Frame height"},
+    {NULL}
+};
+//----------------------------------------------------------------------------------------------
+
+PyTypeObject ToxAVFrameType = {
+#if PY_MAJOR_VERSION >= 3
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /* ob_size           */
+#endif
+    "ToxAVFrame",                               /* tp_name           */
+    sizeof(ToxAVFrame),                         /* tp_basicsize      */
+    0,                                          /* tp_itemsize       */
+    (destructor)ToxAVFrame_dealloc,             /* tp_dealloc        */
+    0,                                          /* tp_print          */
+    0,                                          /* tp_getattr        */
+    0,                                          /* tp_setattr        */
+    0,                                          /* tp_compare        */
+    0,                                          /* tp_repr           */
+    0,                                          /* tp_as_number      */
+    0,                                          /* tp_as_sequence    */
+    0,                                          /* tp_as_mapping     */
+    0,                                          /* tp_hash           */
+    0,                                          /* tp_call           */
+    0,                                          /* tp_str            */
+    0,                                          /* tp_getattro       */
+    0,                                          /* tp_setattro       */
+    &ToxAVFrame_as_buffer,                      /* tp_as_buffer      */
+#if PY_MAJOR_VERSION >= 3
+    Py_TPFLAGS_DEFAULT,                         /* tp_flags          */
+#else
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /* tp_flags      */
+#endif
+    "ToxAV received video frame",               /* tp_doc            */
+    0,                                          /* tp_traverse       */
+    0,                                          /* tp_clear          */
+    0,                                          /* tp_richcompare    */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter           */
+    0,                                          /* tp_iternext       */
+    0,                                          /* tp_methods        */
+    ToxAVFrame_members,                         /* tp_members        */
+};
+//----------------------------------------------------------------------------------------------
+
 PyTypeObject ToxAVType = {
 #if PY_MAJOR_VERSION >= 3
     PyVarObject_HEAD_INIT(NULL, 0)
@@ -1230,6 +2197,8 @@ void ToxAV_install_dict(void)
     SET(TOXAV_VIDEO_FRAME_FORMAT_BGR);
     SET(TOXAV_VIDEO_FRAME_FORMAT_RGB);
     SET(TOXAV_VIDEO_FRAME_FORMAT_YUV420);
+    SET(TOXAV_VIDEO_FRAME_FORMAT_BGRA);
+    SET(TOXAV_VIDEO_FRAME_FORMAT_RGBA);
 
 #undef SET
 
@@ -21,26 +21,97 @@
 #define _pytoxav_h_
 //----------------------------------------------------------------------------------------------
 #include "pytoxcore.h"
+#include "pytoxcolor.h"
+//----------------------------------------------------------------------------------------------
+// adaptive bit rate defaults: percent over a rung bit rate to step up to it, ms between steps up
+#define TOXAV_ABR_MARGIN 20
+#define TOXAV_ABR_HOLD   5000
 //----------------------------------------------------------------------------------------------
 typedef enum {
     TOXAV_VIDEO_FRAME_FORMAT_BGR,
     TOXAV_VIDEO_FRAME_FORMAT_RGB,
-    TOXAV_VIDEO_FRAME_FORMAT_YUV420
+    TOXAV_VIDEO_FRAME_FORMAT_YUV420,
+    TOXAV_VIDEO_FRAME_FORMAT_BGRA,
+    TOXAV_VIDEO_FRAME_FORMAT_RGBA
 } TOXAV_VIDEO_FRAME_FORMAT;
 //----------------------------------------------------------------------------------------------
+typedef enum {
+    TOXAV_VIDEO_SOURCE_PACKED,
+    TOXAV_VIDEO_SOURCE_NV12,
+    TOXAV_VIDEO_SOURCE_I422
+} TOXAV_VIDEO_SOURCE;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    TOXAV_VIDEO_SOURCE layout;
+    TOXCOLOR_FORMAT    format;       // packed layout only
+    const uint8_t*     planes[3];
+    ptrdiff_t          strides[3];
+} ToxAVVideoSource;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    pthread_mutex_t mutex;
+    size_t          refs;         // owner plus every frame handed to Python
+    size_t          limit;        // idle buffers kept for reuse
+    size_t          size;         // size of idle buffers
+    uint8_t**       idle;
+    size_t          idle_count;
+} ToxAVFramePool;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    PyObject_HEAD
+    ToxAVFramePool* pool;
+    uint8_t*        data;
+    size_t          size;
+    uint32_t        width;
+    uint32_t        height;
+    Py_ssize_t      shape[3];
+    Py_ssize_t      strides[3];
+} ToxAVFrame;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    uint32_t        bit_rate;     // lowest video bit rate of the rung, kbit/s
+    uint32_t        width;        // send bounding box, 0 keeps the frame size
+    uint32_t        height;
+    uint32_t        fps;          // send frame rate limit, 0 sends every frame
+} ToxAVRung;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    uint32_t        friend_number;
+    size_t          refs;         // calls list plus every thread using the call, under calls_mutex
+    pthread_mutex_t send_mutex;
+    vpx_image_t*    frame;        // send image, under send_mutex
+    uint32_t        send_width;   // bounding box packed RGB frames are scaled down to, under calls_mutex
+    uint32_t        send_height;
+    uint64_t        frame_interval; // frames sent sooner are skipped, us, under calls_mutex
+    uint64_t        frame_due;
+    uint32_t        bit_rate;     // adaptive bit rate state, under calls_mutex: applied video bit rate
+    uint32_t        bit_rate_max; // rate the call was set up with, probing stops there
+    size_t          rung;         // current rung, SIZE_MAX when not chosen
+    uint64_t        rung_time;    // last rung change, us
+    uint64_t        probe_time;   // last congestion event or probe, us
+    pthread_mutex_t recv_mutex;
+    uint8_t*        rgb;          // receive buffer, under recv_mutex
+    size_t          rgb_size;
+    ToxAVFramePool* pool;
+} ToxAVCall;
+//----------------------------------------------------------------------------------------------
 typedef struct {
     PyObject_HEAD
     ToxAV*                   av;
     ToxCore*                 core;
-    vpx_image_t*             frame;
-    pthread_mutex_t*         frame_mutex;
     TOXAV_VIDEO_FRAME_FORMAT format;
-    uint8_t*                 rgb;
-    pthread_mutex_t*         rgb_mutex;
-    size_t                   rgb_size;
+    ToxAVCall**              calls;
+    size_t                   calls_count;
+    pthread_mutex_t*         calls_mutex;
+    size_t                   pool_limit;
+    ToxAVRung*               abr;          // adaptive bit rate ladder by descending bit rate, under calls_mutex
+    size_t                   abr_count;
+    uint32_t                 abr_margin;   // percent over a rung bit rate to step up to it
+    uint64_t                 abr_hold;     // us between steps up and probes
 } ToxCoreAV;
 //----------------------------------------------------------------------------------------------
 extern PyTypeObject ToxAVType;
+extern PyTypeObject ToxAVFrameType;
 //----------------------------------------------------------------------------------------------
 extern PyObject* ToxAVException;
 //----------------------------------------------------------------------------------------------
@@ -0,0 +1,2194 @@
+/**
+ * pytoxcore
+ *
+ * Copyright (C) 2015 Anton Batenev <antonbatenev@yandex.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+//----------------------------------------------------------------------------------------------
+#include "pytoxcolor.h"
+//----------------------------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/param.h>
+//----------------------------------------------------------------------------------------------
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define TOXCOLOR_X86
+    #include <immintrin.h>
+    #define TOXCOLOR_TARGET_SSE2 __attribute__((target("sse2")))
+    #define TOXCOLOR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define TOXCOLOR_NEON
+    #include <arm_neon.h>
+#endif
+//----------------------------------------------------------------------------------------------
+// BT.601 coefficients in 1.15 fixed point, shared by scalar and vector kernels
+#define TOXCOLOR_Y_R   9798
+#define TOXCOLOR_Y_G   19235
+#define TOXCOLOR_Y_B   3736
+#define TOXCOLOR_U_R  -5538
+#define TOXCOLOR_U_G  -10846
+#define TOXCOLOR_U_B   16351
+#define TOXCOLOR_V_R   16351
+#define TOXCOLOR_V_G  -13697
+#define TOXCOLOR_V_B  -2664
+//----------------------------------------------------------------------------------------------
+// inverse BT.601 (studio swing) in 8.8 fixed point
+#define TOXCOLOR_R_V   409
+#define TOXCOLOR_G_U  -100
+#define TOXCOLOR_G_V  -208
+#define TOXCOLOR_B_U   516
+#define TOXCOLOR_Y_K   298
+//----------------------------------------------------------------------------------------------
+const ToxColorKernel* toxcolor_kernel = NULL;
+//----------------------------------------------------------------------------------------------
+typedef void (*ToxColorBand)(void* ctx, uint32_t first, uint32_t last);
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    ToxColorToYUV420Row   encode;
+    ToxColorFromYUV420Row decode;
+    uint32_t              width;
+    uint32_t              height;
+    uint8_t*              packed;
+    ptrdiff_t             stride;
+    uint8_t*              y;
+    uint8_t*              u;
+    uint8_t*              v;
+    uint32_t              ystride;
+    uint32_t              ustride;
+    uint32_t              vstride;
+} ToxColorFrame;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    const ToxColorKernel* kernel;
+    ToxColorToYUV420Row   encode;
+    uint32_t              bpp;
+    uint32_t              width;
+    uint32_t              height;
+    const uint8_t*        packed;
+    ptrdiff_t             stride;
+    uint32_t              scaled_width;
+    uint32_t              scaled_height;
+    const uint32_t*       offsets;         // horizontal taps, NULL when the width is kept
+    const uint32_t*       weights;
+    uint8_t*              y;
+    uint8_t*              u;
+    uint8_t*              v;
+    uint32_t              ystride;
+    uint32_t              ustride;
+    uint32_t              vstride;
+    bool                  failed;
+} ToxColorScale;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    pthread_mutex_t submit;       // one job at a time, concurrent callers convert on their own thread
+    pthread_mutex_t mutex;
+    pthread_cond_t  wake;
+    pthread_cond_t  done;
+    pthread_t*      threads;
+    size_t          count;
+    uint32_t        threshold;
+    bool            stop;
+    ToxColorBand    run;
+    void*           ctx;
+    uint32_t        rows;
+    uint32_t        bands;
+    uint32_t        next;
+    uint32_t        pending;
+} ToxColorPool;
+//----------------------------------------------------------------------------------------------
+static ToxColorPool toxcolor_pool = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    NULL,
+    0,
+    TOXCOLOR_POOL_THRESHOLD,
+    false,
+    NULL,
+    NULL,
+    0,
+    0,
+    0,
+    0
+};
+//----------------------------------------------------------------------------------------------
+
+inline static uint8_t rgb_to_y(int r, int g, int b)
+{
+    int y = ((TOXCOLOR_Y_R * r + TOXCOLOR_Y_G * g + TOXCOLOR_Y_B * b) >> 15);
+    return y > 255 ? 255 : y < 0 ? 0 : y;
+}
+//----------------------------------------------------------------------------------------------
+
+inline static uint8_t rgb_to_u(int r, int g, int b)
+{
+    int u = ((TOXCOLOR_U_R * r + TOXCOLOR_U_G * g + TOXCOLOR_U_B * b) >> 15) + 128;
+    return u > 255 ? 255 : u < 0 ? 0 : u;
+}
+//----------------------------------------------------------------------------------------------
+
+inline static uint8_t rgb_to_v(int r, int g, int b)
+{
+    int v = ((TOXCOLOR_V_R * r + TOXCOLOR_V_G * g + TOXCOLOR_V_B * b) >> 15) + 128;
+    return v > 255 ? 255 : v < 0 ? 0 : v;
+}
+//----------------------------------------------------------------------------------------------
+
+/**
+ * Reference implementation. Every vector kernel must produce exactly the same output, they
+ * only differ in how many pixels are processed per step and hand the row tail over to it.
+ */
+inline static void scalar_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width, int ri, int bi, int bpp)
+{
+    uint32_t x;
+
+    for (x = 0; x + 1 < width; x += 2) {
+        const uint8_t* a = src0 + x * bpp;
+        const uint8_t* b = src1 + x * bpp;
+
+        y0[x]     = rgb_to_y(a[ri],       a[1],       a[bi]);
+        y0[x + 1] = rgb_to_y(a[bpp + ri], a[bpp + 1], a[bpp + bi]);
+        y1[x]     = rgb_to_y(b[ri],       b[1],       b[bi]);
+        y1[x + 1] = rgb_to_y(b[bpp + ri], b[bpp + 1], b[bpp + bi]);
+
+        int r = (a[ri] + a[bpp + ri] + b[ri] + b[bpp + ri] + 2) >> 2;
+        int g = (a[1]  + a[bpp + 1]  + b[1]  + b[bpp + 1]  + 2) >> 2;
+        int c = (a[bi] + a[bpp + bi] + b[bi] + b[bpp + bi] + 2) >> 2;
+
+        u[x / 2] = rgb_to_u(r, g, c);
+        v[x / 2] = rgb_to_v(r, g, c);
+    }
+
+    // odd width - last chroma sample covers a single column
+    if (x < width) {
+        const uint8_t* a = src0 + x * bpp;
+        const uint8_t* b = src1 + x * bpp;
+
+        y0[x] = rgb_to_y(a[ri], a[1], a[bi]);
+        y1[x] = rgb_to_y(b[ri], b[1], b[bi]);
+
+        int r = (a[ri] + b[ri] + 1) >> 1;
+        int g = (a[1]  + b[1]  + 1) >> 1;
+        int c = (a[bi] + b[bi] + 1) >> 1;
+
+        u[x / 2] = rgb_to_u(r, g, c);
+        v[x / 2] = rgb_to_v(r, g, c);
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_bgr_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    scalar_to_yuv420_row(src0, src1, y0, y1, u, v, width, 2, 0, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_rgb_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    scalar_to_yuv420_row(src0, src1, y0, y1, u, v, width, 0, 2, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_bgra_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    scalar_to_yuv420_row(src0, src1, y0, y1, u, v, width, 2, 0, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_rgba_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    scalar_to_yuv420_row(src0, src1, y0, y1, u, v, width, 0, 2, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_yuyv_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    uint32_t x;
+
+    // chroma is already subsampled horizontally, only rows are averaged
+    for (x = 0; x < width; x += 2) {
+        const uint8_t* a = src0 + 2 * x;
+        const uint8_t* b = src1 + 2 * x;
+
+        y0[x] = a[0];
+        y1[x] = b[0];
+
+        if (x + 1 < width) {
+            y0[x + 1] = a[2];
+            y1[x + 1] = b[2];
+        }
+
+        u[x / 2] = (a[1] + b[1] + 1) >> 1;
+        v[x / 2] = (a[3] + b[3] + 1) >> 1;
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_split_row(const uint8_t* uv, uint8_t* u, uint8_t* v, uint32_t count)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        u[i] = uv[2 * i];
+        v[i] = uv[2 * i + 1];
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_average_row(const uint8_t* a, const uint8_t* b, uint8_t* dst, uint32_t count)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++)
+        dst[i] = (a[i] + b[i] + 1) >> 1;
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_blend_row(const uint8_t* a, const uint8_t* b, uint8_t* dst, uint32_t count, uint32_t weight)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++)
+        dst[i] = (a[i] * (256 - weight) + b[i] * weight + 128) >> 8;
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_resample_row(const uint8_t* src, uint8_t* dst, const uint32_t* offsets, const uint32_t* weights, uint32_t count, uint32_t width, uint32_t bpp)
+{
+    uint32_t i, c;
+
+    for (i = 0; i < count; i++) {
+        const uint8_t* a = src + offsets[i];
+        const uint8_t* b = a + bpp;
+
+        for (c = 0; c < bpp; c++)
+            dst[i * bpp + c] = (a[c] * (256 - weights[i]) + b[c] * weights[i] + 128) >> 8;
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+inline static uint8_t clamp_uint8(int x)
+{
+    return x > 255 ? 255 : x < 0 ? 0 : x;
+}
+//----------------------------------------------------------------------------------------------
+
+inline static void scalar_from_yuv420_pixel(uint8_t* p, int y, int cr, int cg, int cb, int ri, int bi, int bpp)
+{
+    y = TOXCOLOR_Y_K * (y < 16 ? 0 : y - 16);
+
+    p[ri] = clamp_uint8((y + cr) >> 8);
+    p[1]  = clamp_uint8((y + cg) >> 8);
+    p[bi] = clamp_uint8((y + cb) >> 8);
+
+    // decoded frames are opaque
+    if (bpp == 4)
+        p[3] = 255;
+}
+//----------------------------------------------------------------------------------------------
+
+/**
+ * Reference implementation of the decoder. Chroma terms are computed once per sample and
+ * shared by the 2x2 pixels which use it.
+ */
+inline static void scalar_from_yuv420_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width, int ri, int bi, int bpp)
+{
+    uint32_t x;
+
+    for (x = 0; x < width; x += 2) {
+        int cu = u[x / 2] - 128;
+        int cv = v[x / 2] - 128;
+
+        int cr = TOXCOLOR_R_V * cv + 128;
+        int cg = TOXCOLOR_G_U * cu + TOXCOLOR_G_V * cv + 128;
+        int cb = TOXCOLOR_B_U * cu + 128;
+
+        scalar_from_yuv420_pixel(dst0 + x * bpp, y0[x], cr, cg, cb, ri, bi, bpp);
+        scalar_from_yuv420_pixel(dst1 + x * bpp, y1[x], cr, cg, cb, ri, bi, bpp);
+
+        if (x + 1 < width) {
+            scalar_from_yuv420_pixel(dst0 + (x + 1) * bpp, y0[x + 1], cr, cg, cb, ri, bi, bpp);
+            scalar_from_yuv420_pixel(dst1 + (x + 1) * bpp, y1[x + 1], cr, cg, cb, ri, bi, bpp);
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_yuv420_to_bgr_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    scalar_from_yuv420_row(y0, y1, u, v, dst0, dst1, width, 2, 0, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_yuv420_to_rgb_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    scalar_from_yuv420_row(y0, y1, u, v, dst0, dst1, width, 0, 2, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_yuv420_to_bgra_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    scalar_from_yuv420_row(y0, y1, u, v, dst0, dst1, width, 2, 0, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+static void scalar_yuv420_to_rgba_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    scalar_from_yuv420_row(y0, y1, u, v, dst0, dst1, width, 0, 2, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+static bool scalar_supported(void)
+{
+    return true;
+}
+//----------------------------------------------------------------------------------------------
+
+#ifdef TOXCOLOR_X86
+
+#define TOXCOLOR_PAIR(lo, hi) ((int32_t)(((uint32_t)(uint16_t)(hi) << 16) | (uint16_t)(lo)))
+
+TOXCOLOR_TARGET_SSE2
+inline static void sse2_load_rgb24(const uint8_t* p, __m128i* c0, __m128i* c1, __m128i* c2)
+{
+    // deinterleave 16 packed 3-byte pixels with unpacks only (no pshufb in SSE2)
+    __m128i t00 = _mm_loadu_si128((const __m128i*)p);
+    __m128i t01 = _mm_loadu_si128((const __m128i*)(p + 16));
+    __m128i t02 = _mm_loadu_si128((const __m128i*)(p + 32));
+
+    __m128i t10 = _mm_unpacklo_epi8(t00, _mm_unpackhi_epi64(t01, t01));
+    __m128i t11 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t00, t00), t02);
+    __m128i t12 = _mm_unpacklo_epi8(t01, _mm_unpackhi_epi64(t02, t02));
+
+    __m128i t20 = _mm_unpacklo_epi8(t10, _mm_unpackhi_epi64(t11, t11));
+    __m128i t21 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t10, t10), t12);
+    __m128i t22 = _mm_unpacklo_epi8(t11, _mm_unpackhi_epi64(t12, t12));
+
+    __m128i t30 = _mm_unpacklo_epi8(t20, _mm_unpackhi_epi64(t21, t21));
+    __m128i t31 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t20, t20), t22);
+    __m128i t32 = _mm_unpacklo_epi8(t21, _mm_unpackhi_epi64(t22, t22));
+
+    *c0 = _mm_unpacklo_epi8(t30, _mm_unpackhi_epi64(t31, t31));
+    *c1 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t30, t30), t32);
+    *c2 = _mm_unpacklo_epi8(t31, _mm_unpackhi_epi64(t32, t32));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static __m128i sse2_rgb32_channel(const __m128i* q, int shift)
+{
+    __m128i mask = _mm_set1_epi32(0xFF);
+
+    __m128i c0 = _mm_and_si128(_mm_srli_epi32(q[0], shift), mask);
+    __m128i c1 = _mm_and_si128(_mm_srli_epi32(q[1], shift), mask);
+    __m128i c2 = _mm_and_si128(_mm_srli_epi32(q[2], shift), mask);
+    __m128i c3 = _mm_and_si128(_mm_srli_epi32(q[3], shift), mask);
+
+    return _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static void sse2_load_packed(const uint8_t* p, int bpp, __m128i* c0, __m128i* c1, __m128i* c2)
+{
+    if (bpp == 3) {
+        sse2_load_rgb24(p, c0, c1, c2);
+        return;
+    }
+
+    // 16 pixels of 4 bytes, the 4th byte is ignored
+    __m128i q[4];
+
+    q[0] = _mm_loadu_si128((const __m128i*)p);
+    q[1] = _mm_loadu_si128((const __m128i*)(p + 16));
+    q[2] = _mm_loadu_si128((const __m128i*)(p + 32));
+    q[3] = _mm_loadu_si128((const __m128i*)(p + 48));
+
+    *c0 = sse2_rgb32_channel(q, 0);
+    *c1 = sse2_rgb32_channel(q, 8);
+    *c2 = sse2_rgb32_channel(q, 16);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static __m128i sse2_dot(__m128i r, __m128i g, __m128i b, int16_t cr, int16_t cg, int16_t cb)
+{
+    // 8 x int16 inputs, 8 x int16 (r * cr + g * cg + b * cb) >> 15
+    __m128i zero = _mm_setzero_si128();
+    __m128i crg  = _mm_set1_epi32(TOXCOLOR_PAIR(cr, cg));
+    __m128i cb0  = _mm_set1_epi32(TOXCOLOR_PAIR(cb, 0));
+
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r, g), crg), _mm_madd_epi16(_mm_unpacklo_epi16(b, zero), cb0));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r, g), crg), _mm_madd_epi16(_mm_unpackhi_epi16(b, zero), cb0));
+
+    return _mm_packs_epi32(_mm_srai_epi32(lo, 15), _mm_srai_epi32(hi, 15));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static __m128i sse2_luma(__m128i r, __m128i g, __m128i b)
+{
+    __m128i zero = _mm_setzero_si128();
+
+    __m128i lo = sse2_dot(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(b, zero), TOXCOLOR_Y_R, TOXCOLOR_Y_G, TOXCOLOR_Y_B);
+    __m128i hi = sse2_dot(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(b, zero), TOXCOLOR_Y_R, TOXCOLOR_Y_G, TOXCOLOR_Y_B);
+
+    return _mm_packus_epi16(lo, hi);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static __m128i sse2_subsample(__m128i a, __m128i b)
+{
+    // 16 pixels of two rows to 8 x int16 rounded 2x2 averages
+    __m128i mask = _mm_set1_epi16(0x00FF);
+
+    __m128i sa = _mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8));
+    __m128i sb = _mm_add_epi16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8));
+
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(sa, sb), _mm_set1_epi16(2)), 2);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static __m128i sse2_chroma(__m128i r, __m128i g, __m128i b, int16_t cr, int16_t cg, int16_t cb)
+{
+    __m128i c = _mm_add_epi16(sse2_dot(r, g, b, cr, cg, cb), _mm_set1_epi16(128));
+    return _mm_packus_epi16(c, c);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static void sse2_packed_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width, bool bgr, int bpp)
+{
+    uint32_t x;
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        __m128i r0, g0, b0;
+        __m128i r1, g1, b1;
+
+        if (bgr) {
+            sse2_load_packed(src0 + bpp * x, bpp, &b0, &g0, &r0);
+            sse2_load_packed(src1 + bpp * x, bpp, &b1, &g1, &r1);
+        } else {
+            sse2_load_packed(src0 + bpp * x, bpp, &r0, &g0, &b0);
+            sse2_load_packed(src1 + bpp * x, bpp, &r1, &g1, &b1);
+        }
+
+        _mm_storeu_si128((__m128i*)(y0 + x), sse2_luma(r0, g0, b0));
+        _mm_storeu_si128((__m128i*)(y1 + x), sse2_luma(r1, g1, b1));
+
+        __m128i r = sse2_subsample(r0, r1);
+        __m128i g = sse2_subsample(g0, g1);
+        __m128i b = sse2_subsample(b0, b1);
+
+        _mm_storel_epi64((__m128i*)(u + x / 2), sse2_chroma(r, g, b, TOXCOLOR_U_R, TOXCOLOR_U_G, TOXCOLOR_U_B));
+        _mm_storel_epi64((__m128i*)(v + x / 2), sse2_chroma(r, g, b, TOXCOLOR_V_R, TOXCOLOR_V_G, TOXCOLOR_V_B));
+    }
+
+    if (x < width)
+        scalar_to_yuv420_row(src0 + bpp * x, src1 + bpp * x, y0 + x, y1 + x, u + x / 2, v + x / 2, width - x, bgr ? 2 : 0, bgr ? 0 : 2, bpp);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_bgr_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    sse2_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, true, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_rgb_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    sse2_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, false, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_bgra_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    sse2_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, true, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_rgba_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    sse2_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, false, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static void sse2_split(__m128i l0, __m128i l1, __m128i* u, __m128i* v)
+{
+    // 16 interleaved pairs to 16 even and 16 odd bytes
+    __m128i mask = _mm_set1_epi16(0x00FF);
+
+    *u = _mm_packus_epi16(_mm_and_si128(l0, mask), _mm_and_si128(l1, mask));
+    *v = _mm_packus_epi16(_mm_srli_epi16(l0, 8), _mm_srli_epi16(l1, 8));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_yuyv_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    uint32_t x;
+
+    for (x = 0; x + 32 <= width; x += 32) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(src0 + 2 * x));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(src0 + 2 * x + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(src0 + 2 * x + 32));
+        __m128i a3 = _mm_loadu_si128((const __m128i*)(src0 + 2 * x + 48));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(src1 + 2 * x));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(src1 + 2 * x + 16));
+        __m128i b2 = _mm_loadu_si128((const __m128i*)(src1 + 2 * x + 32));
+        __m128i b3 = _mm_loadu_si128((const __m128i*)(src1 + 2 * x + 48));
+
+        __m128i l, c0, c1, d0, d1, cu, cv;
+
+        sse2_split(a0, a1, &l, &c0);
+        _mm_storeu_si128((__m128i*)(y0 + x), l);
+        sse2_split(a2, a3, &l, &c1);
+        _mm_storeu_si128((__m128i*)(y0 + x + 16), l);
+
+        sse2_split(b0, b1, &l, &d0);
+        _mm_storeu_si128((__m128i*)(y1 + x), l);
+        sse2_split(b2, b3, &l, &d1);
+        _mm_storeu_si128((__m128i*)(y1 + x + 16), l);
+
+        // c and d hold interleaved UV of the first and the second row
+        sse2_split(_mm_avg_epu8(c0, d0), _mm_avg_epu8(c1, d1), &cu, &cv);
+
+        _mm_storeu_si128((__m128i*)(u + x / 2), cu);
+        _mm_storeu_si128((__m128i*)(v + x / 2), cv);
+    }
+
+    if (x < width)
+        scalar_yuyv_to_yuv420_row(src0 + 2 * x, src1 + 2 * x, y0 + x, y1 + x, u + x / 2, v + x / 2, width - x);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_split_row(const uint8_t* uv, uint8_t* u, uint8_t* v, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m128i cu, cv;
+
+        sse2_split(_mm_loadu_si128((const __m128i*)(uv + 2 * i)), _mm_loadu_si128((const __m128i*)(uv + 2 * i + 16)), &cu, &cv);
+
+        _mm_storeu_si128((__m128i*)(u + i), cu);
+        _mm_storeu_si128((__m128i*)(v + i), cv);
+    }
+
+    if (i < count)
+        scalar_split_row(uv + 2 * i, u + i, v + i, count - i);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_average_row(const uint8_t* a, const uint8_t* b, uint8_t* dst, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i))));
+
+    if (i < count)
+        scalar_average_row(a + i, b + i, dst + i, count - i);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_blend_row(const uint8_t* a, const uint8_t* b, uint8_t* dst, uint32_t count, uint32_t weight)
+{
+    uint32_t i;
+
+    __m128i zero  = _mm_setzero_si128();
+    __m128i wa    = _mm_set1_epi16(256 - weight);
+    __m128i wb    = _mm_set1_epi16(weight);
+    __m128i round = _mm_set1_epi16(128);
+
+    // sums stay below 65536, so unsigned 16 bit math is exact
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), wa), _mm_mullo_epi16(_mm_unpacklo_epi8(y, zero), wb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), wa), _mm_mullo_epi16(_mm_unpackhi_epi8(y, zero), wb));
+
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+
+    if (i < count)
+        scalar_blend_row(a + i, b + i, dst + i, count - i, weight);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_resample_row(const uint8_t* src, uint8_t* dst, const uint32_t* offsets, const uint32_t* weights, uint32_t count, uint32_t width, uint32_t bpp)
+{
+    uint32_t i, j;
+
+    __m128i zero  = _mm_setzero_si128();
+    __m128i full  = _mm_set1_epi16(256);
+    __m128i round = _mm_set1_epi16(128);
+
+    // 4 pixels per step, neighbours are loaded as 4 bytes like the avx2 gather does
+    for (i = 0; i + 4 <= count && offsets[i + 3] + bpp + 4 <= width * bpp; i += 4) {
+        uint32_t pa[4], pb[4];
+
+        for (j = 0; j < 4; j++) {
+            memcpy(&pa[j], src + offsets[i + j], 4);
+            memcpy(&pb[j], src + offsets[i + j] + bpp, 4);
+        }
+
+        __m128i a = _mm_loadu_si128((const __m128i*)pa);
+        __m128i b = _mm_loadu_si128((const __m128i*)pb);
+        __m128i w = _mm_loadu_si128((const __m128i*)(weights + i));
+
+        w = _mm_or_si128(w, _mm_slli_epi32(w, 16));
+
+        __m128i wlo = _mm_unpacklo_epi32(w, w);
+        __m128i whi = _mm_unpackhi_epi32(w, w);
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_sub_epi16(full, wlo)), _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), wlo));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_sub_epi16(full, whi)), _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), whi));
+
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+
+        __m128i p = _mm_packus_epi16(lo, hi);
+
+        if (bpp == 4)
+            _mm_storeu_si128((__m128i*)(dst + 4 * i), p);
+        else {
+            // no byte shuffle in sse2, each 4 byte store spills into the next pixel
+            uint32_t px[4];
+            _mm_storeu_si128((__m128i*)px, p);
+
+            for (j = 0; j < 4; j++)
+                memcpy(dst + 3 * (i + j), &px[j], 4);
+        }
+    }
+
+    if (i < count)
+        scalar_resample_row(src, dst + i * bpp, offsets + i, weights + i, count - i, width, bpp);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static __m128i sse2_pack_rgb32(__m128i x)
+{
+    // 4 pixels of 4 bytes each (4th byte is zero) to 12 bytes, upper 4 bytes are zero
+    x = _mm_or_si128(_mm_and_si128(x, _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF)),
+                     _mm_and_si128(_mm_srli_epi64(x, 8), _mm_set_epi32(0x0000FFFF, 0xFF000000, 0x0000FFFF, 0xFF000000)));
+
+    return _mm_or_si128(_mm_move_epi64(x), _mm_slli_si128(_mm_srli_si128(x, 8), 6));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static void sse2_store_rgb24(uint8_t* p, __m128i c0, __m128i c1, __m128i c2)
+{
+    __m128i zero = _mm_setzero_si128();
+
+    __m128i ab0 = _mm_unpacklo_epi8(c0, c1);
+    __m128i ab1 = _mm_unpackhi_epi8(c0, c1);
+    __m128i cz0 = _mm_unpacklo_epi8(c2, zero);
+    __m128i cz1 = _mm_unpackhi_epi8(c2, zero);
+
+    __m128i q0 = sse2_pack_rgb32(_mm_unpacklo_epi16(ab0, cz0));
+    __m128i q1 = sse2_pack_rgb32(_mm_unpackhi_epi16(ab0, cz0));
+    __m128i q2 = sse2_pack_rgb32(_mm_unpacklo_epi16(ab1, cz1));
+    __m128i q3 = sse2_pack_rgb32(_mm_unpackhi_epi16(ab1, cz1));
+
+    _mm_storeu_si128((__m128i*)p,        _mm_or_si128(q0, _mm_slli_si128(q1, 12)));
+    _mm_storeu_si128((__m128i*)(p + 16), _mm_or_si128(_mm_srli_si128(q1, 4), _mm_slli_si128(q2, 8)));
+    _mm_storeu_si128((__m128i*)(p + 32), _mm_or_si128(_mm_srli_si128(q2, 8), _mm_slli_si128(q3, 4)));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static void sse2_store_packed(uint8_t* p, int bpp, __m128i c0, __m128i c1, __m128i c2)
+{
+    if (bpp == 3) {
+        sse2_store_rgb24(p, c0, c1, c2);
+        return;
+    }
+
+    __m128i alpha = _mm_set1_epi8((char)0xFF);
+
+    __m128i ab0 = _mm_unpacklo_epi8(c0, c1);
+    __m128i ab1 = _mm_unpackhi_epi8(c0, c1);
+    __m128i ca0 = _mm_unpacklo_epi8(c2, alpha);
+    __m128i ca1 = _mm_unpackhi_epi8(c2, alpha);
+
+    _mm_storeu_si128((__m128i*)p,        _mm_unpacklo_epi16(ab0, ca0));
+    _mm_storeu_si128((__m128i*)(p + 16), _mm_unpackhi_epi16(ab0, ca0));
+    _mm_storeu_si128((__m128i*)(p + 32), _mm_unpacklo_epi16(ab1, ca1));
+    _mm_storeu_si128((__m128i*)(p + 48), _mm_unpackhi_epi16(ab1, ca1));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static __m128i sse2_channel(__m128i l0, __m128i l1, __m128i l2, __m128i l3, __m128i c0, __m128i c1)
+{
+    // 16 luma terms plus 8 chroma terms (each shared by two pixels) to 16 bytes
+    __m128i p0 = _mm_srai_epi32(_mm_add_epi32(l0, _mm_unpacklo_epi32(c0, c0)), 8);
+    __m128i p1 = _mm_srai_epi32(_mm_add_epi32(l1, _mm_unpackhi_epi32(c0, c0)), 8);
+    __m128i p2 = _mm_srai_epi32(_mm_add_epi32(l2, _mm_unpacklo_epi32(c1, c1)), 8);
+    __m128i p3 = _mm_srai_epi32(_mm_add_epi32(l3, _mm_unpackhi_epi32(c1, c1)), 8);
+
+    return _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static void sse2_yuv420_to_packed_pixels(const uint8_t* y, __m128i cr0, __m128i cr1, __m128i cg0, __m128i cg1, __m128i cb0, __m128i cb1, uint8_t* dst, bool bgr, int bpp)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i k    = _mm_set1_epi32(TOXCOLOR_Y_K);
+
+    __m128i l  = _mm_subs_epu8(_mm_loadu_si128((const __m128i*)y), _mm_set1_epi8(16));
+    __m128i lo = _mm_unpacklo_epi8(l, zero);
+    __m128i hi = _mm_unpackhi_epi8(l, zero);
+
+    __m128i l0 = _mm_madd_epi16(_mm_unpacklo_epi16(lo, zero), k);
+    __m128i l1 = _mm_madd_epi16(_mm_unpackhi_epi16(lo, zero), k);
+    __m128i l2 = _mm_madd_epi16(_mm_unpacklo_epi16(hi, zero), k);
+    __m128i l3 = _mm_madd_epi16(_mm_unpackhi_epi16(hi, zero), k);
+
+    __m128i r = sse2_channel(l0, l1, l2, l3, cr0, cr1);
+    __m128i g = sse2_channel(l0, l1, l2, l3, cg0, cg1);
+    __m128i b = sse2_channel(l0, l1, l2, l3, cb0, cb1);
+
+    if (bgr)
+        sse2_store_packed(dst, bpp, b, g, r);
+    else
+        sse2_store_packed(dst, bpp, r, g, b);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+inline static void sse2_yuv420_to_packed_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width, bool bgr, int bpp)
+{
+    uint32_t x;
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i bias = _mm_set1_epi16(128);
+    __m128i one  = _mm_set1_epi16(1);
+    __m128i kr   = _mm_set1_epi32(TOXCOLOR_PAIR(TOXCOLOR_R_V, 128));
+    __m128i kg   = _mm_set1_epi32(TOXCOLOR_PAIR(TOXCOLOR_G_U, TOXCOLOR_G_V));
+    __m128i kb   = _mm_set1_epi32(TOXCOLOR_PAIR(TOXCOLOR_B_U, 128));
+    __m128i round = _mm_set1_epi32(128);
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        __m128i cu = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(u + x / 2)), zero), bias);
+        __m128i cv = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(v + x / 2)), zero), bias);
+
+        __m128i cr0 = _mm_madd_epi16(_mm_unpacklo_epi16(cv, one), kr);
+        __m128i cr1 = _mm_madd_epi16(_mm_unpackhi_epi16(cv, one), kr);
+        __m128i cg0 = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(cu, cv), kg), round);
+        __m128i cg1 = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(cu, cv), kg), round);
+        __m128i cb0 = _mm_madd_epi16(_mm_unpacklo_epi16(cu, one), kb);
+        __m128i cb1 = _mm_madd_epi16(_mm_unpackhi_epi16(cu, one), kb);
+
+        sse2_yuv420_to_packed_pixels(y0 + x, cr0, cr1, cg0, cg1, cb0, cb1, dst0 + bpp * x, bgr, bpp);
+        sse2_yuv420_to_packed_pixels(y1 + x, cr0, cr1, cg0, cg1, cb0, cb1, dst1 + bpp * x, bgr, bpp);
+    }
+
+    if (x < width)
+        scalar_from_yuv420_row(y0 + x, y1 + x, u + x / 2, v + x / 2, dst0 + bpp * x, dst1 + bpp * x, width - x, bgr ? 2 : 0, bgr ? 0 : 2, bpp);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_yuv420_to_bgr_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    sse2_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, true, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_yuv420_to_rgb_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    sse2_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, false, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_yuv420_to_bgra_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    sse2_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, true, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_SSE2
+static void sse2_yuv420_to_rgba_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    sse2_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, false, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+static bool sse2_supported(void)
+{
+#ifdef __x86_64__
+    return true;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static __m128i avx2_shuffle3(__m128i t0, __m128i t1, __m128i t2, __m128i m0, __m128i m1, __m128i m2)
+{
+    return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(t0, m0), _mm_shuffle_epi8(t1, m1)), _mm_shuffle_epi8(t2, m2));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static void avx2_load_rgb24_half(const uint8_t* p, __m128i* c0, __m128i* c1, __m128i* c2)
+{
+    __m128i t0 = _mm_loadu_si128((const __m128i*)p);
+    __m128i t1 = _mm_loadu_si128((const __m128i*)(p + 16));
+    __m128i t2 = _mm_loadu_si128((const __m128i*)(p + 32));
+
+    *c0 = avx2_shuffle3(t0, t1, t2,
+        _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+        _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1),
+        _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13));
+
+    *c1 = avx2_shuffle3(t0, t1, t2,
+        _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+        _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1),
+        _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14));
+
+    *c2 = avx2_shuffle3(t0, t1, t2,
+        _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+        _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1),
+        _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static void avx2_load_rgb24(const uint8_t* p, __m256i* c0, __m256i* c1, __m256i* c2)
+{
+    // 32 pixels, lower lane holds pixels 0..15 and upper lane 16..31
+    __m128i l0, l1, l2;
+    __m128i h0, h1, h2;
+
+    avx2_load_rgb24_half(p,      &l0, &l1, &l2);
+    avx2_load_rgb24_half(p + 48, &h0, &h1, &h2);
+
+    *c0 = _mm256_inserti128_si256(_mm256_castsi128_si256(l0), h0, 1);
+    *c1 = _mm256_inserti128_si256(_mm256_castsi128_si256(l1), h1, 1);
+    *c2 = _mm256_inserti128_si256(_mm256_castsi128_si256(l2), h2, 1);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static __m256i avx2_rgb32_channel(const __m256i* q, int shift)
+{
+    __m256i mask = _mm256_set1_epi32(0xFF);
+
+    __m256i c0 = _mm256_and_si256(_mm256_srli_epi32(q[0], shift), mask);
+    __m256i c1 = _mm256_and_si256(_mm256_srli_epi32(q[1], shift), mask);
+    __m256i c2 = _mm256_and_si256(_mm256_srli_epi32(q[2], shift), mask);
+    __m256i c3 = _mm256_and_si256(_mm256_srli_epi32(q[3], shift), mask);
+
+    // packs leave groups of 4 pixels as [0, 8, 16, 24 | 4, 12, 20, 28]
+    __m256i c = _mm256_packus_epi16(_mm256_packs_epi32(c0, c1), _mm256_packs_epi32(c2, c3));
+
+    return _mm256_permutevar8x32_epi32(c, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static void avx2_load_packed(const uint8_t* p, int bpp, __m256i* c0, __m256i* c1, __m256i* c2)
+{
+    if (bpp == 3) {
+        avx2_load_rgb24(p, c0, c1, c2);
+        return;
+    }
+
+    __m256i q[4];
+
+    q[0] = _mm256_loadu_si256((const __m256i*)p);
+    q[1] = _mm256_loadu_si256((const __m256i*)(p + 32));
+    q[2] = _mm256_loadu_si256((const __m256i*)(p + 64));
+    q[3] = _mm256_loadu_si256((const __m256i*)(p + 96));
+
+    *c0 = avx2_rgb32_channel(q, 0);
+    *c1 = avx2_rgb32_channel(q, 8);
+    *c2 = avx2_rgb32_channel(q, 16);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static __m256i avx2_dot(__m256i r, __m256i g, __m256i b, int16_t cr, int16_t cg, int16_t cb)
+{
+    // unpack and pack both work per lane, so the output keeps the input order
+    __m256i zero = _mm256_setzero_si256();
+    __m256i crg  = _mm256_set1_epi32(TOXCOLOR_PAIR(cr, cg));
+    __m256i cb0  = _mm256_set1_epi32(TOXCOLOR_PAIR(cb, 0));
+
+    __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(r, g), crg), _mm256_madd_epi16(_mm256_unpacklo_epi16(b, zero), cb0));
+    __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(r, g), crg), _mm256_madd_epi16(_mm256_unpackhi_epi16(b, zero), cb0));
+
+    return _mm256_packs_epi32(_mm256_srai_epi32(lo, 15), _mm256_srai_epi32(hi, 15));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static __m256i avx2_luma(__m256i r, __m256i g, __m256i b)
+{
+    __m256i lo = avx2_dot(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(r)),
+                          _mm256_cvtepu8_epi16(_mm256_castsi256_si128(g)),
+                          _mm256_cvtepu8_epi16(_mm256_castsi256_si128(b)),
+                          TOXCOLOR_Y_R, TOXCOLOR_Y_G, TOXCOLOR_Y_B);
+
+    __m256i hi = avx2_dot(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(r, 1)),
+                          _mm256_cvtepu8_epi16(_mm256_extracti128_si256(g, 1)),
+                          _mm256_cvtepu8_epi16(_mm256_extracti128_si256(b, 1)),
+                          TOXCOLOR_Y_R, TOXCOLOR_Y_G, TOXCOLOR_Y_B);
+
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static __m256i avx2_subsample(__m256i a, __m256i b)
+{
+    __m256i mask = _mm256_set1_epi16(0x00FF);
+
+    __m256i sa = _mm256_add_epi16(_mm256_and_si256(a, mask), _mm256_srli_epi16(a, 8));
+    __m256i sb = _mm256_add_epi16(_mm256_and_si256(b, mask), _mm256_srli_epi16(b, 8));
+
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(sa, sb), _mm256_set1_epi16(2)), 2);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static __m128i avx2_chroma(__m256i r, __m256i g, __m256i b, int16_t cr, int16_t cg, int16_t cb)
+{
+    __m256i c = _mm256_add_epi16(avx2_dot(r, g, b, cr, cg, cb), _mm256_set1_epi16(128));
+    return _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi16(c, c), 0xD8));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static void avx2_packed_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width, bool bgr, int bpp)
+{
+    uint32_t x;
+
+    for (x = 0; x + 32 <= width; x += 32) {
+        __m256i r0, g0, b0;
+        __m256i r1, g1, b1;
+
+        if (bgr) {
+            avx2_load_packed(src0 + bpp * x, bpp, &b0, &g0, &r0);
+            avx2_load_packed(src1 + bpp * x, bpp, &b1, &g1, &r1);
+        } else {
+            avx2_load_packed(src0 + bpp * x, bpp, &r0, &g0, &b0);
+            avx2_load_packed(src1 + bpp * x, bpp, &r1, &g1, &b1);
+        }
+
+        _mm256_storeu_si256((__m256i*)(y0 + x), avx2_luma(r0, g0, b0));
+        _mm256_storeu_si256((__m256i*)(y1 + x), avx2_luma(r1, g1, b1));
+
+        __m256i r = avx2_subsample(r0, r1);
+        __m256i g = avx2_subsample(g0, g1);
+        __m256i b = avx2_subsample(b0, b1);
+
+        _mm_storeu_si128((__m128i*)(u + x / 2), avx2_chroma(r, g, b, TOXCOLOR_U_R, TOXCOLOR_U_G, TOXCOLOR_U_B));
+        _mm_storeu_si128((__m128i*)(v + x / 2), avx2_chroma(r, g, b, TOXCOLOR_V_R, TOXCOLOR_V_G, TOXCOLOR_V_B));
+    }
+
+    if (x < width)
+        sse2_packed_to_yuv420_row(src0 + bpp * x, src1 + bpp * x, y0 + x, y1 + x, u + x / 2, v + x / 2, width - x, bgr, bpp);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_bgr_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    avx2_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, true, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_rgb_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    avx2_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, false, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_bgra_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    avx2_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, true, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_rgba_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    avx2_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, false, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static void avx2_split(__m256i l0, __m256i l1, __m256i* u, __m256i* v)
+{
+    // 32 interleaved pairs to 32 even and 32 odd bytes, packs work per lane
+    __m256i mask = _mm256_set1_epi16(0x00FF);
+
+    *u = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_and_si256(l0, mask), _mm256_and_si256(l1, mask)), 0xD8);
+    *v = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(l0, 8), _mm256_srli_epi16(l1, 8)), 0xD8);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_yuyv_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    uint32_t x;
+
+    for (x = 0; x + 64 <= width; x += 64) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i*)(src0 + 2 * x));
+        __m256i a1 = _mm256_loadu_si256((const __m256i*)(src0 + 2 * x + 32));
+        __m256i a2 = _mm256_loadu_si256((const __m256i*)(src0 + 2 * x + 64));
+        __m256i a3 = _mm256_loadu_si256((const __m256i*)(src0 + 2 * x + 96));
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(src1 + 2 * x));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(src1 + 2 * x + 32));
+        __m256i b2 = _mm256_loadu_si256((const __m256i*)(src1 + 2 * x + 64));
+        __m256i b3 = _mm256_loadu_si256((const __m256i*)(src1 + 2 * x + 96));
+
+        __m256i l, c0, c1, d0, d1, cu, cv;
+
+        avx2_split(a0, a1, &l, &c0);
+        _mm256_storeu_si256((__m256i*)(y0 + x), l);
+        avx2_split(a2, a3, &l, &c1);
+        _mm256_storeu_si256((__m256i*)(y0 + x + 32), l);
+
+        avx2_split(b0, b1, &l, &d0);
+        _mm256_storeu_si256((__m256i*)(y1 + x), l);
+        avx2_split(b2, b3, &l, &d1);
+        _mm256_storeu_si256((__m256i*)(y1 + x + 32), l);
+
+        avx2_split(_mm256_avg_epu8(c0, d0), _mm256_avg_epu8(c1, d1), &cu, &cv);
+
+        _mm256_storeu_si256((__m256i*)(u + x / 2), cu);
+        _mm256_storeu_si256((__m256i*)(v + x / 2), cv);
+    }
+
+    if (x < width)
+        sse2_yuyv_to_yuv420_row(src0 + 2 * x, src1 + 2 * x, y0 + x, y1 + x, u + x / 2, v + x / 2, width - x);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_split_row(const uint8_t* uv, uint8_t* u, uint8_t* v, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i + 32 <= count; i += 32) {
+        __m256i cu, cv;
+
+        avx2_split(_mm256_loadu_si256((const __m256i*)(uv + 2 * i)), _mm256_loadu_si256((const __m256i*)(uv + 2 * i + 32)), &cu, &cv);
+
+        _mm256_storeu_si256((__m256i*)(u + i), cu);
+        _mm256_storeu_si256((__m256i*)(v + i), cv);
+    }
+
+    if (i < count)
+        sse2_split_row(uv + 2 * i, u + i, v + i, count - i);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_average_row(const uint8_t* a, const uint8_t* b, uint8_t* dst, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i + 32 <= count; i += 32)
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i))));
+
+    if (i < count)
+        sse2_average_row(a + i, b + i, dst + i, count - i);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_blend_row(const uint8_t* a, const uint8_t* b, uint8_t* dst, uint32_t count, uint32_t weight)
+{
+    uint32_t i;
+
+    __m256i wa    = _mm256_set1_epi16(256 - weight);
+    __m256i wb    = _mm256_set1_epi16(weight);
+    __m256i round = _mm256_set1_epi16(128);
+
+    for (i = 0; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i zero = _mm256_setzero_si256();
+
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(x, zero), wa), _mm256_mullo_epi16(_mm256_unpacklo_epi8(y, zero), wb));
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(x, zero), wa), _mm256_mullo_epi16(_mm256_unpackhi_epi8(y, zero), wb));
+
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, round), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, round), 8);
+
+        // unpack and pack are both per lane, so the order is kept
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+
+    if (i < count)
+        sse2_blend_row(a + i, b + i, dst + i, count - i, weight);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_resample_row(const uint8_t* src, uint8_t* dst, const uint32_t* offsets, const uint32_t* weights, uint32_t count, uint32_t width, uint32_t bpp)
+{
+    uint32_t i;
+
+    __m256i zero  = _mm256_setzero_si256();
+    __m256i next  = _mm256_set1_epi32(bpp);
+    __m256i full  = _mm256_set1_epi16(256);
+    __m256i round = _mm256_set1_epi16(128);
+    __m128i pack  = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    /*
+     * 8 pixels per step, both neighbours are gathered as 4 bytes, so the 4th byte of 3 byte
+     * pixels belongs to the next pixel and gets dropped; steps reading past the row are left to
+     * the scalar loop
+     */
+    for (i = 0; i + 8 <= count && offsets[i + 7] + bpp + 4 <= width * bpp; i += 8) {
+        __m256i off = _mm256_loadu_si256((const __m256i*)(offsets + i));
+        __m256i w   = _mm256_loadu_si256((const __m256i*)(weights + i));
+
+        __m256i a = _mm256_i32gather_epi32((const int*)src, off, 1);
+        __m256i b = _mm256_i32gather_epi32((const int*)src, _mm256_add_epi32(off, next), 1);
+
+        // weights of pixels [0, 1 | 4, 5] and [2, 3 | 6, 7] spread over their 4 channels
+        w = _mm256_or_si256(w, _mm256_slli_epi32(w, 16));
+
+        __m256i wlo = _mm256_unpacklo_epi32(w, w);
+        __m256i whi = _mm256_unpackhi_epi32(w, w);
+
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_sub_epi16(full, wlo)), _mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), wlo));
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_sub_epi16(full, whi)), _mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), whi));
+
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, round), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, round), 8);
+
+        __m256i p = _mm256_packus_epi16(lo, hi);
+
+        if (bpp == 4)
+            _mm256_storeu_si256((__m256i*)(dst + 4 * i), p);
+        else {
+            // 12 bytes per lane, each store spills 4 bytes the next one overwrites
+            _mm_storeu_si128((__m128i*)(dst + 3 * i),      _mm_shuffle_epi8(_mm256_castsi256_si128(p), pack));
+            _mm_storeu_si128((__m128i*)(dst + 3 * i + 12), _mm_shuffle_epi8(_mm256_extracti128_si256(p, 1), pack));
+        }
+    }
+
+    if (i < count)
+        sse2_resample_row(src, dst + i * bpp, offsets + i, weights + i, count - i, width, bpp);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static void avx2_store_rgb24_half(uint8_t* p, __m128i c0, __m128i c1, __m128i c2)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    __m128i ab0 = _mm_unpacklo_epi8(c0, c1);
+    __m128i ab1 = _mm_unpackhi_epi8(c0, c1);
+    __m128i cz0 = _mm_unpacklo_epi8(c2, zero);
+    __m128i cz1 = _mm_unpackhi_epi8(c2, zero);
+
+    __m128i q0 = _mm_shuffle_epi8(_mm_unpacklo_epi16(ab0, cz0), pack);
+    __m128i q1 = _mm_shuffle_epi8(_mm_unpackhi_epi16(ab0, cz0), pack);
+    __m128i q2 = _mm_shuffle_epi8(_mm_unpacklo_epi16(ab1, cz1), pack);
+    __m128i q3 = _mm_shuffle_epi8(_mm_unpackhi_epi16(ab1, cz1), pack);
+
+    _mm_storeu_si128((__m128i*)p,        _mm_or_si128(q0, _mm_slli_si128(q1, 12)));
+    _mm_storeu_si128((__m128i*)(p + 16), _mm_or_si128(_mm_srli_si128(q1, 4), _mm_slli_si128(q2, 8)));
+    _mm_storeu_si128((__m128i*)(p + 32), _mm_or_si128(_mm_srli_si128(q2, 8), _mm_slli_si128(q3, 4)));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static void avx2_store_rgb24(uint8_t* p, __m256i c0, __m256i c1, __m256i c2)
+{
+    avx2_store_rgb24_half(p,      _mm256_castsi256_si128(c0),      _mm256_castsi256_si128(c1),      _mm256_castsi256_si128(c2));
+    avx2_store_rgb24_half(p + 48, _mm256_extracti128_si256(c0, 1), _mm256_extracti128_si256(c1, 1), _mm256_extracti128_si256(c2, 1));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static void avx2_store_packed(uint8_t* p, int bpp, __m256i c0, __m256i c1, __m256i c2)
+{
+    if (bpp == 3) {
+        avx2_store_rgb24(p, c0, c1, c2);
+        return;
+    }
+
+    __m256i alpha = _mm256_set1_epi8((char)0xFF);
+
+    __m256i ab0 = _mm256_unpacklo_epi8(c0, c1);
+    __m256i ab1 = _mm256_unpackhi_epi8(c0, c1);
+    __m256i ca0 = _mm256_unpacklo_epi8(c2, alpha);
+    __m256i ca1 = _mm256_unpackhi_epi8(c2, alpha);
+
+    // unpacks work per lane, so quads hold pixels [0-3|16-19], [4-7|20-23], [8-11|24-27], [12-15|28-31]
+    __m256i q0 = _mm256_unpacklo_epi16(ab0, ca0);
+    __m256i q1 = _mm256_unpackhi_epi16(ab0, ca0);
+    __m256i q2 = _mm256_unpacklo_epi16(ab1, ca1);
+    __m256i q3 = _mm256_unpackhi_epi16(ab1, ca1);
+
+    _mm256_storeu_si256((__m256i*)p,        _mm256_permute2x128_si256(q0, q1, 0x20));
+    _mm256_storeu_si256((__m256i*)(p + 32), _mm256_permute2x128_si256(q2, q3, 0x20));
+    _mm256_storeu_si256((__m256i*)(p + 64), _mm256_permute2x128_si256(q0, q1, 0x31));
+    _mm256_storeu_si256((__m256i*)(p + 96), _mm256_permute2x128_si256(q2, q3, 0x31));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static __m256i avx2_channel(__m256i l0, __m256i l1, __m256i l2, __m256i l3, __m256i c0, __m256i c1)
+{
+    /*
+     * luma groups hold pixels [0-3|16-19], [4-7|20-23], [8-11|24-27], [12-15|28-31] and chroma
+     * groups hold samples [0-3|8-11], [4-7|12-15], so unpacking a chroma group with itself
+     * yields exactly the pixel order of the matching luma group, and packs put all back in order
+     */
+    __m256i p0 = _mm256_srai_epi32(_mm256_add_epi32(l0, _mm256_unpacklo_epi32(c0, c0)), 8);
+    __m256i p1 = _mm256_srai_epi32(_mm256_add_epi32(l1, _mm256_unpackhi_epi32(c0, c0)), 8);
+    __m256i p2 = _mm256_srai_epi32(_mm256_add_epi32(l2, _mm256_unpacklo_epi32(c1, c1)), 8);
+    __m256i p3 = _mm256_srai_epi32(_mm256_add_epi32(l3, _mm256_unpackhi_epi32(c1, c1)), 8);
+
+    return _mm256_packus_epi16(_mm256_packs_epi32(p0, p1), _mm256_packs_epi32(p2, p3));
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static void avx2_yuv420_to_packed_pixels(const uint8_t* y, __m256i cr0, __m256i cr1, __m256i cg0, __m256i cg1, __m256i cb0, __m256i cb1, uint8_t* dst, bool bgr, int bpp)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i k    = _mm256_set1_epi32(TOXCOLOR_Y_K);
+
+    // reorder quads to [0-7, 16-23, 8-15, 24-31] so the widened halves match the chroma groups
+    __m256i l  = _mm256_subs_epu8(_mm256_loadu_si256((const __m256i*)y), _mm256_set1_epi8(16));
+    l = _mm256_permute4x64_epi64(l, 0xD8);
+
+    __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(l));
+    __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(l, 1));
+
+    __m256i l0 = _mm256_madd_epi16(_mm256_unpacklo_epi16(lo, zero), k);
+    __m256i l1 = _mm256_madd_epi16(_mm256_unpackhi_epi16(lo, zero), k);
+    __m256i l2 = _mm256_madd_epi16(_mm256_unpacklo_epi16(hi, zero), k);
+    __m256i l3 = _mm256_madd_epi16(_mm256_unpackhi_epi16(hi, zero), k);
+
+    __m256i r = avx2_channel(l0, l1, l2, l3, cr0, cr1);
+    __m256i g = avx2_channel(l0, l1, l2, l3, cg0, cg1);
+    __m256i b = avx2_channel(l0, l1, l2, l3, cb0, cb1);
+
+    if (bgr)
+        avx2_store_packed(dst, bpp, b, g, r);
+    else
+        avx2_store_packed(dst, bpp, r, g, b);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+inline static void avx2_yuv420_to_packed_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width, bool bgr, int bpp)
+{
+    uint32_t x;
+
+    __m256i bias  = _mm256_set1_epi16(128);
+    __m256i one   = _mm256_set1_epi16(1);
+    __m256i kr    = _mm256_set1_epi32(TOXCOLOR_PAIR(TOXCOLOR_R_V, 128));
+    __m256i kg    = _mm256_set1_epi32(TOXCOLOR_PAIR(TOXCOLOR_G_U, TOXCOLOR_G_V));
+    __m256i kb    = _mm256_set1_epi32(TOXCOLOR_PAIR(TOXCOLOR_B_U, 128));
+    __m256i round = _mm256_set1_epi32(128);
+
+    for (x = 0; x + 32 <= width; x += 32) {
+        __m256i cu = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(u + x / 2))), bias);
+        __m256i cv = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(v + x / 2))), bias);
+
+        __m256i cr0 = _mm256_madd_epi16(_mm256_unpacklo_epi16(cv, one), kr);
+        __m256i cr1 = _mm256_madd_epi16(_mm256_unpackhi_epi16(cv, one), kr);
+        __m256i cg0 = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(cu, cv), kg), round);
+        __m256i cg1 = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(cu, cv), kg), round);
+        __m256i cb0 = _mm256_madd_epi16(_mm256_unpacklo_epi16(cu, one), kb);
+        __m256i cb1 = _mm256_madd_epi16(_mm256_unpackhi_epi16(cu, one), kb);
+
+        avx2_yuv420_to_packed_pixels(y0 + x, cr0, cr1, cg0, cg1, cb0, cb1, dst0 + bpp * x, bgr, bpp);
+        avx2_yuv420_to_packed_pixels(y1 + x, cr0, cr1, cg0, cg1, cb0, cb1, dst1 + bpp * x, bgr, bpp);
+    }
+
+    if (x < width)
+        sse2_yuv420_to_packed_row(y0 + x, y1 + x, u + x / 2, v + x / 2, dst0 + bpp * x, dst1 + bpp * x, width - x, bgr, bpp);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_yuv420_to_bgr_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    avx2_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, true, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_yuv420_to_rgb_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    avx2_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, false, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_yuv420_to_bgra_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    avx2_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, true, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+TOXCOLOR_TARGET_AVX2
+static void avx2_yuv420_to_rgba_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    avx2_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, false, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+static bool avx2_supported(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+//----------------------------------------------------------------------------------------------
+
+#endif   // TOXCOLOR_X86
+
+#ifdef TOXCOLOR_NEON
+
+inline static int16x8_t neon_dot(int16x8_t r, int16x8_t g, int16x8_t b, int16_t cr, int16_t cg, int16_t cb)
+{
+    int32x4_t lo = vmull_n_s16(vget_low_s16(r), cr);
+    lo = vmlal_n_s16(lo, vget_low_s16(g), cg);
+    lo = vmlal_n_s16(lo, vget_low_s16(b), cb);
+
+    int32x4_t hi = vmull_n_s16(vget_high_s16(r), cr);
+    hi = vmlal_n_s16(hi, vget_high_s16(g), cg);
+    hi = vmlal_n_s16(hi, vget_high_s16(b), cb);
+
+    return vcombine_s16(vshrn_n_s32(lo, 15), vshrn_n_s32(hi, 15));
+}
+//----------------------------------------------------------------------------------------------
+
+inline static uint8x16_t neon_luma(uint8x16_t r, uint8x16_t g, uint8x16_t b)
+{
+    int16x8_t lo = neon_dot(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(r))),
+                            vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(g))),
+                            vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(b))),
+                            TOXCOLOR_Y_R, TOXCOLOR_Y_G, TOXCOLOR_Y_B);
+
+    int16x8_t hi = neon_dot(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(r))),
+                            vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(g))),
+                            vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(b))),
+                            TOXCOLOR_Y_R, TOXCOLOR_Y_G, TOXCOLOR_Y_B);
+
+    return vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi));
+}
+//----------------------------------------------------------------------------------------------
+
+inline static int16x8_t neon_subsample(uint8x16_t a, uint8x16_t b)
+{
+    return vreinterpretq_s16_u16(vrshrq_n_u16(vaddq_u16(vpaddlq_u8(a), vpaddlq_u8(b)), 2));
+}
+//----------------------------------------------------------------------------------------------
+
+inline static uint8x8_t neon_chroma(int16x8_t r, int16x8_t g, int16x8_t b, int16_t cr, int16_t cg, int16_t cb)
+{
+    return vqmovun_s16(vaddq_s16(neon_dot(r, g, b, cr, cg, cb), vdupq_n_s16(128)));
+}
+//----------------------------------------------------------------------------------------------
+
+inline static void neon_load_packed(const uint8_t* p, int bpp, int ri, int bi, uint8x16_t* r, uint8x16_t* g, uint8x16_t* b)
+{
+    if (bpp == 4) {
+        uint8x16x4_t q = vld4q_u8(p);
+
+        *r = q.val[ri];
+        *g = q.val[1];
+        *b = q.val[bi];
+    } else {
+        uint8x16x3_t q = vld3q_u8(p);
+
+        *r = q.val[ri];
+        *g = q.val[1];
+        *b = q.val[bi];
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+inline static void neon_packed_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width, bool bgr, int bpp)
+{
+    uint32_t x;
+
+    int ri = bgr ? 2 : 0;
+    int bi = bgr ? 0 : 2;
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        uint8x16_t r0, g0, b0;
+        uint8x16_t r1, g1, b1;
+
+        neon_load_packed(src0 + bpp * x, bpp, ri, bi, &r0, &g0, &b0);
+        neon_load_packed(src1 + bpp * x, bpp, ri, bi, &r1, &g1, &b1);
+
+        vst1q_u8(y0 + x, neon_luma(r0, g0, b0));
+        vst1q_u8(y1 + x, neon_luma(r1, g1, b1));
+
+        int16x8_t r = neon_subsample(r0, r1);
+        int16x8_t g = neon_subsample(g0, g1);
+        int16x8_t b = neon_subsample(b0, b1);
+
+        vst1_u8(u + x / 2, neon_chroma(r, g, b, TOXCOLOR_U_R, TOXCOLOR_U_G, TOXCOLOR_U_B));
+        vst1_u8(v + x / 2, neon_chroma(r, g, b, TOXCOLOR_V_R, TOXCOLOR_V_G, TOXCOLOR_V_B));
+    }
+
+    if (x < width)
+        scalar_to_yuv420_row(src0 + bpp * x, src1 + bpp * x, y0 + x, y1 + x, u + x / 2, v + x / 2, width - x, ri, bi, bpp);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_bgr_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    neon_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, true, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_rgb_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    neon_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, false, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_bgra_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    neon_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, true, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_rgba_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    neon_packed_to_yuv420_row(src0, src1, y0, y1, u, v, width, false, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_yuyv_to_yuv420_row(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+{
+    uint32_t x;
+
+    for (x = 0; x + 32 <= width; x += 32) {
+        // Y0, U, Y1, V of 16 pixel pairs
+        uint8x16x4_t a = vld4q_u8(src0 + 2 * x);
+        uint8x16x4_t b = vld4q_u8(src1 + 2 * x);
+
+        uint8x16x2_t l;
+
+        l.val[0] = a.val[0];
+        l.val[1] = a.val[2];
+        vst2q_u8(y0 + x, l);
+
+        l.val[0] = b.val[0];
+        l.val[1] = b.val[2];
+        vst2q_u8(y1 + x, l);
+
+        vst1q_u8(u + x / 2, vrhaddq_u8(a.val[1], b.val[1]));
+        vst1q_u8(v + x / 2, vrhaddq_u8(a.val[3], b.val[3]));
+    }
+
+    if (x < width)
+        scalar_yuyv_to_yuv420_row(src0 + 2 * x, src1 + 2 * x, y0 + x, y1 + x, u + x / 2, v + x / 2, width - x);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_split_row(const uint8_t* uv, uint8_t* u, uint8_t* v, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        uint8x16x2_t c = vld2q_u8(uv + 2 * i);
+
+        vst1q_u8(u + i, c.val[0]);
+        vst1q_u8(v + i, c.val[1]);
+    }
+
+    if (i < count)
+        scalar_split_row(uv + 2 * i, u + i, v + i, count - i);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_average_row(const uint8_t* a, const uint8_t* b, uint8_t* dst, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+        vst1q_u8(dst + i, vrhaddq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+
+    if (i < count)
+        scalar_average_row(a + i, b + i, dst + i, count - i);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_blend_row(const uint8_t* a, const uint8_t* b, uint8_t* dst, uint32_t count, uint32_t weight)
+{
+    uint32_t i;
+
+    // both weights fit into 8 bits as 0 < weight < 256
+    uint8x8_t wa = vdup_n_u8(256 - weight);
+    uint8x8_t wb = vdup_n_u8(weight);
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        uint8x16_t x = vld1q_u8(a + i);
+        uint8x16_t y = vld1q_u8(b + i);
+
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(x),  wa), vget_low_u8(y),  wb);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(x), wa), vget_high_u8(y), wb);
+
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+
+    if (i < count)
+        scalar_blend_row(a + i, b + i, dst + i, count - i, weight);
+}
+//----------------------------------------------------------------------------------------------
+
+inline static uint8x8_t neon_channel(int32x4_t l0, int32x4_t l1, int32x4_t c)
+{
+    // 8 luma terms plus 4 chroma terms (each shared by two pixels) to 8 bytes
+    int32x4x2_t d = vzipq_s32(c, c);
+
+    int16x4_t p0 = vshrn_n_s32(vaddq_s32(l0, d.val[0]), 8);
+    int16x4_t p1 = vshrn_n_s32(vaddq_s32(l1, d.val[1]), 8);
+
+    return vqmovun_s16(vcombine_s16(p0, p1));
+}
+//----------------------------------------------------------------------------------------------
+
+inline static void neon_yuv420_to_packed_pixels(const uint8_t* y, int32x4_t cr[4], int32x4_t cg[4], int32x4_t cb[4], uint8_t* dst, bool bgr, int bpp)
+{
+    uint8x16_t l  = vqsubq_u8(vld1q_u8(y), vdupq_n_u8(16));
+    int16x8_t  lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(l)));
+    int16x8_t  hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(l)));
+
+    int32x4_t l0 = vmull_n_s16(vget_low_s16(lo),  TOXCOLOR_Y_K);
+    int32x4_t l1 = vmull_n_s16(vget_high_s16(lo), TOXCOLOR_Y_K);
+    int32x4_t l2 = vmull_n_s16(vget_low_s16(hi),  TOXCOLOR_Y_K);
+    int32x4_t l3 = vmull_n_s16(vget_high_s16(hi), TOXCOLOR_Y_K);
+
+    uint8x16_t r = vcombine_u8(neon_channel(l0, l1, cr[0]), neon_channel(l2, l3, cr[1]));
+    uint8x16_t g = vcombine_u8(neon_channel(l0, l1, cg[0]), neon_channel(l2, l3, cg[1]));
+    uint8x16_t b = vcombine_u8(neon_channel(l0, l1, cb[0]), neon_channel(l2, l3, cb[1]));
+
+    if (bpp == 4) {
+        uint8x16x4_t p;
+        p.val[0] = bgr ? b : r;
+        p.val[1] = g;
+        p.val[2] = bgr ? r : b;
+        p.val[3] = vdupq_n_u8(255);
+
+        vst4q_u8(dst, p);
+    } else {
+        uint8x16x3_t p;
+        p.val[0] = bgr ? b : r;
+        p.val[1] = g;
+        p.val[2] = bgr ? r : b;
+
+        vst3q_u8(dst, p);
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+inline static void neon_yuv420_to_packed_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width, bool bgr, int bpp)
+{
+    uint32_t x;
+
+    int32x4_t round = vdupq_n_s32(128);
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        int16x8_t cu = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(u + x / 2), vdup_n_u8(128)));
+        int16x8_t cv = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(v + x / 2), vdup_n_u8(128)));
+
+        int32x4_t cr[2];
+        int32x4_t cg[2];
+        int32x4_t cb[2];
+
+        cr[0] = vmlal_n_s16(round, vget_low_s16(cv),  TOXCOLOR_R_V);
+        cr[1] = vmlal_n_s16(round, vget_high_s16(cv), TOXCOLOR_R_V);
+        cg[0] = vmlal_n_s16(vmlal_n_s16(round, vget_low_s16(cu),  TOXCOLOR_G_U), vget_low_s16(cv),  TOXCOLOR_G_V);
+        cg[1] = vmlal_n_s16(vmlal_n_s16(round, vget_high_s16(cu), TOXCOLOR_G_U), vget_high_s16(cv), TOXCOLOR_G_V);
+        cb[0] = vmlal_n_s16(round, vget_low_s16(cu),  TOXCOLOR_B_U);
+        cb[1] = vmlal_n_s16(round, vget_high_s16(cu), TOXCOLOR_B_U);
+
+        neon_yuv420_to_packed_pixels(y0 + x, cr, cg, cb, dst0 + bpp * x, bgr, bpp);
+        neon_yuv420_to_packed_pixels(y1 + x, cr, cg, cb, dst1 + bpp * x, bgr, bpp);
+    }
+
+    if (x < width)
+        scalar_from_yuv420_row(y0 + x, y1 + x, u + x / 2, v + x / 2, dst0 + bpp * x, dst1 + bpp * x, width - x, bgr ? 2 : 0, bgr ? 0 : 2, bpp);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_yuv420_to_bgr_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    neon_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, true, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_yuv420_to_rgb_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    neon_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, false, 3);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_yuv420_to_bgra_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    neon_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, true, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+static void neon_yuv420_to_rgba_row(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+{
+    neon_yuv420_to_packed_row(y0, y1, u, v, dst0, dst1, width, false, 4);
+}
+//----------------------------------------------------------------------------------------------
+
+static bool neon_supported(void)
+{
+    // NEON kernels are only compiled in when the target guarantees NEON
+    return true;
+}
+//----------------------------------------------------------------------------------------------
+
+#endif   // TOXCOLOR_NEON
+
+// ordered from the most preferred, scalar must be the last one
+static const ToxColorKernel toxcolor_kernel_list[] = {
+#ifdef TOXCOLOR_X86
+    {
+        "avx2",
+        avx2_supported,
+        {
+            [TOXCOLOR_FORMAT_BGR]  = avx2_bgr_to_yuv420_row,
+            [TOXCOLOR_FORMAT_RGB]  = avx2_rgb_to_yuv420_row,
+            [TOXCOLOR_FORMAT_BGRA] = avx2_bgra_to_yuv420_row,
+            [TOXCOLOR_FORMAT_RGBA] = avx2_rgba_to_yuv420_row,
+            [TOXCOLOR_FORMAT_YUYV] = avx2_yuyv_to_yuv420_row
+        },
+        {
+            [TOXCOLOR_FORMAT_BGR]  = avx2_yuv420_to_bgr_row,
+            [TOXCOLOR_FORMAT_RGB]  = avx2_yuv420_to_rgb_row,
+            [TOXCOLOR_FORMAT_BGRA] = avx2_yuv420_to_bgra_row,
+            [TOXCOLOR_FORMAT_RGBA] = avx2_yuv420_to_rgba_row
+        },
+        avx2_split_row,
+        avx2_average_row,
+        avx2_blend_row,
+        avx2_resample_row
+    },
+    {
+        "sse2",
+        sse2_supported,
+        {
+            [TOXCOLOR_FORMAT_BGR]  = sse2_bgr_to_yuv420_row,
+            [TOXCOLOR_FORMAT_RGB]  = sse2_rgb_to_yuv420_row,
+            [TOXCOLOR_FORMAT_BGRA] = sse2_bgra_to_yuv420_row,
+            [TOXCOLOR_FORMAT_RGBA] = sse2_rgba_to_yuv420_row,
+            [TOXCOLOR_FORMAT_YUYV] = sse2_yuyv_to_yuv420_row
+        },
+        {
+            [TOXCOLOR_FORMAT_BGR]  = sse2_yuv420_to_bgr_row,
+            [TOXCOLOR_FORMAT_RGB]  = sse2_yuv420_to_rgb_row,
+            [TOXCOLOR_FORMAT_BGRA] = sse2_yuv420_to_bgra_row,
+            [TOXCOLOR_FORMAT_RGBA] = sse2_yuv420_to_rgba_row
+        },
+        sse2_split_row,
+        sse2_average_row,
+        sse2_blend_row,
+        sse2_resample_row
+    },
+#endif
+#ifdef TOXCOLOR_NEON
+    {
+        "neon",
+        neon_supported,
+        {
+            [TOXCOLOR_FORMAT_BGR]  = neon_bgr_to_yuv420_row,
+            [TOXCOLOR_FORMAT_RGB]  = neon_rgb_to_yuv420_row,
+            [TOXCOLOR_FORMAT_BGRA] = neon_bgra_to_yuv420_row,
+            [TOXCOLOR_FORMAT_RGBA] = neon_rgba_to_yuv420_row,
+            [TOXCOLOR_FORMAT_YUYV] = neon_yuyv_to_yuv420_row
+        },
+        {
+            [TOXCOLOR_FORMAT_BGR]  = neon_yuv420_to_bgr_row,
+            [TOXCOLOR_FORMAT_RGB]  = neon_yuv420_to_rgb_row,
+            [TOXCOLOR_FORMAT_BGRA] = neon_yuv420_to_bgra_row,
+            [TOXCOLOR_FORMAT_RGBA] = neon_yuv420_to_rgba_row
+        },
+        neon_split_row,
+        neon_average_row,
+        neon_blend_row,
+        scalar_resample_row
+    },
+#endif
+    {
+        "scalar",
+        scalar_supported,
+        {
+            [TOXCOLOR_FORMAT_BGR]  = scalar_bgr_to_yuv420_row,
+            [TOXCOLOR_FORMAT_RGB]  = scalar_rgb_to_yuv420_row,
+            [TOXCOLOR_FORMAT_BGRA] = scalar_bgra_to_yuv420_row,
+            [TOXCOLOR_FORMAT_RGBA] = scalar_rgba_to_yuv420_row,
+            [TOXCOLOR_FORMAT_YUYV] = scalar_yuyv_to_yuv420_row
+        },
+        {
+            [TOXCOLOR_FORMAT_BGR]  = scalar_yuv420_to_bgr_row,
+            [TOXCOLOR_FORMAT_RGB]  = scalar_yuv420_to_rgb_row,
+            [TOXCOLOR_FORMAT_BGRA] = scalar_yuv420_to_bgra_row,
+            [TOXCOLOR_FORMAT_RGBA] = scalar_yuv420_to_rgba_row
+        },
+        scalar_split_row,
+        scalar_average_row,
+        scalar_blend_row,
+        scalar_resample_row
+    }
+};
+//----------------------------------------------------------------------------------------------
+
+static void toxcolor_pool_band(uint32_t band)
+{
+    uint32_t first = (uint64_t)toxcolor_pool.rows * band / toxcolor_pool.bands;
+    uint32_t last  = (uint64_t)toxcolor_pool.rows * (band + 1) / toxcolor_pool.bands;
+
+    toxcolor_pool.run(toxcolor_pool.ctx, first, last);
+}
+//----------------------------------------------------------------------------------------------
+
+static void* toxcolor_pool_worker(void* arg)
+{
+    pthread_mutex_lock(&toxcolor_pool.mutex);
+
+    while (true) {
+        while (toxcolor_pool.stop == false && toxcolor_pool.next >= toxcolor_pool.bands)
+            pthread_cond_wait(&toxcolor_pool.wake, &toxcolor_pool.mutex);
+
+        if (toxcolor_pool.stop)
+            break;
+
+        uint32_t band = toxcolor_pool.next++;
+
+        pthread_mutex_unlock(&toxcolor_pool.mutex);
+
+        toxcolor_pool_band(band);
+
+        pthread_mutex_lock(&toxcolor_pool.mutex);
+
+        toxcolor_pool.pending--;
+        if (toxcolor_pool.pending == 0)
+            pthread_cond_signal(&toxcolor_pool.done);
+    }
+
+    pthread_mutex_unlock(&toxcolor_pool.mutex);
+
+    return NULL;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxcolor_pool_stop(void)
+{
+    pthread_mutex_lock(&toxcolor_pool.mutex);
+    toxcolor_pool.stop = true;
+    pthread_cond_broadcast(&toxcolor_pool.wake);
+    pthread_mutex_unlock(&toxcolor_pool.mutex);
+
+    size_t i;
+    for (i = 0; i < toxcolor_pool.count; i++)
+        pthread_join(toxcolor_pool.threads[i], NULL);
+
+    free(toxcolor_pool.threads);
+
+    toxcolor_pool.threads = NULL;
+    toxcolor_pool.count   = 0;
+    toxcolor_pool.stop    = false;
+}
+//----------------------------------------------------------------------------------------------
+
+static bool toxcolor_pool_run(ToxColorBand run, void* ctx, uint32_t rows, uint64_t pixels)
+{
+    if (pthread_mutex_trylock(&toxcolor_pool.submit) != 0)
+        return false;
+
+    if (toxcolor_pool.count == 0 || rows < 2 || pixels < toxcolor_pool.threshold) {
+        pthread_mutex_unlock(&toxcolor_pool.submit);
+        return false;
+    }
+
+    pthread_mutex_lock(&toxcolor_pool.mutex);
+
+    toxcolor_pool.run     = run;
+    toxcolor_pool.ctx     = ctx;
+    toxcolor_pool.rows    = rows;
+    toxcolor_pool.bands   = MIN(toxcolor_pool.count + 1, rows);
+    toxcolor_pool.next    = 0;
+    toxcolor_pool.pending = toxcolor_pool.bands;
+
+    pthread_cond_broadcast(&toxcolor_pool.wake);
+
+    // calling thread takes bands too
+    while (toxcolor_pool.next < toxcolor_pool.bands) {
+        uint32_t band = toxcolor_pool.next++;
+
+        pthread_mutex_unlock(&toxcolor_pool.mutex);
+
+        toxcolor_pool_band(band);
+
+        pthread_mutex_lock(&toxcolor_pool.mutex);
+
+        toxcolor_pool.pending--;
+    }
+
+    while (toxcolor_pool.pending > 0)
+        pthread_cond_wait(&toxcolor_pool.done, &toxcolor_pool.mutex);
+
+    pthread_mutex_unlock(&toxcolor_pool.mutex);
+
+    pthread_mutex_unlock(&toxcolor_pool.submit);
+
+    return true;
+}
+//----------------------------------------------------------------------------------------------
+
+bool toxcolor_threads_set(size_t threads, uint32_t threshold)
+{
+    bool result = true;
+
+    // wait for the running job, if any
+    pthread_mutex_lock(&toxcolor_pool.submit);
+
+    toxcolor_pool_stop();
+
+    toxcolor_pool.threshold = threshold;
+
+    if (threads > 0) {
+        toxcolor_pool.threads = calloc(threads, sizeof(pthread_t));
+        if (toxcolor_pool.threads == NULL)
+            result = false;
+        else
+            while (toxcolor_pool.count < threads) {
+                if (pthread_create(&toxcolor_pool.threads[toxcolor_pool.count], NULL, toxcolor_pool_worker, NULL) != 0) {
+                    result = false;
+                    break;
+                }
+
+                toxcolor_pool.count++;
+            }
+    }
+
+    pthread_mutex_unlock(&toxcolor_pool.submit);
+
+    return result;
+}
+//----------------------------------------------------------------------------------------------
+
+size_t toxcolor_threads_get(uint32_t* threshold)
+{
+    pthread_mutex_lock(&toxcolor_pool.submit);
+
+    size_t count = toxcolor_pool.count;
+
+    if (threshold != NULL)
+        *threshold = toxcolor_pool.threshold;
+
+    pthread_mutex_unlock(&toxcolor_pool.submit);
+
+    return count;
+}
+//----------------------------------------------------------------------------------------------
+
+void toxcolor_init(void)
+{
+    size_t count = sizeof(toxcolor_kernel_list) / sizeof(toxcolor_kernel_list[0]);
+
+    size_t i;
+    for (i = 0; i < count; i++)
+        if (toxcolor_kernel_list[i].supported()) {
+            toxcolor_kernel = &toxcolor_kernel_list[i];
+            return;
+        }
+}
+//----------------------------------------------------------------------------------------------
+
+const ToxColorKernel* toxcolor_kernels(size_t* count)
+{
+    *count = sizeof(toxcolor_kernel_list) / sizeof(toxcolor_kernel_list[0]);
+    return toxcolor_kernel_list;
+}
+//----------------------------------------------------------------------------------------------
+
+size_t toxcolor_format_bpp(TOXCOLOR_FORMAT format)
+{
+    static const size_t bpp[TOXCOLOR_FORMAT_COUNT] = {
+        [TOXCOLOR_FORMAT_BGR]  = 3,
+        [TOXCOLOR_FORMAT_RGB]  = 3,
+        [TOXCOLOR_FORMAT_BGRA] = 4,
+        [TOXCOLOR_FORMAT_RGBA] = 4,
+        [TOXCOLOR_FORMAT_YUYV] = 2
+    };
+
+    return bpp[format];
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxcolor_frame_rows(void* ctx, uint32_t first, uint32_t last)
+{
+    ToxColorFrame* frame = (ToxColorFrame*)ctx;
+
+    uint32_t i;
+    for (i = first; i < last; i++) {
+        // odd height - last row is paired with itself
+        bool single = (2 * i + 1 >= frame->height);
+
+        uint8_t* packed = frame->packed + (ptrdiff_t)(2 * i) * frame->stride;
+        uint8_t* y      = frame->y + (size_t)(2 * i) * frame->ystride;
+        uint8_t* u      = frame->u + (size_t)i * frame->ustride;
+        uint8_t* v      = frame->v + (size_t)i * frame->vstride;
+
+        uint8_t* packed_next = (single ? packed : packed + frame->stride);
+        uint8_t* y_next      = (single ? y : y + frame->ystride);
+
+        if (frame->encode != NULL)
+            frame->encode(packed, packed_next, y, y_next, u, v, frame->width);
+        else
+            frame->decode(y, y_next, u, v, packed, packed_next, frame->width);
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxcolor_frame_convert(ToxColorFrame* frame)
+{
+    uint32_t pairs = (frame->height + 1) / 2;
+
+    if (toxcolor_pool_run(toxcolor_frame_rows, frame, pairs, (uint64_t)frame->width * frame->height) == false)
+        toxcolor_frame_rows(frame, 0, pairs);
+}
+//----------------------------------------------------------------------------------------------
+
+void toxcolor_to_yuv420(const ToxColorKernel* kernel, TOXCOLOR_FORMAT format, uint32_t width, uint32_t height, const uint8_t* src, ptrdiff_t stride, uint8_t* y, uint8_t* u, uint8_t* v, uint32_t ystride, uint32_t ustride, uint32_t vstride)
+{
+    ToxColorFrame frame = {
+        kernel->to_yuv420[format], NULL, width, height, (uint8_t*)src, stride, y, u, v, ystride, ustride, vstride
+    };
+
+    toxcolor_frame_convert(&frame);
+}
+//----------------------------------------------------------------------------------------------
+
+void toxcolor_from_yuv420(const ToxColorKernel* kernel, TOXCOLOR_FORMAT format, uint32_t width, uint32_t height, const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t ystride, uint32_t ustride, uint32_t vstride, uint8_t* dst, ptrdiff_t stride)
+{
+    ToxColorFrame frame = {
+        NULL, kernel->from_yuv420[format], width, height, dst, stride, (uint8_t*)y, (uint8_t*)u, (uint8_t*)v, ystride, ustride, vstride
+    };
+
+    toxcolor_frame_convert(&frame);
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxcolor_scale_tap(uint32_t i, uint32_t size, uint32_t scaled_size, uint32_t* index, uint32_t* weight)
+{
+    // pixel centers are aligned, position is in 1/256 of a source pixel; size is at least 2
+    int64_t pos = (int64_t)(((uint64_t)(2 * i + 1) * size << 8) / (2 * (uint64_t)scaled_size)) - 128;
+
+    if (pos < 0)
+        pos = 0;
+
+    *index  = (uint32_t)(pos >> 8);
+    *weight = (uint32_t)(pos & 255);
+
+    // keep the second tap inside the row, the weight then selects it alone
+    if (*index >= size - 1) {
+        *index  = size - 2;
+        *weight = 256;
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static const uint8_t* toxcolor_scale_row(const ToxColorScale* scale, uint32_t row, uint8_t* blended, uint8_t* resampled)
+{
+    const uint8_t* line;
+
+    if (scale->scaled_height == scale->height)
+        line = scale->packed + (ptrdiff_t)row * scale->stride;
+    else {
+        uint32_t index;
+        uint32_t weight;
+
+        toxcolor_scale_tap(row, scale->height, scale->scaled_height, &index, &weight);
+
+        line = scale->packed + (ptrdiff_t)index * scale->stride;
+
+        // with the width kept the blended row is the result, it must not be shared by the pair
+        uint8_t* dst = (scale->offsets == NULL ? resampled : blended);
+
+        if (weight == 256)
+            line += scale->stride;
+        else if (weight != 0) {
+            scale->kernel->blend(line, line + scale->stride, dst, scale->width * scale->bpp, weight);
+            line = dst;
+        }
+    }
+
+    if (scale->offsets == NULL)
+        return line;
+
+    scale->kernel->resample(line, resampled, scale->offsets, scale->weights, scale->scaled_width, scale->width, scale->bpp);
+
+    return resampled;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxcolor_scale_rows(void* ctx, uint32_t first, uint32_t last)
+{
+    ToxColorScale* scale = (ToxColorScale*)ctx;
+
+    // source sized blend row and two scaled rows, padded for vector stores spilling past the end
+    size_t blended_size   = (size_t)scale->width * scale->bpp;
+    size_t resampled_size = (size_t)scale->scaled_width * scale->bpp + 32;
+
+    uint8_t* scratch = malloc(blended_size + 2 * resampled_size);
+    if (scratch == NULL) {
+        scale->failed = true;
+        return;
+    }
+
+    uint8_t* blended    = scratch;
+    uint8_t* resampled0 = scratch + blended_size;
+    uint8_t* resampled1 = resampled0 + resampled_size;
+
+    uint32_t i;
+    for (i = first; i < last; i++) {
+        // odd height - last row is paired with itself
+        bool single = (2 * i + 1 >= scale->scaled_height);
+
+        uint8_t* y = scale->y + (size_t)(2 * i) * scale->ystride;
+        uint8_t* u = scale->u + (size_t)i * scale->ustride;
+        uint8_t* v = scale->v + (size_t)i * scale->vstride;
+
+        const uint8_t* packed      = toxcolor_scale_row(scale, 2 * i, blended, resampled0);
+        const uint8_t* packed_next = (single ? packed : toxcolor_scale_row(scale, 2 * i + 1, blended, resampled1));
+
+        scale->encode(packed, packed_next, y, (single ? y : y + scale->ystride), u, v, scale->scaled_width);
+    }
+
+    free(scratch);
+}
+//----------------------------------------------------------------------------------------------
+
+bool toxcolor_scale_to_yuv420(const ToxColorKernel* kernel, TOXCOLOR_FORMAT format, uint32_t width, uint32_t height, const uint8_t* src, ptrdiff_t stride, uint32_t scaled_width, uint32_t scaled_height, uint8_t* y, uint8_t* u, uint8_t* v, uint32_t ystride, uint32_t ustride, uint32_t vstride)
+{
+    /*
+     * bilinear downscale fused with the conversion: every scaled row pair is interpolated into
+     * a few cache resident rows and converted straight into the output planes, so the source
+     * is read once and no intermediate frame is written
+     */
+    ToxColorScale scale = {
+        kernel, kernel->to_yuv420[format], toxcolor_format_bpp(format), width, height, src, stride,
+        MIN(scaled_width, width), MIN(scaled_height, height), NULL, NULL, y, u, v, ystride, ustride, vstride, false
+    };
+
+    uint32_t* taps = NULL;
+
+    if (scale.scaled_width < width) {
+        taps = malloc(2 * sizeof(uint32_t) * scale.scaled_width);
+        if (taps == NULL)
+            return false;
+
+        scale.offsets = taps;
+        scale.weights = taps + scale.scaled_width;
+
+        uint32_t i;
+        for (i = 0; i < scale.scaled_width; i++) {
+            toxcolor_scale_tap(i, width, scale.scaled_width, &taps[i], &taps[scale.scaled_width + i]);
+            taps[i] *= scale.bpp;
+        }
+    }
+
+    uint32_t pairs = (scale.scaled_height + 1) / 2;
+
+    // threshold is checked against the source size, that is what gets read
+    if (toxcolor_pool_run(toxcolor_scale_rows, &scale, pairs, (uint64_t)width * height) == false)
+        toxcolor_scale_rows(&scale, 0, pairs);
+
+    free(taps);
+
+    return (scale.failed == false);
+}
+//----------------------------------------------------------------------------------------------
+
+void toxcolor_nv12_to_yuv420(const ToxColorKernel* kernel, uint32_t width, uint32_t height, const uint8_t* ysrc, const uint8_t* uvsrc, uint32_t ysrc_stride, uint32_t uvsrc_stride, uint8_t* y, uint8_t* u, uint8_t* v, uint32_t ystride, uint32_t ustride, uint32_t vstride)
+{
+    // planar layouts are plain copies, pool threads would only compete for memory bandwidth
+    uint32_t cw = (width + 1) / 2;
+    uint32_t ch = (height + 1) / 2;
+
+    uint32_t i;
+    for (i = 0; i < height; i++)
+        memcpy(y + (size_t)i * ystride, ysrc + (size_t)i * ysrc_stride, width);
+
+    for (i = 0; i < ch; i++)
+        kernel->split(uvsrc + (size_t)i * uvsrc_stride, u + (size_t)i * ustride, v + (size_t)i * vstride, cw);
+}
+//----------------------------------------------------------------------------------------------
+
+void toxcolor_i422_to_yuv420(const ToxColorKernel* kernel, uint32_t width, uint32_t height, const uint8_t* ysrc, const uint8_t* usrc, const uint8_t* vsrc, uint32_t ysrc_stride, uint32_t usrc_stride, uint32_t vsrc_stride, uint8_t* y, uint8_t* u, uint8_t* v, uint32_t ystride, uint32_t ustride, uint32_t vstride)
+{
+    uint32_t cw = (width + 1) / 2;
+    uint32_t ch = (height + 1) / 2;
+
+    uint32_t i;
+    for (i = 0; i < height; i++)
+        memcpy(y + (size_t)i * ystride, ysrc + (size_t)i * ysrc_stride, width);
+
+    for (i = 0; i < ch; i++) {
+        // odd height - last row is paired with itself
+        size_t first = 2 * i;
+        size_t next  = MIN(2 * i + 1, height - 1);
+
+        kernel->average(usrc + first * usrc_stride, usrc + next * usrc_stride, u + (size_t)i * ustride, cw);
+        kernel->average(vsrc + first * vsrc_stride, vsrc + next * vsrc_stride, v + (size_t)i * vstride, cw);
+    }
+}
+//----------------------------------------------------------------------------------------------
@@ -0,0 +1,81 @@
+/**
+ * pytoxcore
+ *
+ * Copyright (C) 2015 Anton Batenev <antonbatenev@yandex.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+//----------------------------------------------------------------------------------------------
+#ifndef _pytoxcolor_h_
+#define _pytoxcolor_h_
+//----------------------------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+//----------------------------------------------------------------------------------------------
+// frames of at least this many pixels are split across the worker pool by default
+#define TOXCOLOR_POOL_THRESHOLD (1280 * 720)
+//----------------------------------------------------------------------------------------------
+// packed pixel layouts, YUYV can only be converted to YUV420
+typedef enum {
+    TOXCOLOR_FORMAT_BGR,
+    TOXCOLOR_FORMAT_RGB,
+    TOXCOLOR_FORMAT_BGRA,
+    TOXCOLOR_FORMAT_RGBA,
+    TOXCOLOR_FORMAT_YUYV,
+    TOXCOLOR_FORMAT_COUNT
+} TOXCOLOR_FORMAT;
+//----------------------------------------------------------------------------------------------
+// converts two source rows of packed pixels into two Y rows and one row of U and V samples
+typedef void (*ToxColorToYUV420Row)(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width);
+// converts two Y rows sharing one row of U and V samples into two rows of packed pixels
+typedef void (*ToxColorFromYUV420Row)(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v, uint8_t* dst0, uint8_t* dst1, uint32_t width);
+// splits count interleaved UV pairs (NV12 chroma) into U and V samples
+typedef void (*ToxColorSplitRow)(const uint8_t* uv, uint8_t* u, uint8_t* v, uint32_t count);
+// rounded average of two rows of count samples (I422 chroma)
+typedef void (*ToxColorAverageRow)(const uint8_t* a, const uint8_t* b, uint8_t* dst, uint32_t count);
+// rounded (a * (256 - weight) + b * weight) / 256 of count bytes, 0 < weight < 256
+typedef void (*ToxColorBlendRow)(const uint8_t* a, const uint8_t* b, uint8_t* dst, uint32_t count, uint32_t weight);
+// count pixels interpolated between pixels at src + offsets[i] and the next one by weights[i] / 256,
+// src row holds width pixels
+typedef void (*ToxColorResampleRow)(const uint8_t* src, uint8_t* dst, const uint32_t* offsets, const uint32_t* weights, uint32_t count, uint32_t width, uint32_t bpp);
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    const char*           name;
+    bool                (*supported)(void);
+    ToxColorToYUV420Row   to_yuv420[TOXCOLOR_FORMAT_COUNT];
+    ToxColorFromYUV420Row from_yuv420[TOXCOLOR_FORMAT_COUNT];
+    ToxColorSplitRow      split;
+    ToxColorAverageRow    average;
+    ToxColorBlendRow      blend;
+    ToxColorResampleRow   resample;
+} ToxColorKernel;
+//----------------------------------------------------------------------------------------------
+extern const ToxColorKernel* toxcolor_kernel;
+//----------------------------------------------------------------------------------------------
+void toxcolor_init(void);
+const ToxColorKernel* toxcolor_kernels(size_t* count);
+size_t toxcolor_format_bpp(TOXCOLOR_FORMAT format);
+//----------------------------------------------------------------------------------------------
+bool toxcolor_threads_set(size_t threads, uint32_t threshold);
+size_t toxcolor_threads_get(uint32_t* threshold);
+//----------------------------------------------------------------------------------------------
+void toxcolor_to_yuv420(const ToxColorKernel* kernel, TOXCOLOR_FORMAT format, uint32_t width, uint32_t height, const uint8_t* src, ptrdiff_t stride, uint8_t* y, uint8_t* u, uint8_t* v, uint32_t ystride, uint32_t ustride, uint32_t vstride);
+void toxcolor_from_yuv420(const ToxColorKernel* kernel, TOXCOLOR_FORMAT format, uint32_t width, uint32_t height, const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t ystride, uint32_t ustride, uint32_t vstride, uint8_t* dst, ptrdiff_t stride);
+bool toxcolor_scale_to_yuv420(const ToxColorKernel* kernel, TOXCOLOR_FORMAT format, uint32_t width, uint32_t height, const uint8_t* src, ptrdiff_t stride, uint32_t scaled_width, uint32_t scaled_height, uint8_t* y, uint8_t* u, uint8_t* v, uint32_t ystride, uint32_t ustride, uint32_t vstride);
+void toxcolor_nv12_to_yuv420(const ToxColorKernel* kernel, uint32_t width, uint32_t height, const uint8_t* ysrc, const uint8_t* uvsrc, uint32_t ysrc_stride, uint32_t uvsrc_stride, uint8_t* y, uint8_t* u, uint8_t* v, uint32_t ystride, uint32_t ustride, uint32_t vstride);
+void toxcolor_i422_to_yuv420(const ToxColorKernel* kernel, uint32_t width, uint32_t height, const uint8_t* ysrc, const uint8_t* usrc, const uint8_t* vsrc, uint32_t ysrc_stride, uint32_t usrc_stride, uint32_t vsrc_stride, uint8_t* y, uint8_t* u, uint8_t* v, uint32_t ystride, uint32_t ustride, uint32_t vstride);
+//----------------------------------------------------------------------------------------------
+#endif   // _pytoxcolor_h_
+//----------------------------------------------------------------------------------------------
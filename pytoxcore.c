@@ -18,6 +18,8 @@
  */
 //----------------------------------------------------------------------------------------------
 #include "pytoxcore.h"
+#include <math.h>
+#include <dirent.h>
 //----------------------------------------------------------------------------------------------
 #define CHECK_TOX(self)                                              \
     if ((self)->tox == NULL) {                                       \
@@ -36,14 +38,38 @@ typedef enum {
 typedef enum {
     TOX_RECVFILE_COMPLETED,   // completed successfully
     TOX_RECVFILE_TIMEOUT,     // send file timeout
-    TOX_RECVFILE_ERROR        // other error
+    TOX_RECVFILE_ERROR,       // other error
+    TOX_RECVFILE_CORRUPTED,   // avatar does not match announced file_id
+    TOX_RECVFILE_CACHED       // file_id found in cache, transfer canceled
 } TOX_RECVFILE_STATUS;
 //----------------------------------------------------------------------------------------------
+typedef enum {
+    TOX_SENDQUEUE_STARTED,    // job started as tox_sendfile transfer
+    TOX_SENDQUEUE_ERROR       // job can not be started
+} TOX_SENDQUEUE_STATUS;
+//----------------------------------------------------------------------------------------------
 typedef enum {
     TOX_FILE_BUCKET_SEND,   // send_files bucket
     TOX_FILE_BUCKET_RECV    // recv_files bucket
 } TOX_FILE_BUCKET;
 //----------------------------------------------------------------------------------------------
+#define TOX_FILE_RATE_WINDOW 1.0      // instant rate averaging window (seconds)
+#define TOX_FILE_BLOCK_SIZE  262144   // file-like objects read / write block size
+//----------------------------------------------------------------------------------------------
+#define TOX_FILE_QUEUE_FRIEND_LIMIT 2    // default active queued transfers per friend
+#define TOX_FILE_QUEUE_TOTAL_LIMIT  32   // default active queued transfers total
+//----------------------------------------------------------------------------------------------
+#define TOX_FILE_PRIORITY_BUDGET 1   // default transfers per friend served before lower priorities
+//----------------------------------------------------------------------------------------------
+#define TOX_FILE_ADAPTIVE_SAMPLES 16   // chunk gaps measured before adaptive timeout applies
+#define TOX_FILE_ADAPTIVE_FLOOR   5    // default adaptive timeout floor (seconds)
+//----------------------------------------------------------------------------------------------
+#define TOX_FILE_CACHE_LIMIT 1073741824   // default received files cache size limit (bytes)
+
+#define TOX_FILE_RESTORE_MAGIC   0x50544652   // "PTFR" transfers blob magic
+#define TOX_FILE_RESTORE_VERSION 1
+#define TOX_FILE_RESTORE_EXPIRY  86400        // unclaimed restore entries lifetime (seconds)
+//----------------------------------------------------------------------------------------------
 
 static void* syserror(int err)
 {
@@ -52,6 +78,169 @@ static void* syserror(int err)
 }
 //----------------------------------------------------------------------------------------------
 
+static double toxfile_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_stats_update(ToxFileStats* stats, size_t length, bool seek, double now)
+{
+    if (stats->start == 0)
+        stats->start = now;
+
+    // exponential moving average with TOX_FILE_RATE_WINDOW seconds time constant
+    if (stats->chunks != 0)
+        stats->rate *= exp((stats->last - now) / TOX_FILE_RATE_WINDOW);
+
+    stats->rate += length / TOX_FILE_RATE_WINDOW;
+
+    stats->bytes += length;
+    stats->chunks++;
+    stats->last = now;
+
+    if (seek == true)
+        stats->seeks++;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* toxfile_stats_dict(const ToxFileStats* stats, double now)
+{
+    double idle = (stats->chunks != 0 ? now - stats->last : 0);
+    double rate = stats->rate * exp(-idle / TOX_FILE_RATE_WINDOW);
+    double span = (stats->chunks != 0 ? stats->last - stats->start : 0);
+
+    return Py_BuildValue("{s:K,s:K,s:d,s:d,s:d,s:d,s:K}",
+        "bytes",           stats->bytes,
+        "chunks",          stats->chunks,
+        "mean_chunk_size", (stats->chunks != 0 ? (double)stats->bytes / stats->chunks : 0.0),
+        "rate",            rate,
+        "average_rate",    (span > 0 ? stats->bytes / span : 0.0),
+        "idle",            idle,
+        "seeks",           stats->seeks);
+}
+//----------------------------------------------------------------------------------------------
+
+static ToxBlob* toxblob_alloc(const uint8_t* data, size_t size, const char* path, size_t path_len, int* err)
+{
+    ToxBlob* blob = malloc(sizeof(ToxBlob));
+    if (blob == NULL) {
+        *err = errno;
+        return NULL;
+    }
+
+    memset(blob, 0, sizeof(ToxBlob));
+    blob->refs = 1;
+
+    blob->data = malloc(size > 0 ? size : 1);
+    if (blob->data == NULL) {
+        *err = errno;
+        goto ERROR;
+    }
+
+    memcpy(blob->data, data, size);
+    blob->size = size;
+
+    blob->path = malloc(path_len + 1);
+    if (blob->path == NULL) {
+        *err = errno;
+        goto ERROR;
+    }
+
+    memcpy(blob->path, path, path_len);
+    blob->path[path_len] = 0;
+    blob->path_len = path_len;
+
+    if (tox_hash(blob->hash, blob->data, blob->size) == false) {
+        *err = EINVAL;
+        goto ERROR;
+    }
+
+    return blob;
+
+ERROR:
+
+    free(blob->data);
+    free(blob->path);
+    free(blob);
+
+    return NULL;
+}
+//----------------------------------------------------------------------------------------------
+
+static ToxBlob* toxblob_load(const char* path, size_t path_len, int* err)
+{
+    ToxBlob* blob = NULL;
+    uint8_t* data = NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        *err = errno;
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        *err = errno;
+        goto EXIT;
+    }
+
+    if (S_ISREG(info.st_mode) == 0) {
+        *err = EINVAL;
+        goto EXIT;
+    }
+
+    data = malloc(info.st_size > 0 ? info.st_size : 1);
+    if (data == NULL) {
+        *err = errno;
+        goto EXIT;
+    }
+
+    size_t completed = 0;
+    while (completed < (size_t)info.st_size) {
+        ssize_t actual = read(fd, data + completed, info.st_size - completed);
+        if (actual == -1) {
+            *err = errno;
+            goto EXIT;
+        } else if (actual == 0)
+            break;
+
+        completed += actual;
+    }
+
+    blob = toxblob_alloc(data, completed, path, path_len, err);
+
+EXIT:
+
+    free(data);
+    close(fd);
+
+    return blob;
+}
+//----------------------------------------------------------------------------------------------
+
+static ToxBlob* toxblob_ref(ToxBlob* blob)
+{
+    if (blob != NULL)
+        blob->refs++;
+
+    return blob;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxblob_unref(ToxBlob* blob)
+{
+    if (blob != NULL && --blob->refs == 0) {
+        free(blob->data);
+        free(blob->path);
+        free(blob);
+    }
+}
+//----------------------------------------------------------------------------------------------
+
 static ToxFile* toxfile_alloc(const char* path, size_t path_len, const uint8_t* filename, size_t filename_len, int* err)
 {
     ToxFile* item = malloc(sizeof(ToxFile));
@@ -61,7 +250,8 @@ static ToxFile* toxfile_alloc(const char* path, size_t path_len, const uint8_t*
     }
 
     memset(item, 0, sizeof(ToxFile));
-    item->fd = -1;
+    item->fd          = -1;
+    item->stats.start = toxfile_time();
 
     item->path = malloc(path_len + 1);
     if (item->path == NULL) {
@@ -95,12 +285,70 @@ ERROR:
 }
 //----------------------------------------------------------------------------------------------
 
+static void toxfile_fd_link(ToxFile* item)
+{
+    ToxFileLru* lru = item->fd_lru;
+
+    item->fd_prev = NULL;
+    item->fd_next = lru->head;
+
+    if (lru->head != NULL)
+        lru->head->fd_prev = item;
+    else
+        lru->tail = item;
+
+    lru->head = item;
+    lru->count++;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_fd_unlink(ToxFile* item)
+{
+    ToxFileLru* lru = item->fd_lru;
+
+    if (item->fd_prev != NULL)
+        item->fd_prev->fd_next = item->fd_next;
+    else
+        lru->head = item->fd_next;
+
+    if (item->fd_next != NULL)
+        item->fd_next->fd_prev = item->fd_prev;
+    else
+        lru->tail = item->fd_prev;
+
+    item->fd_prev = NULL;
+    item->fd_next = NULL;
+    lru->count--;
+}
+//----------------------------------------------------------------------------------------------
+
 static void toxfile_free(ToxFile* item)
 {
     if (item != NULL) {
-        if (item->fd != -1)
+        if (item->fd != -1) {
             close(item->fd);
+            if (item->fd_lru != NULL)
+                toxfile_fd_unlink(item);
+        }
+
+        toxblob_unref(item->blob);
 
+        if (item->view != NULL || item->stream != NULL || item->block != NULL) {
+            PyGILState_STATE gil = PyGILState_Ensure();
+
+            if (item->view != NULL)
+                PyBuffer_Release(item->view);
+
+            Py_XDECREF(item->stream);
+            Py_XDECREF(item->block);
+
+            PyGILState_Release(gil);
+
+            free(item->view);
+        }
+
+        free(item->hash);
+        free(item->pipe_buffer);
         free(item->path);
         free(item->filename);
         free(item);
@@ -122,6 +370,28 @@ static ToxFileBucket* toxfile_bucket(ToxCore* self, TOX_FILE_BUCKET bucket)
 }
 //----------------------------------------------------------------------------------------------
 
+static void toxfile_account(ToxCore* self, TOX_FILE_BUCKET file_bucket, ToxFile* item, size_t length, bool seek)
+{
+    ToxFileBucket* bucket = toxfile_bucket(self, file_bucket);
+    double         now    = toxfile_time();
+
+    // smoothed chunk inter-arrival time and mean deviation like TCP RTT estimation
+    if (item->stats.chunks == 1) {
+        item->gap_avg = now - item->stats.last;
+        item->gap_dev = item->gap_avg / 2;
+    } else if (item->stats.chunks > 1) {
+        double gap  = now - item->stats.last;
+        double diff = (gap > item->gap_avg ? gap - item->gap_avg : item->gap_avg - gap);
+
+        item->gap_dev += (diff - item->gap_dev) / 4;
+        item->gap_avg += (gap - item->gap_avg) / 8;
+    }
+
+    toxfile_stats_update(&item->stats, length, seek, now);
+    toxfile_stats_update(&bucket->stats, length, seek, now);
+}
+//----------------------------------------------------------------------------------------------
+
 static bool toxfile_add(ToxCore* self, TOX_FILE_BUCKET file_bucket, ToxFile* item, int* err)
 {
     ToxFileBucket* bucket = toxfile_bucket(self, file_bucket);
@@ -236,10 +506,242 @@ static void toxfile_purge_bucket(ToxCore* self, TOX_FILE_BUCKET file_bucket, uin
 }
 //----------------------------------------------------------------------------------------------
 
+static void toxfile_announce_remove(ToxCore* self, uint32_t friend_number, uint32_t file_number, bool any_file)
+{
+    size_t i = 0;
+    size_t j = 0;
+    for (i = 0; i < self->avatar_announces_index; i++) {
+        ToxFileAnnounce* announce = &self->avatar_announces[i];
+        if (announce->friend_number == friend_number && (any_file == true || announce->file_number == file_number))
+            continue;
+
+        self->avatar_announces[j++] = *announce;
+    }
+
+    self->avatar_announces_index = j;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_announce_add(ToxCore* self, uint32_t friend_number, uint32_t file_number, const uint8_t* file_id)
+{
+    toxfile_announce_remove(self, friend_number, file_number, false);
+
+    if (self->avatar_announces_index >= self->avatar_announces_count) {
+        size_t new_count = (self->avatar_announces_count == 0 ? 4 : self->avatar_announces_count * 2);
+
+        ToxFileAnnounce* announces = realloc(self->avatar_announces, new_count * sizeof(ToxFileAnnounce));
+        if (announces == NULL)
+            return;
+
+        self->avatar_announces       = announces;
+        self->avatar_announces_count = new_count;
+    }
+
+    ToxFileAnnounce* announce = &self->avatar_announces[self->avatar_announces_index++];
+
+    announce->friend_number = friend_number;
+    announce->file_number   = file_number;
+    memcpy(announce->file_id, file_id, TOX_FILE_ID_LENGTH);
+}
+//----------------------------------------------------------------------------------------------
+
+static bool toxfile_announce_take(ToxCore* self, uint32_t friend_number, uint32_t file_number, uint8_t* file_id)
+{
+    size_t i;
+    for (i = 0; i < self->avatar_announces_index; i++) {
+        ToxFileAnnounce* announce = &self->avatar_announces[i];
+        if (announce->friend_number == friend_number && announce->file_number == file_number) {
+            memcpy(file_id, announce->file_id, TOX_FILE_ID_LENGTH);
+            toxfile_announce_remove(self, friend_number, file_number, false);
+            return true;
+        }
+    }
+
+    return false;
+}
+//----------------------------------------------------------------------------------------------
+
+static ToxFileCoalesce* toxfile_coalesce_find(ToxCore* self, uint32_t friend_number, uint32_t file_number)
+{
+    size_t i;
+    for (i = 0; i < self->coalesce_index; i++)
+        if (self->coalesce[i].friend_number == friend_number && self->coalesce[i].file_number == file_number)
+            return &self->coalesce[i];
+
+    return NULL;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_coalesce_flush(ToxCore* self, uint32_t friend_number, uint32_t file_number)
+{
+    ToxFileCoalesce* entry = toxfile_coalesce_find(self, friend_number, file_number);
+    if (entry == NULL || entry->len == 0 || entry->data == NULL)
+        return;
+
+    // callback may cancel the transfer or change block size, which frees entries and moves the
+    // array, so the buffer is detached for the call and the entry is looked up again after it
+    uint8_t* data     = entry->data;
+    uint64_t position = entry->position;
+    size_t   len      = entry->len;
+
+    entry->data      = NULL;
+    entry->position += len;
+    entry->len       = 0;
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_file_recv_chunk_cb", "IIK" BUF_TCS, friend_number, file_number, position, data, len);
+    PyGILState_Release(gil);
+
+    entry = toxfile_coalesce_find(self, friend_number, file_number);
+    if (entry != NULL && entry->data == NULL)
+        entry->data = data;
+    else
+        free(data);
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_coalesce_remove(ToxCore* self, uint32_t friend_number, uint32_t file_number, bool any_file)
+{
+    size_t i = 0;
+    size_t j = 0;
+    for (i = 0; i < self->coalesce_index; i++) {
+        ToxFileCoalesce* entry = &self->coalesce[i];
+        if (entry->friend_number == friend_number && (any_file == true || entry->file_number == file_number)) {
+            free(entry->data);
+            continue;
+        }
+
+        self->coalesce[j++] = *entry;
+    }
+
+    self->coalesce_index = j;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_coalesce_clear(ToxCore* self)
+{
+    size_t i;
+    for (i = 0; i < self->coalesce_index; i++)
+        free(self->coalesce[i].data);
+
+    free(self->coalesce);
+
+    self->coalesce       = NULL;
+    self->coalesce_index = 0;
+    self->coalesce_count = 0;
+}
+//----------------------------------------------------------------------------------------------
+
+static ToxFileCoalesce* toxfile_coalesce_get(ToxCore* self, uint32_t friend_number, uint32_t file_number)
+{
+    // buffer of the entry being delivered is detached until its callback returns
+    ToxFileCoalesce* found = toxfile_coalesce_find(self, friend_number, file_number);
+    if (found != NULL)
+        return (found->data != NULL ? found : NULL);
+
+    if (self->coalesce_index >= self->coalesce_count) {
+        size_t new_count = (self->coalesce_count == 0 ? 4 : self->coalesce_count * 2);
+
+        ToxFileCoalesce* coalesce = realloc(self->coalesce, new_count * sizeof(ToxFileCoalesce));
+        if (coalesce == NULL)
+            return NULL;
+
+        self->coalesce       = coalesce;
+        self->coalesce_count = new_count;
+    }
+
+    ToxFileCoalesce* entry = &self->coalesce[self->coalesce_index];
+    memset(entry, 0, sizeof(ToxFileCoalesce));
+
+    entry->data = malloc(self->coalesce_size);
+    if (entry->data == NULL)
+        return NULL;
+
+    entry->friend_number = friend_number;
+    entry->file_number   = file_number;
+
+    self->coalesce_index++;
+
+    return entry;
+}
+//----------------------------------------------------------------------------------------------
+
+// return true if chunk was buffered or delivered
+static bool toxfile_coalesce_chunk(ToxCore* self, uint32_t friend_number, uint32_t file_number, uint64_t position, const uint8_t* data, size_t length)
+{
+    if (self->coalesce_size == 0)
+        return false;
+
+    ToxFileCoalesce* entry = toxfile_coalesce_get(self, friend_number, file_number);
+    if (entry == NULL)
+        return false;
+
+    // final chunk, out of order chunk or full block delivers buffered data first
+    if (length == 0 || position != entry->position + entry->len || entry->len + length > self->coalesce_size) {
+        toxfile_coalesce_flush(self, friend_number, file_number);
+
+        // callback canceled the transfer or changed block size - chunk is delivered as is
+        entry = toxfile_coalesce_get(self, friend_number, file_number);
+        if (entry == NULL)
+            return false;
+    }
+
+    if (length == 0 || length > self->coalesce_size) {
+        toxfile_coalesce_remove(self, friend_number, file_number, false);
+        return false;
+    }
+
+    if (entry->len == 0)
+        entry->position = position;
+
+    memcpy(entry->data + entry->len, data, length);
+    entry->len        += length;
+    entry->checkpoint  = time(NULL);
+
+    if (entry->len == self->coalesce_size)
+        toxfile_coalesce_flush(self, friend_number, file_number);
+
+    return true;
+}
+//----------------------------------------------------------------------------------------------
+
+// deliver buffers idle since before t, all buffers when all is set
+static void toxfile_coalesce_idle(ToxCore* self, time_t t, bool all)
+{
+    size_t i = 0;
+    while (i < self->coalesce_index) {
+        ToxFileCoalesce* entry = &self->coalesce[i];
+
+        if (entry->len != 0 && (all == true || entry->checkpoint < t)) {
+            // callback may remove entries, scan again from the start
+            toxfile_coalesce_flush(self, entry->friend_number, entry->file_number);
+            i = 0;
+        } else
+            i++;
+    }
+}
+//----------------------------------------------------------------------------------------------
+
 static void toxfile_purge(ToxCore* self, uint32_t friend_number)
 {
     toxfile_purge_bucket(self, TOX_FILE_BUCKET_SEND, friend_number);
     toxfile_purge_bucket(self, TOX_FILE_BUCKET_RECV, friend_number);
+
+    toxfile_announce_remove(self, friend_number, 0, true);
+    toxfile_coalesce_remove(self, friend_number, 0, true);
+}
+//----------------------------------------------------------------------------------------------
+
+static bool toxfile_expired(const ToxCore* self, const ToxFile* item, time_t t)
+{
+    time_t idle = t - item->checkpoint;
+
+    if (self->timeout_multiplier > 0 && item->stats.chunks > TOX_FILE_ADAPTIVE_SAMPLES) {
+        double limit = self->timeout_multiplier * (item->gap_avg + 4 * item->gap_dev);
+        return (idle > MAX(limit, (double)self->timeout_floor));
+    }
+
+    return (idle > item->timeout);
 }
 //----------------------------------------------------------------------------------------------
 
@@ -254,7 +756,7 @@ static void toxfile_purge_timeout_bucket(ToxCore* self, TOX_FILE_BUCKET file_buc
     size_t i = 0;
     for (i = 0; i < bucket->index; i++) {
         ToxFile* item = bucket->files[i];
-        if (item != NULL && (t - item->checkpoint) > item->timeout) {
+        if (item != NULL && item->paused == false && item->remote_paused == false && item->preempted == false && toxfile_expired(self, item, t) == true) {
             tox_file_control(self->tox, item->friend_number, item->file_number, TOX_FILE_CONTROL_CANCEL, NULL);
 
             switch (file_bucket) {
@@ -262,7 +764,7 @@ static void toxfile_purge_timeout_bucket(ToxCore* self, TOX_FILE_BUCKET file_buc
                     PyObject_CallMethod((PyObject*)self, "tox_sendfile_cb", "IIs#s#I", item->friend_number, item->file_number, item->path, item->path_len, item->filename, item->filename_len, TOX_SENDFILE_TIMEOUT);
                     break;
                 case TOX_FILE_BUCKET_RECV:
-                    PyObject_CallMethod((PyObject*)self, "tox_recvfile_cb", "IIs#s#I", item->friend_number, item->file_number, item->path, item->path_len, item->filename, item->filename_len, TOX_RECVFILE_TIMEOUT);
+                    PyObject_CallMethod((PyObject*)self, "tox_recvfile_cb", "IIs#s#Iz", item->friend_number, item->file_number, item->path, item->path_len, item->filename, item->filename_len, TOX_RECVFILE_TIMEOUT, NULL);
                     break;
             }
 
@@ -309,2051 +811,4798 @@ static void toxfile_clear(ToxCore* self)
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_self_connection_status(Tox* tox, TOX_CONNECTION connection_status, void* self)
+static void toxfile_fd_reserve(ToxCore* self, const ToxFile* except)
 {
-    if (connection_status == TOX_CONNECTION_NONE)
-        toxfile_clear(self);
+    while (self->fd_limit != 0 && self->fd_lru.count >= self->fd_limit) {
+        // least recently used descriptor is at the tail
+        ToxFile* victim = self->fd_lru.tail;
+        if (victim == except)
+            victim = victim->fd_prev;
 
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_self_connection_status_cb", "I", connection_status);
-    PyGILState_Release(gil);
+        if (victim == NULL)
+            break;
+
+        close(victim->fd);
+        victim->fd = -1;
+        toxfile_fd_unlink(victim);
+    }
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_friend_request(Tox* tox, const uint8_t* public_key, const uint8_t* message, size_t length, void* self)
+static void toxfile_fd_register(ToxCore* self, ToxFile* item, int flags)
 {
-    uint8_t buf[TOX_PUBLIC_KEY_SIZE * 2 + 1];
-    bytes_to_hex_string(public_key, TOX_PUBLIC_KEY_SIZE, buf);
+    toxfile_fd_reserve(self, item);
 
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_friend_request_cb", "ss#", buf, message, length);
-    PyGILState_Release(gil);
+    item->fd_flags = flags;
+    item->fd_lru   = &self->fd_lru;
+
+    toxfile_fd_link(item);
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_friend_message(Tox* tox, uint32_t friend_number, TOX_MESSAGE_TYPE type, const uint8_t* message, size_t length, void* self)
+static bool toxfile_fd_acquire(ToxCore* self, ToxFile* item)
 {
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_friend_message_cb", "Is#", friend_number, message, length);
-    PyGILState_Release(gil);
-}
-//----------------------------------------------------------------------------------------------
+    if (item->fd != -1) {
+        // move to front, most recently used
+        if (item->fd_lru != NULL && item->fd_lru->head != item) {
+            toxfile_fd_unlink(item);
+            toxfile_fd_link(item);
+        }
+        return true;
+    }
 
-static void callback_friend_name(Tox* tox, uint32_t friend_number, const uint8_t* name, size_t length, void* self)
-{
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_friend_name_cb", "Is#", friend_number, name, length);
-    PyGILState_Release(gil);
+    // only registered files can be reopened by path, positional I/O needs no seek
+    if (item->fd_lru == NULL)
+        return false;
+
+    toxfile_fd_reserve(self, item);
+
+    item->fd = open(item->path, item->fd_flags);
+    if (item->fd == -1)
+        return false;
+
+    toxfile_fd_link(item);
+
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_friend_status_message(Tox* tox, uint32_t friend_number, const uint8_t* message, size_t length, void* self)
+static bool pyobject_to_uint64(PyObject* obj, uint64_t* val)
 {
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_friend_status_message_cb", "Is#", friend_number, message, length);
-    PyGILState_Release(gil);
+    PyObject* pylong = PyNumber_Long(obj);
+    if (pylong == NULL)
+        return false;
+
+    *val = PyLong_AsUnsignedLongLong(pylong);
+
+    Py_DECREF(pylong);
+
+    return (PyErr_Occurred() == NULL);
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_friend_status(Tox* tox, uint32_t friend_number, TOX_USER_STATUS status, void* self)
+static bool toxfile_stream_seek(ToxFile* item, uint64_t position)
 {
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_friend_status_cb", "II", friend_number, status);
-    PyGILState_Release(gil);
+    PyObject* result = PyObject_CallMethod(item->stream, "seek", "Ki", item->stream_base + position, SEEK_SET);
+    if (result == NULL)
+        return false;
+
+    Py_DECREF(result);
+
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_friend_read_receipt(Tox* tox, uint32_t friend_number, uint32_t message_id, void* self)
+static uint64_t toxfile_stream_tell(ToxFile* item)
 {
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_friend_read_receipt_cb", "II", friend_number, message_id);
-    PyGILState_Release(gil);
+    uint64_t  position = UINT64_MAX;
+    PyObject* result   = PyObject_CallMethod(item->stream, "tell", NULL);
+
+    if (result == NULL || pyobject_to_uint64(result, &position) == false)
+        position = UINT64_MAX;
+
+    Py_XDECREF(result);
+
+    PyErr_Clear();
+
+    return position;
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_friend_connection_status(Tox* tox, uint32_t friend_number, TOX_CONNECTION connection_status, void* self)
+static bool toxfile_attach_stream(ToxFile* item, PyObject* stream)
 {
-    if (connection_status == TOX_CONNECTION_NONE)
-        toxfile_purge(self, friend_number);
+    item->block = PyByteArray_FromStringAndSize(NULL, TOX_FILE_BLOCK_SIZE);
+    if (item->block == NULL)
+        return false;
 
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_friend_connection_status_cb", "II", friend_number, connection_status);
-    PyGILState_Release(gil);
+    Py_INCREF(stream);
+    item->stream = stream;
+
+    item->stream_base = toxfile_stream_tell(item);
+    if (item->stream_base == UINT64_MAX)
+        item->stream_base = 0;
+
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_friend_typing(Tox* tox, uint32_t friend_number, bool is_typing, void* self)
+static uint64_t toxfile_stream_size(ToxFile* item)
 {
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_friend_typing_cb", "II", friend_number, is_typing);
-    PyGILState_Release(gil);
+    PyObject* result = PyObject_CallMethod(item->stream, "seek", "ii", 0, SEEK_END);
+    if (result == NULL) {
+        PyErr_Clear();
+        return UINT64_MAX;
+    }
+
+    Py_DECREF(result);
+
+    uint64_t end = toxfile_stream_tell(item);
+
+    if (toxfile_stream_seek(item, 0) == false) {
+        PyErr_Clear();
+        return UINT64_MAX;
+    }
+
+    if (end == UINT64_MAX || end < item->stream_base)
+        return UINT64_MAX;
+
+    return end - item->stream_base;
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_file_chunk_request(Tox* tox, uint32_t friend_number, uint32_t file_number, uint64_t position, size_t length, void* self)
+static bool toxfile_stream_fill(ToxFile* item)
 {
-    size_t index;
-    ToxFile* item = toxfile_get(self, TOX_FILE_BUCKET_SEND, friend_number, file_number, &index);
-    if (item == NULL) {
-        PyGILState_STATE gil = PyGILState_Ensure();
-        PyObject_CallMethod((PyObject*)self, "tox_file_chunk_request_cb", "IIKK", friend_number, file_number, position, length);
-        PyGILState_Release(gil);
-        return;
-    }
-
-    uint8_t* data = NULL;
+    while (item->block_len < TOX_FILE_BLOCK_SIZE) {
+        PyObject* view = PyMemoryView_FromObject(item->block);
+        if (view == NULL)
+            return false;
 
-    if (length == 0)
-        goto ERROR;
+        PyObject* tail = PySequence_GetSlice(view, item->block_len, TOX_FILE_BLOCK_SIZE);
+        Py_DECREF(view);
+        if (tail == NULL)
+            return false;
 
-    if (position + length > item->size)
-        goto ERROR;
+        PyObject* result = PyObject_CallMethod(item->stream, "readinto", "O", tail);
+        Py_DECREF(tail);
+        if (result == NULL)
+            return false;
 
-    if (item->offset != position) {
-        off_t offset = lseek(item->fd, position, SEEK_SET);
-        if (offset == -1 || offset != position)
-            goto ERROR;
+        uint64_t actual = 0;
+        bool     valid  = (result != Py_None && pyobject_to_uint64(result, &actual) == true);
 
-        item->offset = offset;
-    }
+        Py_DECREF(result);
 
-    data = malloc(length);
-    if (data == NULL)
-        goto ERROR;
+        if (valid == false || actual > TOX_FILE_BLOCK_SIZE - item->block_len)
+            return false;
 
-    size_t completed = 0;
-    while (completed < length) {
-        ssize_t actual = read(item->fd, data + completed, length - completed);
-        if (actual == -1)
-            goto ERROR;
+        if (actual == 0) {
+            item->stream_eof = true;
+            break;
+        }
 
-        completed += actual;
+        item->block_len += actual;
     }
 
-    TOX_ERR_FILE_SEND_CHUNK error;
-    bool result = tox_file_send_chunk(tox, friend_number, file_number, position, data, length, &error);
+    return true;
+}
+//----------------------------------------------------------------------------------------------
 
-    free(data);
-    data = NULL;
+static bool toxfile_stream_read(ToxFile* item, uint64_t position, size_t length, const uint8_t** chunk, size_t* actual)
+{
+    uint64_t block_end = item->block_position + item->block_len;
+
+    if (position < item->block_position || position + length > block_end) {
+        if (position < item->block_position || position > block_end || item->stream_eof == false) {
+            PyGILState_STATE gil = PyGILState_Ensure();
+
+            bool success = true;
+
+            uint8_t* block = (uint8_t*)PyByteArray_AS_STRING(item->block);
+            if (position >= item->block_position && position <= block_end) {
+                // keep tail of block and continue reading without seek
+                size_t keep = block_end - position;
+                memmove(block, block + (position - item->block_position), keep);
+                item->block_len = keep;
+            } else {
+                success = toxfile_stream_seek(item, position);
+                item->block_len  = 0;
+                item->stream_eof = false;
+            }
 
-    if (result == false || error != TOX_ERR_FILE_SEND_CHUNK_OK)
-        goto ERROR;
+            item->block_position = position;
 
-    item->offset += length;
-    item->checkpoint = time(NULL);
+            if (success == true)
+                success = toxfile_stream_fill(item);
 
-    return;
+            if (success == false) {
+                item->block_len = 0;
+                PyErr_Clear();
+            }
 
-ERROR:
+            PyGILState_Release(gil);
 
-    free(data);
+            if (success == false)
+                return false;
 
-    if (length != 0)
-        tox_file_control(tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+            block_end = item->block_position + item->block_len;
+        }
+    }
 
-    PyGILState_STATE gil = PyGILState_Ensure();
-    if (length == 0)
-        PyObject_CallMethod((PyObject*)self, "tox_sendfile_cb", "IIs#s#I", friend_number, file_number, item->path, item->path_len, item->filename, item->filename_len, TOX_SENDFILE_COMPLETED);
-    else
-        PyObject_CallMethod((PyObject*)self, "tox_sendfile_cb", "IIs#s#I", friend_number, file_number, item->path, item->path_len, item->filename, item->filename_len, TOX_SENDFILE_ERROR);
-    PyGILState_Release(gil);
+    if (position > block_end)
+        return false;
 
-    toxfile_remove(self, TOX_FILE_BUCKET_SEND, index);
+    *chunk  = (uint8_t*)PyByteArray_AS_STRING(item->block) + (position - item->block_position);
+    *actual = MIN(length, block_end - position);
+
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_file_recv(Tox* tox, uint32_t friend_number, uint32_t file_number, uint32_t kind, uint64_t file_size, const uint8_t* filename, size_t filename_length, void* self)
+static bool toxfile_stream_flush(ToxFile* item)
 {
-    PyGILState_STATE gil = PyGILState_Ensure();
+    if (item->stream == NULL || item->block_len == 0)
+        return true;
 
-    if (kind == TOX_FILE_KIND_DATA)
-        PyObject_CallMethod((PyObject*)self, "tox_file_recv_cb", "IIIKs#", friend_number, file_number, kind, file_size, filename, filename_length);
-    else if (kind == TOX_FILE_KIND_AVATAR)
-        PyObject_CallMethod((PyObject*)self, "tox_file_recv_cb", "IIIKs#", friend_number, file_number, kind, file_size, NULL, 0);
+    PyGILState_STATE gil = PyGILState_Ensure();
 
-    PyGILState_Release(gil);
-}
-//----------------------------------------------------------------------------------------------
+    const char* block   = PyByteArray_AS_STRING(item->block);
+    size_t      written = 0;
+    bool        success = true;
 
-static void callback_file_recv_control(Tox* tox, uint32_t friend_number, uint32_t file_number, TOX_FILE_CONTROL control, void* self)
-{
-    if (control == TOX_FILE_CONTROL_CANCEL) {
-        size_t index;
-        ToxFile* item = toxfile_get(self, TOX_FILE_BUCKET_SEND, friend_number, file_number, &index);
-        if (item != NULL)
-            toxfile_remove(self, TOX_FILE_BUCKET_SEND, index);
-        else {
-            item = toxfile_get(self, TOX_FILE_BUCKET_RECV, friend_number, file_number, &index);
-            if (item != NULL)
-                toxfile_remove(self, TOX_FILE_BUCKET_RECV, index);
+    while (success == true && written < item->block_len) {
+        PyObject* result = PyObject_CallMethod(item->stream, "write", BUF_TCS, block + written, item->block_len - written);
+        if (result == NULL) {
+            success = false;
+            break;
         }
+
+        // raw streams may write less than requested, buffered streams return None or full size
+        uint64_t actual = item->block_len - written;
+        if (result != Py_None && pyobject_to_uint64(result, &actual) == false)
+            success = false;
+
+        Py_DECREF(result);
+
+        if (actual == 0 || actual > item->block_len - written)
+            success = false;
+
+        written += actual;
     }
 
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_file_recv_control_cb", "III", friend_number, file_number, control);
+    if (success == false)
+        PyErr_Clear();
+
     PyGILState_Release(gil);
+
+    item->block_position += item->block_len;
+    item->block_len       = 0;
+
+    return success;
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_file_recv_chunk(Tox* tox, uint32_t friend_number, uint32_t file_number, uint64_t position, const uint8_t* data, size_t length, void* self)
+static bool toxfile_stream_write(ToxFile* item, uint64_t position, const uint8_t* data, size_t length)
 {
-    size_t index;
-    ToxFile* item = toxfile_get(self, TOX_FILE_BUCKET_RECV, friend_number, file_number, &index);
-    if (item == NULL) {
+    if (position != item->block_position + item->block_len) {
+        if (toxfile_stream_flush(item) == false)
+            return false;
+
         PyGILState_STATE gil = PyGILState_Ensure();
-        PyObject_CallMethod((PyObject*)self, "tox_file_recv_chunk_cb", "IIK" BUF_TCS, friend_number, file_number, position, data, length);
-        PyGILState_Release(gil);
-        return;
-    }
 
-    if (length == 0)
-        goto ERROR;
+        bool success = toxfile_stream_seek(item, position);
+        if (success == false)
+            PyErr_Clear();
 
-    if (position + length > item->size)
-        goto ERROR;
+        PyGILState_Release(gil);
 
-    if (item->offset != position) {
-        off_t offset = lseek(item->fd, position, SEEK_SET);
-        if (offset == -1 || offset != position)
-            goto ERROR;
+        if (success == false)
+            return false;
 
-        item->offset = offset;
+        item->block_position = position;
     }
 
-    size_t completed = 0;
-    while (completed < length) {
-        ssize_t actual = write(item->fd, data + completed, length - completed);
-        if (actual == -1)
-            goto ERROR;
+    while (length != 0) {
+        size_t size = MIN(length, TOX_FILE_BLOCK_SIZE - item->block_len);
 
-        completed += actual;
+        memcpy(PyByteArray_AS_STRING(item->block) + item->block_len, data, size);
+
+        item->block_len += size;
+        data            += size;
+        length          -= size;
+
+        if (item->block_len == TOX_FILE_BLOCK_SIZE && toxfile_stream_flush(item) == false)
+            return false;
     }
 
-    item->offset += length;
-    item->checkpoint = time(NULL);
+    return true;
+}
+//----------------------------------------------------------------------------------------------
 
-    return;
+static bool toxfile_hash_init(ToxCore* self, ToxFile* item, uint32_t friend_number, uint32_t file_number)
+{
+    item->hash = malloc(sizeof(crypto_hash_sha256_state));
+    if (item->hash == NULL)
+        return false;
 
-ERROR:
+    crypto_hash_sha256_init(item->hash);
+    item->hash_offset = 0;
 
-    if (length != 0)
-        tox_file_control(tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+    item->verify = toxfile_announce_take(self, friend_number, file_number, item->file_id);
 
-    PyGILState_STATE gil = PyGILState_Ensure();
-    if (length == 0)
-        PyObject_CallMethod((PyObject*)self, "tox_recvfile_cb", "IIs#s#I", friend_number, file_number, item->path, item->path_len, item->filename, item->filename_len, TOX_RECVFILE_COMPLETED);
-    else
-        PyObject_CallMethod((PyObject*)self, "tox_recvfile_cb", "IIs#s#I", friend_number, file_number, item->path, item->path_len, item->filename, item->filename_len, TOX_RECVFILE_ERROR);
-    PyGILState_Release(gil);
+    if (self->cache_path != NULL)
+        item->cacheable = (item->verify == true || tox_file_get_file_id(self->tox, friend_number, file_number, item->file_id, NULL) == true);
 
-    toxfile_remove(self, TOX_FILE_BUCKET_RECV, index);
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_friend_lossy_packet(Tox* tox, uint32_t friend_number, const uint8_t* data, size_t length, void* self)
+static void toxfile_hash_disable(ToxFile* item)
 {
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_friend_lossy_packet_cb", "I" BUF_TCS, friend_number, data, length);
-    PyGILState_Release(gil);
+    free(item->hash);
+    item->hash = NULL;
 }
 //----------------------------------------------------------------------------------------------
 
-static void callback_friend_lossless_packet(Tox* tox, uint32_t friend_number, const uint8_t* data, size_t length, void* self)
+static void toxfile_hash_chunk(ToxFile* item, uint64_t position, const uint8_t* data, size_t length)
 {
-    PyGILState_STATE gil = PyGILState_Ensure();
-    PyObject_CallMethod((PyObject*)self, "tox_friend_lossless_packet_cb", "I" BUF_TCS, friend_number, data, length);
-    PyGILState_Release(gil);
+    if (item->hash == NULL)
+        return;
+
+    if (position == item->hash_offset) {
+        crypto_hash_sha256_update(item->hash, data, length);
+        item->hash_offset += length;
+        return;
+    }
+
+    // stream sinks can not be read back to hash out-of-order data later
+    if (item->stream != NULL) {
+        toxfile_hash_disable(item);
+        return;
+    }
+
+    // hashed region is overwritten, rehash from start on completion
+    if (position < item->hash_offset) {
+        crypto_hash_sha256_init(item->hash);
+        item->hash_offset = 0;
+    }
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_callback_stub(ToxCore* self, PyObject* args)
+static bool toxfile_hash_final(ToxCore* self, ToxFile* item, uint8_t* digest)
 {
-    Py_RETURN_NONE;
+    if (item->hash == NULL)
+        return false;
+
+    uint64_t target = (item->size != UINT64_MAX ? item->size : item->hash_offset);
+
+    // hash data received out of order once transfer completed
+    if (item->hash_offset < target) {
+        if (item->memory != NULL)
+            crypto_hash_sha256_update(item->hash, item->memory + item->hash_offset, target - item->hash_offset);
+        else if (toxfile_fd_acquire(self, item) == true) {
+            uint8_t buffer[65536];
+            while (item->hash_offset < target) {
+                ssize_t actual = pread(item->fd, buffer, MIN(sizeof(buffer), target - item->hash_offset), item->hash_offset);
+                if (actual <= 0)
+                    return false;
+
+                crypto_hash_sha256_update(item->hash, buffer, actual);
+                item->hash_offset += actual;
+            }
+        } else
+            return false;
+    }
+
+    crypto_hash_sha256_final(item->hash, digest);
+
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_version_major(ToxCore* self, PyObject* args)
+static bool toxfile_preallocate(ToxFile* item)
 {
-    uint32_t result = tox_version_major();
+#ifdef __linux__
+    if (item->size == 0 || item->size == UINT64_MAX || item->size > INT64_MAX)
+        return true;
 
-    return PyLong_FromUnsignedLong(result);
+    // reserve blocks but keep file size growing with received chunks
+    if (fallocate(item->fd, FALLOC_FL_KEEP_SIZE, 0, item->size) == 0)
+        return true;
+
+    // filesystem without fallocate support is not an error, lack of space is
+    if (errno != ENOSPC && errno != EFBIG)
+        return true;
+
+    return false;
+#else
+    return true;
+#endif
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_version_minor(ToxCore* self, PyObject* args)
+static char* toxfile_cache_entry(ToxCore* self, const uint8_t* file_id)
 {
-    uint32_t result = tox_version_minor();
+    char* path = malloc(self->cache_path_len + 1 + TOX_FILE_ID_LENGTH * 2 + 1);
+    if (path == NULL)
+        return NULL;
 
-    return PyLong_FromUnsignedLong(result);
+    memcpy(path, self->cache_path, self->cache_path_len);
+    path[self->cache_path_len] = '/';
+
+    bytes_to_hex_string(file_id, TOX_FILE_ID_LENGTH, (uint8_t*)path + self->cache_path_len + 1);
+
+    return path;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_version_patch(ToxCore* self, PyObject* args)
+static void toxfile_cache_reset(ToxCore* self)
 {
-    uint32_t result = tox_version_patch();
+    free(self->cache_entries);
 
-    return PyLong_FromUnsignedLong(result);
+    self->cache_entries = NULL;
+    self->cache_index   = 0;
+    self->cache_count   = 0;
+    self->cache_total   = 0;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_version_is_compatible(ToxCore* self, PyObject* args)
+static ToxFileCacheEntry* toxfile_cache_find(ToxCore* self, const uint8_t* file_id)
 {
-    uint32_t major;
-    uint32_t minor;
-    uint32_t patch;
-
-    if (PyArg_ParseTuple(args, "III", &major, &minor, &patch) == false)
-        return NULL;
-
-    bool result = tox_version_is_compatible(major, minor, patch);
+    size_t i;
+    for (i = 0; i < self->cache_index; i++)
+        if (memcmp(self->cache_entries[i].file_id, file_id, TOX_FILE_ID_LENGTH) == 0)
+            return &self->cache_entries[i];
 
-    return PyBool_FromLong(result);
+    return NULL;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_options_default(ToxCore* self, PyObject* args)
+static bool toxfile_cache_add(ToxCore* self, const uint8_t* file_id, uint64_t size, time_t used)
 {
-    struct Tox_Options options;
-    tox_options_default(&options);
+    ToxFileCacheEntry* entry = toxfile_cache_find(self, file_id);
 
-    PyObject* dict = PyDict_New();
-    if (dict == NULL)
-        return NULL;
+    if (entry == NULL) {
+        if (self->cache_index >= self->cache_count) {
+            size_t new_count = (self->cache_count == 0 ? 64 : self->cache_count * 2);
 
-    PyObject* obj_ipv6_enabled = PyBool_FromLong(options.ipv6_enabled);
-    PyDict_SetItemString(dict, "ipv6_enabled", obj_ipv6_enabled);
-    Py_DECREF(obj_ipv6_enabled);
+            ToxFileCacheEntry* entries = realloc(self->cache_entries, new_count * sizeof(ToxFileCacheEntry));
+            if (entries == NULL)
+                return false;
 
-    PyObject* obj_udp_enabled = PyBool_FromLong(options.udp_enabled);
-    PyDict_SetItemString(dict, "udp_enabled", obj_udp_enabled);
-    Py_DECREF(obj_udp_enabled);
-
-    PyObject* obj_proxy_type = PyLong_FromUnsignedLong(options.proxy_type);
-    PyDict_SetItemString(dict, "proxy_type", obj_proxy_type);
-    Py_DECREF(obj_proxy_type);
-
-    PyObject* obj_proxy_host = (options.proxy_host == NULL ? PyNone_New() : PYSTRING_FromString(options.proxy_host));
-    PyDict_SetItemString(dict, "proxy_host", obj_proxy_host);
-    Py_DECREF(obj_proxy_host);
-
-    PyObject* obj_proxy_port = PyLong_FromUnsignedLong(options.proxy_port);
-    PyDict_SetItemString(dict, "proxy_port", obj_proxy_port);
-    Py_DECREF(obj_proxy_port);
-
-    PyObject* obj_start_port = PyLong_FromUnsignedLong(options.start_port);
-    PyDict_SetItemString(dict, "start_port", obj_start_port);
-    Py_DECREF(obj_start_port);
-
-    PyObject* obj_end_port = PyLong_FromUnsignedLong(options.end_port);
-    PyDict_SetItemString(dict, "end_port", obj_end_port);
-    Py_DECREF(obj_end_port);
+            self->cache_entries = entries;
+            self->cache_count   = new_count;
+        }
 
-    PyObject* obj_tcp_port = PyLong_FromUnsignedLong(options.tcp_port);
-    PyDict_SetItemString(dict, "tcp_port", obj_tcp_port);
-    Py_DECREF(obj_tcp_port);
+        entry = &self->cache_entries[self->cache_index++];
+        memcpy(entry->file_id, file_id, TOX_FILE_ID_LENGTH);
+    } else
+        self->cache_total -= entry->size;
 
-    PyObject* obj_savedata_type = PyLong_FromUnsignedLong(options.savedata_type);
-    PyDict_SetItemString(dict, "savedata_type", obj_savedata_type);
-    Py_DECREF(obj_savedata_type);
+    entry->size = size;
+    entry->used = used;
 
-    PyObject* obj_savedata_data = (options.savedata_data == NULL ? PyNone_New() : PYBYTES_FromStringAndSize((const char*)options.savedata_data, options.savedata_length));
-    PyDict_SetItemString(dict, "savedata_data", obj_savedata_data);
-    Py_DECREF(obj_savedata_data);
+    self->cache_total += size;
 
-    return dict;
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_get_address(ToxCore* self, PyObject* args)
+static void toxfile_cache_drop(ToxCore* self, ToxFileCacheEntry* entry)
 {
-    CHECK_TOX(self);
-
-    uint8_t address[TOX_ADDRESS_SIZE];
-    tox_self_get_address(self->tox, address);
+    self->cache_total -= entry->size;
 
-    uint8_t address_hex[TOX_ADDRESS_SIZE * 2 + 1];
-    bytes_to_hex_string(address, TOX_ADDRESS_SIZE, address_hex);
-
-    return PYSTRING_FromString((const char*)address_hex);
+    // order is not kept, eviction sorts entries by use anyway
+    *entry = self->cache_entries[--self->cache_index];
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_set_nospam(ToxCore* self, PyObject* args)
+/**
+ * Index cache directory once when cache is set, afterwards entries are tracked in memory and
+ * the directory is never scanned again.
+ */
+static void toxfile_cache_scan(ToxCore* self)
 {
-    CHECK_TOX(self);
+    toxfile_cache_reset(self);
 
-    uint8_t*   nospam_hex;
-    Py_ssize_t nospam_hex_len;
+    DIR* dir = opendir(self->cache_path);
+    if (dir == NULL)
+        return;
 
-    if (PyArg_ParseTuple(args, "s#", &nospam_hex, &nospam_hex_len) == false)
-        return NULL;
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL) {
+        // only entries named by hex file_id, skip temporary and foreign files
+        uint8_t file_id[TOX_FILE_ID_LENGTH];
+        if (strlen(de->d_name) != TOX_FILE_ID_LENGTH * 2 || hex_string_to_bytes((const uint8_t*)de->d_name, TOX_FILE_ID_LENGTH, file_id) == false)
+            continue;
 
-    if (nospam_hex_len != sizeof(uint32_t) * 2) {
-        PyErr_SetString(ToxCoreException, "nospam must be hex string of 4 bytes length.");
-        return NULL;
-    }
+        char* path = toxfile_cache_entry(self, file_id);
+        if (path == NULL)
+            break;
 
-    uint32_t nospam;
-    if (hex_string_to_bytes(nospam_hex, sizeof(uint32_t), (uint8_t*)(&nospam)) == false) {
-        PyErr_SetString(ToxCoreException, "Invalid nospam hex value.");
-        return NULL;
-    }
+        struct stat info;
+        bool        success = (stat(path, &info) == 0 && S_ISREG(info.st_mode) != 0);
 
-    tox_self_set_nospam(self->tox, nospam);
+        free(path);
 
-    Py_RETURN_NONE;
+        if (success == true && toxfile_cache_add(self, file_id, info.st_size, info.st_mtime) == false)
+            break;
+    }
+
+    closedir(dir);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_get_nospam(ToxCore* self, PyObject* args)
+static int toxfile_cache_compare(const void* a, const void* b)
 {
-    CHECK_TOX(self);
-
-    uint32_t result = tox_self_get_nospam(self->tox);
+    time_t ua = ((const ToxFileCacheEntry*)a)->used;
+    time_t ub = ((const ToxFileCacheEntry*)b)->used;
 
-    uint8_t result_hex[sizeof(uint32_t) * 2 + 1];
-    bytes_to_hex_string((const uint8_t*)(&result), sizeof(uint32_t), result_hex);
-
-    return PYSTRING_FromString((const char*)result_hex);
+    return (ua > ub) - (ua < ub);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_get_public_key(ToxCore* self, PyObject* args)
+static void toxfile_cache_evict(ToxCore* self)
 {
-    CHECK_TOX(self);
+    if (self->cache_limit == 0 || self->cache_total <= self->cache_limit)
+        return;
 
-    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
-    tox_self_get_public_key(self->tox, public_key);
+    // least recently used first
+    qsort(self->cache_entries, self->cache_index, sizeof(ToxFileCacheEntry), toxfile_cache_compare);
 
-    uint8_t public_key_hex[TOX_PUBLIC_KEY_SIZE * 2 + 1];
-    bytes_to_hex_string(public_key, TOX_PUBLIC_KEY_SIZE, public_key_hex);
+    size_t i;
+    for (i = 0; i < self->cache_index && self->cache_total > self->cache_limit; i++) {
+        char* path = toxfile_cache_entry(self, self->cache_entries[i].file_id);
+        if (path == NULL)
+            break;
 
-    return PYSTRING_FromString((const char*)public_key_hex);
+        unlink(path);
+        free(path);
+
+        self->cache_total -= self->cache_entries[i].size;
+    }
+
+    memmove(self->cache_entries, self->cache_entries + i, (self->cache_index - i) * sizeof(ToxFileCacheEntry));
+    self->cache_index -= i;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_get_secret_key(ToxCore* self, PyObject* args)
+static bool toxfile_cache_copy(ToxCore* self, ToxFile* item, const char* temp)
 {
-    CHECK_TOX(self);
+    if (item->memory == NULL && toxfile_fd_acquire(self, item) == false)
+        return false;
 
-    uint8_t secret_key[TOX_SECRET_KEY_SIZE];
-    tox_self_get_secret_key(self->tox, secret_key);
+    int fd = open(temp, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd == -1)
+        return false;
 
-    uint8_t secret_key_hex[TOX_SECRET_KEY_SIZE * 2 + 1];
-    bytes_to_hex_string(secret_key, TOX_SECRET_KEY_SIZE, secret_key_hex);
+    uint8_t  buffer[65536];
+    uint64_t position = 0;
+    bool     success  = true;
 
-    return PYSTRING_FromString((const char*)secret_key_hex);
-}
-//----------------------------------------------------------------------------------------------
+    while (success == true && position < item->size) {
+        const uint8_t* data   = item->memory + position;
+        ssize_t        length = item->size - position;
 
-static PyObject* ToxCore_tox_kill(ToxCore* self, PyObject* args)
-{
-    if (self->tox != NULL) {
-        tox_kill(self->tox);
-        self->tox = NULL;
+        if (item->memory == NULL) {
+            length = pread(item->fd, buffer, MIN(sizeof(buffer), item->size - position), position);
+            data   = buffer;
+        }
+
+        if (length <= 0) {
+            success = false;
+            break;
+        }
+
+        ssize_t completed = 0;
+        while (completed < length) {
+            ssize_t actual = write(fd, data + completed, length - completed);
+            if (actual <= 0) {
+                success = false;
+                break;
+            }
+
+            completed += actual;
+        }
+
+        position += completed;
     }
 
-    toxfile_clear(self);
+    close(fd);
 
-    Py_RETURN_NONE;
+    return success;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_get_savedata_size(ToxCore* self, PyObject* args)
+static void toxfile_cache_store(ToxCore* self, ToxFile* item)
 {
-    CHECK_TOX(self);
+    char* entry = toxfile_cache_entry(self, item->file_id);
+    if (entry == NULL)
+        return;
 
-    size_t size = tox_get_savedata_size(self->tox);
+    size_t entry_len = strlen(entry);
+    char*  temp      = malloc(entry_len + 5);
+    if (temp == NULL) {
+        free(entry);
+        return;
+    }
 
-    return PyLong_FromSize_t(size);
+    memcpy(temp, entry, entry_len);
+    memcpy(temp + entry_len, ".tmp", 5);
+
+    unlink(temp);
+
+    // hardlink keeps tox_iterate from copying the whole file, copy across filesystems or for
+    // buffers; rename replaces stale entry atomically
+    bool success = (item->memory == NULL && item->path_len != 0 && link(item->path, temp) == 0);
+    if (success == false)
+        success = toxfile_cache_copy(self, item, temp);
+
+    if (success == false || rename(temp, entry) != 0)
+        unlink(temp);
+    else if (toxfile_cache_add(self, item->file_id, item->size, time(NULL)) == true)
+        toxfile_cache_evict(self);
+
+    free(temp);
+    free(entry);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_get_savedata(ToxCore* self, PyObject* args)
+static bool toxfile_cache_lookup(ToxCore* self, uint32_t friend_number, uint32_t file_number, uint64_t file_size, const uint8_t* filename, size_t filename_length)
 {
-    CHECK_TOX(self);
+    if (self->cache_path == NULL || self->cache_index == 0 || file_size == 0 || file_size == UINT64_MAX)
+        return false;
 
-    size_t size = tox_get_savedata_size(self->tox);
+    uint8_t file_id[TOX_FILE_ID_LENGTH];
+    if (tox_file_get_file_id(self->tox, friend_number, file_number, file_id, NULL) == false)
+        return false;
 
-    uint8_t* savedata = (uint8_t*)malloc(size);
-    if (savedata == NULL) {
-        PyErr_SetString(ToxCoreException, "Can not allocate memory.");
-        return NULL;
+    ToxFileCacheEntry* cached = toxfile_cache_find(self, file_id);
+    if (cached == NULL || cached->size != file_size)
+        return false;
+
+    char* entry = toxfile_cache_entry(self, file_id);
+    if (entry == NULL)
+        return false;
+
+    // entry removed behind our back
+    struct stat info;
+    if (stat(entry, &info) != 0 || S_ISREG(info.st_mode) == 0 || (uint64_t)info.st_size != file_size) {
+        toxfile_cache_drop(self, cached);
+        free(entry);
+        return false;
     }
 
-    tox_get_savedata(self->tox, savedata);
+    tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
 
-    PyObject* result = PYBYTES_FromStringAndSize((const char*)savedata, size);
+    // mark entry recently used for eviction, mtime keeps the order for the next scan
+    cached->used = time(NULL);
+    utimensat(AT_FDCWD, entry, NULL, 0);
 
-    free(savedata);
+    // entries are stored only once their digest matched file_id
+    uint8_t digest_hex[TOX_FILE_ID_LENGTH * 2 + 1];
+    bytes_to_hex_string(file_id, TOX_FILE_ID_LENGTH, digest_hex);
 
-    return result;
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_recvfile_cb", "IIs#s#Iz", friend_number, file_number, entry, strlen(entry), filename, filename_length, TOX_RECVFILE_CACHED, (const char*)digest_hex);
+    PyGILState_Release(gil);
+
+    free(entry);
+
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* parse_TOX_ERR_BOOTSTRAP(bool result, TOX_ERR_BOOTSTRAP error)
+static bool toxfile_send_chunk(ToxCore* self, ToxFile* item, uint64_t position, size_t length, TOX_ERR_FILE_SEND_CHUNK* error)
 {
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_BOOTSTRAP_OK:
-            success = true;
-            break;
-        case TOX_ERR_BOOTSTRAP_NULL:
-            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
-            break;
-        case TOX_ERR_BOOTSTRAP_BAD_HOST:
-            PyErr_SetString(ToxCoreException, "The address could not be resolved to an IP address, or the IP address passed was invalid.");
-            break;
-        case TOX_ERR_BOOTSTRAP_BAD_PORT:
-            PyErr_SetString(ToxCoreException, "The port passed was invalid. The valid port range is (1, 65535).");
-            break;
-    }
+    uint8_t*       data  = NULL;
+    const uint8_t* chunk = NULL;
 
-    if (result == false || success == false)
-        return NULL;
+    *error = TOX_ERR_FILE_SEND_CHUNK_OK;
 
-    Py_RETURN_NONE;
-}
-//----------------------------------------------------------------------------------------------
+    if (position + length > item->size)
+        return false;
 
-static PyObject* ToxCore_tox_bootstrap(ToxCore* self, PyObject* args)
-{
-    CHECK_TOX(self);
+    bool seek = (item->offset != position);
 
-    char*      address;
-    Py_ssize_t address_len;
-    uint16_t   port;
-    uint8_t*   public_key_hex;
-    Py_ssize_t public_key_hex_len;
+    if (item->memory != NULL)
+        chunk = item->memory + position;
+    else if (item->stream != NULL) {
+        size_t actual;
+        if (toxfile_stream_read(item, position, length, &chunk, &actual) == false)
+            return false;
 
-    if (PyArg_ParseTuple(args, "s#Hs#", &address, &address_len, &port, &public_key_hex, &public_key_hex_len) == false)
-        return NULL;
+        // short chunk finishes stream of unknown size
+        if (actual != length && item->size != UINT64_MAX)
+            return false;
 
-    if (public_key_hex_len != TOX_PUBLIC_KEY_SIZE * 2) {
-        PyErr_SetString(ToxCoreException, "public_key must be hex string of TOX_PUBLIC_KEY_SIZE length.");
-        return NULL;
-    }
+        length = actual;
+    } else {
+        if (toxfile_fd_acquire(self, item) == false)
+            return false;
 
-    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+        data = malloc(length);
+        if (data == NULL)
+            return false;
 
-    if (hex_string_to_bytes(public_key_hex, TOX_PUBLIC_KEY_SIZE, public_key) == false) {
-        PyErr_SetString(ToxCoreException, "Invalid public_key hex value.");
-        return NULL;
+        size_t completed = 0;
+        while (completed < length) {
+            ssize_t actual = pread(item->fd, data + completed, length - completed, position + completed);
+            if (actual <= 0) {
+                free(data);
+                return false;
+            }
+
+            completed += actual;
+        }
+
+        chunk = data;
     }
 
-    PyThreadState* gil = PyEval_SaveThread();
+    bool result = tox_file_send_chunk(self->tox, item->friend_number, item->file_number, position, chunk, length, error);
 
-    TOX_ERR_BOOTSTRAP error;
-    bool result = tox_bootstrap(self->tox, address, port, public_key, &error);
+    free(data);
 
-    PyEval_RestoreThread(gil);
+    if (result == false || *error != TOX_ERR_FILE_SEND_CHUNK_OK)
+        return false;
 
-    return parse_TOX_ERR_BOOTSTRAP(result, error);
+    item->offset     = position + length;
+    item->checkpoint = time(NULL);
+
+    toxfile_account(self, TOX_FILE_BUCKET_SEND, item, length, seek);
+
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_add_tcp_relay(ToxCore* self, PyObject* args)
+static void toxfile_limit_set(ToxFileLimit* limit, uint64_t rate, uint64_t burst)
 {
-    CHECK_TOX(self);
-
-    char*      address;
-    Py_ssize_t address_len;
-    uint16_t   port;
-    uint8_t*   public_key_hex;
-    Py_ssize_t public_key_hex_len;
-
-    if (PyArg_ParseTuple(args, "s#Hs#", &address, &address_len, &port, &public_key_hex, &public_key_hex_len) == false)
-        return NULL;
-
-    if (public_key_hex_len != TOX_PUBLIC_KEY_SIZE * 2) {
-        PyErr_SetString(ToxCoreException, "public_key must be hex string of TOX_PUBLIC_KEY_SIZE length.");
-        return NULL;
-    }
+    if (burst == 0)
+        burst = rate;
 
-    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+    if (burst < TOX_MAX_CUSTOM_PACKET_SIZE)
+        burst = TOX_MAX_CUSTOM_PACKET_SIZE;
 
-    if (hex_string_to_bytes(public_key_hex, TOX_PUBLIC_KEY_SIZE, public_key) == false) {
-        PyErr_SetString(ToxCoreException, "Invalid public_key hex value.");
-        return NULL;
-    }
+    limit->rate   = rate;
+    limit->burst  = burst;
+    limit->tokens = burst;
+    limit->stamp  = toxfile_time();
+}
+//----------------------------------------------------------------------------------------------
 
-    PyThreadState* gil = PyEval_SaveThread();
+static bool toxfile_limit_check(ToxFileLimit* limit, size_t length, double now)
+{
+    if (limit == NULL || limit->rate == 0)
+        return true;
 
-    TOX_ERR_BOOTSTRAP error;
-    bool result = tox_add_tcp_relay(self->tox, address, port, public_key, &error);
+    limit->tokens += (now - limit->stamp) * limit->rate;
+    if (limit->tokens > limit->burst)
+        limit->tokens = limit->burst;
 
-    PyEval_RestoreThread(gil);
+    limit->stamp = now;
 
-    return parse_TOX_ERR_BOOTSTRAP(result, error);
+    return (limit->tokens >= length);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_get_connection_status(ToxCore* self, PyObject* args)
+static bool toxfile_limit_acquire(ToxCore* self, uint32_t friend_number, size_t length)
 {
-    CHECK_TOX(self);
+    double now = toxfile_time();
 
-    TOX_CONNECTION connection_status = tox_self_get_connection_status(self->tox);
+    ToxFileLimit* friend_limit = NULL;
+    if (friend_number < self->friend_limits_count)
+        friend_limit = &self->friend_limits[friend_number];
 
-    return PyLong_FromUnsignedLong(connection_status);
+    if (toxfile_limit_check(&self->send_limit, length, now) == false)
+        return false;
+
+    if (toxfile_limit_check(friend_limit, length, now) == false)
+        return false;
+
+    if (self->send_limit.rate != 0)
+        self->send_limit.tokens -= length;
+
+    if (friend_limit != NULL && friend_limit->rate != 0)
+        friend_limit->tokens -= length;
+
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* parse_TOX_ERR_FRIEND_ADD(uint32_t friend_number, TOX_ERR_FRIEND_ADD error)
+/**
+ * Send deferred requests while budget allows. Requests of a transfer come in order, so they are
+ * kept as one range served in chunks of the first deferred request size. First chunk budget may
+ * already be acquired by the caller.
+ */
+static bool toxfile_deferred_serve(ToxCore* self, ToxFile* item, bool acquired, TOX_ERR_FILE_SEND_CHUNK* error)
+{
+    *error = TOX_ERR_FILE_SEND_CHUNK_OK;
+
+    while (item->deferred_length != 0) {
+        size_t length = MIN(item->deferred_chunk, item->deferred_length);
+
+        if (acquired == false && toxfile_limit_acquire(self, item->friend_number, length) == false)
+            break;
+
+        acquired = false;
+
+        if (toxfile_send_chunk(self, item, item->deferred_position, length, error) == false)
+            return false;
+
+        item->deferred_position += length;
+        item->deferred_length   -= length;
+    }
+
+    return true;
+}
+//----------------------------------------------------------------------------------------------
+
+/**
+ * Keep a transfer paused while its deferred range is left, a chunk request it answers would
+ * never come otherwise. Drained range resumes the transfer unless the scheduler or the friend
+ * paused it.
+ */
+static void toxfile_deferred_settle(ToxCore* self, ToxFile* item)
+{
+    if (item->deferred_length != 0) {
+        if (item->paused == false) {
+            item->paused = true;
+            tox_file_control(self->tox, item->friend_number, item->file_number, TOX_FILE_CONTROL_PAUSE, NULL);
+        }
+    } else if (item->paused == true && item->preempted == false && item->remote_paused == false) {
+        item->paused = false;
+        tox_file_control(self->tox, item->friend_number, item->file_number, TOX_FILE_CONTROL_RESUME, NULL);
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_resume(ToxCore* self)
+{
+    ToxFileBucket* bucket = &self->send_files;
+
+    bool need_compact = false;
+
+    size_t i;
+    for (i = 0; i < bucket->index; i++) {
+        ToxFile* item = bucket->files[i];
+        if (item == NULL || item->paused == false || item->preempted == true || item->remote_paused == true)
+            continue;
+
+        if (toxfile_limit_acquire(self, item->friend_number, MIN(item->deferred_chunk, item->deferred_length)) == false)
+            continue;
+
+        item->paused = false;
+
+        tox_file_control(self->tox, item->friend_number, item->file_number, TOX_FILE_CONTROL_RESUME, NULL);
+
+        // budget ran out within the range or transfer is not running yet - pause until next pass
+        TOX_ERR_FILE_SEND_CHUNK error;
+        if (toxfile_deferred_serve(self, item, true, &error) == true || error == TOX_ERR_FILE_SEND_CHUNK_NOT_TRANSFERRING)
+            toxfile_deferred_settle(self, item);
+        else {
+            tox_file_control(self->tox, item->friend_number, item->file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+
+            PyObject_CallMethod((PyObject*)self, "tox_sendfile_cb", "IIs#s#I", item->friend_number, item->file_number, item->path, item->path_len, item->filename, item->filename_len, TOX_SENDFILE_ERROR);
+
+            toxfile_free(item);
+            bucket->files[i] = NULL;
+            need_compact = true;
+        }
+    }
+
+    if (need_compact == true)
+        toxfile_compact(bucket);
+}
+//----------------------------------------------------------------------------------------------
+
+static bool toxfile_pipe_serve(ToxCore* self, ToxFile* item)
+{
+    while (item->pending_length != 0) {
+        size_t chunk = MIN(item->pending_chunk, item->pending_length);
+
+        while (item->pipe_eof == false && item->pipe_len < chunk) {
+            ssize_t actual = read(item->fd, item->pipe_buffer + item->pipe_len, TOX_FILE_BLOCK_SIZE - item->pipe_len);
+            if (actual == 0 && item->pipe_wait == true)
+                break;
+            else if (actual == 0)
+                item->pipe_eof = true;
+            else if (actual > 0) {
+                item->pipe_len += actual;
+                item->pipe_wait = false;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            else if (errno != EINTR)
+                return false;
+        }
+
+        // wait for more data, peer is still asking for chunks
+        if (item->pipe_eof == false && item->pipe_len < chunk) {
+            item->checkpoint = time(NULL);
+            break;
+        }
+
+        // short or zero-length chunk finishes stream
+        size_t length = MIN(chunk, item->pipe_len);
+
+        if (toxfile_limit_acquire(self, item->friend_number, length) == false)
+            break;
+
+        TOX_ERR_FILE_SEND_CHUNK error;
+        bool result = tox_file_send_chunk(self->tox, item->friend_number, item->file_number, item->offset, item->pipe_buffer, length, &error);
+        if (result == false || error != TOX_ERR_FILE_SEND_CHUNK_OK)
+            return (error == TOX_ERR_FILE_SEND_CHUNK_NOT_TRANSFERRING);
+
+        memmove(item->pipe_buffer, item->pipe_buffer + length, item->pipe_len - length);
+
+        item->pipe_len       -= length;
+        item->pending_length  = (length < chunk ? 0 : item->pending_length - chunk);
+        item->offset         += length;
+        item->checkpoint      = time(NULL);
+
+        toxfile_account(self, TOX_FILE_BUCKET_SEND, item, length, false);
+    }
+
+    return true;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_pipe_pump(ToxCore* self)
+{
+    ToxFileBucket* bucket = &self->send_files;
+
+    bool need_compact = false;
+
+    size_t i;
+    for (i = 0; i < bucket->index; i++) {
+        ToxFile* item = bucket->files[i];
+        if (item == NULL || item->pipe_buffer == NULL || item->pending_length == 0)
+            continue;
+
+        if (toxfile_pipe_serve(self, item) == true)
+            continue;
+
+        tox_file_control(self->tox, item->friend_number, item->file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+
+        PyObject_CallMethod((PyObject*)self, "tox_sendfile_cb", "IIs#s#I", item->friend_number, item->file_number, item->path, item->path_len, item->filename, item->filename_len, TOX_SENDFILE_ERROR);
+
+        toxfile_free(item);
+        bucket->files[i] = NULL;
+        need_compact = true;
+    }
+
+    if (need_compact == true)
+        toxfile_compact(bucket);
+}
+//----------------------------------------------------------------------------------------------
+
+static int toxfile_priority_compare(const void* a, const void* b)
+{
+    int32_t pa = *(const int32_t*)a;
+    int32_t pb = *(const int32_t*)b;
+
+    return (pa < pb) - (pa > pb);
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_schedule(ToxCore* self, time_t t)
+{
+    ToxFileBucket* bucket = &self->send_files;
+
+    if (bucket->index == 0 || self->priority_budget == 0)
+        return;
+
+    // reschedule only when transfers or priorities changed, or once a second
+    if (self->priority_dirty == false && self->priority_index == bucket->index && self->priority_checkpoint == t)
+        return;
+
+    self->priority_dirty      = false;
+    self->priority_index      = bucket->index;
+    self->priority_checkpoint = t;
+
+    int32_t* priorities = malloc(bucket->index * sizeof(int32_t));
+    bool*    done       = calloc(bucket->index, sizeof(bool));
+    if (priorities == NULL || done == NULL)
+        goto EXIT;
+
+    size_t i;
+    size_t j;
+    for (i = 0; i < bucket->index; i++) {
+        ToxFile* item = bucket->files[i];
+        if (item == NULL || done[i] == true)
+            continue;
+
+        size_t count = 0;
+        for (j = i; j < bucket->index; j++)
+            if (bucket->files[j] != NULL && bucket->files[j]->friend_number == item->friend_number)
+                priorities[count++] = bucket->files[j]->priority;
+
+        // transfers ranked below budget run only if they tie with the last served priority
+        int32_t threshold = INT32_MIN;
+        if (count > self->priority_budget) {
+            qsort(priorities, count, sizeof(int32_t), toxfile_priority_compare);
+            threshold = priorities[self->priority_budget - 1];
+        }
+
+        for (j = i; j < bucket->index; j++) {
+            ToxFile* peer = bucket->files[j];
+            if (peer == NULL || peer->friend_number != item->friend_number)
+                continue;
+
+            done[j] = true;
+
+            bool preempt = (peer->priority < threshold);
+            if (preempt == peer->preempted)
+                continue;
+
+            // rate limited transfer is resumed by toxfile_resume
+            bool result = true;
+            if (preempt == true)
+                result = tox_file_control(self->tox, peer->friend_number, peer->file_number, TOX_FILE_CONTROL_PAUSE, NULL);
+            else if (peer->paused == false)
+                result = tox_file_control(self->tox, peer->friend_number, peer->file_number, TOX_FILE_CONTROL_RESUME, NULL);
+
+            // toxcore rejects control of transfers not accepted yet - retried on the next pass, once a second
+            if (result == false)
+                continue;
+
+            peer->preempted  = preempt;
+            peer->checkpoint = t;
+        }
+    }
+
+EXIT:
+
+    free(priorities);
+    free(done);
+}
+//----------------------------------------------------------------------------------------------
+
+static uint32_t toxfile_sendfile(ToxCore* self, uint32_t friend_number, uint32_t kind, const char* path, size_t path_len, int fd, const uint8_t* filename, size_t filename_len, uint32_t timeout, uint32_t job_id, TOX_ERR_FILE_SEND* error, int* err)
+{
+    uint8_t* data    = NULL;
+    uint8_t* file_id = NULL;
+    uint8_t  file_id_buf[TOX_FILE_ID_LENGTH];
+
+    *error = TOX_ERR_FILE_SEND_OK;
+
+    ToxFile* item = toxfile_alloc(path, path_len, filename, filename_len, err);
+    if (item == NULL) {
+        if (fd != -1)
+            close(fd);
+        return UINT32_MAX;
+    }
+
+    struct stat info;
+    int         open_flags = O_RDONLY;
+
+    if (fd == -1) {
+        if (stat(path, &info) != 0) {
+            *err = errno;
+            goto ERROR;
+        }
+
+        // opening FIFO for reading would block until writer connects, without writer it reads
+        // as EOF, so EOF only counts after the first data arrived
+        if (S_ISFIFO(info.st_mode))
+            item->pipe_wait = true;
+
+        // devices may block on open too, streams are read without blocking anyway
+        if (S_ISREG(info.st_mode) == 0)
+            open_flags |= O_NONBLOCK;
+    }
+
+    item->fd = (fd != -1 ? fd : open(path, open_flags));
+    if (item->fd == -1) {
+        *err = errno;
+        goto ERROR;
+    }
+
+    if (fstat(item->fd, &info) != 0) {
+        *err = errno;
+        goto ERROR;
+    }
+
+    if (S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode) || S_ISCHR(info.st_mode)) {
+        if (kind == TOX_FILE_KIND_AVATAR) {
+            *err = EINVAL;
+            goto ERROR;
+        }
+
+        int flags = fcntl(item->fd, F_GETFL);
+        if (flags == -1 || fcntl(item->fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+            *err = errno;
+            goto ERROR;
+        }
+
+        item->pipe_buffer = malloc(TOX_FILE_BLOCK_SIZE);
+        if (item->pipe_buffer == NULL) {
+            *err = errno;
+            goto ERROR;
+        }
+
+        info.st_size = 0;
+        item->size   = UINT64_MAX;
+    } else if (S_ISREG(info.st_mode) == 0) {
+        *err = ENOENT;
+        goto ERROR;
+    } else {
+        item->size = info.st_size;
+
+        if (path_len != 0)
+            toxfile_fd_register(self, item, O_RDONLY);
+    }
+
+    if (kind == TOX_FILE_KIND_AVATAR) {
+        data = malloc(info.st_size);
+        if (data == NULL) {
+            *err = errno;
+            goto ERROR;
+        }
+
+        while (item->offset < item->size) {
+            ssize_t actual = pread(item->fd, data + item->offset, item->size - item->offset, item->offset);
+            if (actual == -1) {
+                *err = errno;
+                goto ERROR;
+            }
+
+            if (actual == 0) {
+                *err = EIO;
+                goto ERROR;
+            }
+
+            item->offset += actual;
+        }
+
+        if (tox_hash(file_id_buf, data, item->size) == false) {
+            *err = EINVAL;
+            goto ERROR;
+        }
+
+        free(data);
+
+        data    = NULL;
+        file_id = file_id_buf;
+
+        item->offset = 0;
+    }
+
+    uint32_t file_number;
+
+    if (kind == TOX_FILE_KIND_AVATAR)
+        file_number = tox_file_send(self->tox, friend_number, kind, item->size, file_id, NULL, 0, error);
+    else
+        file_number = tox_file_send(self->tox, friend_number, kind, item->size, file_id, filename, filename_len, error);
+
+    if (*error != TOX_ERR_FILE_SEND_OK || file_number == UINT32_MAX)
+        goto ERROR;
+
+    item->checkpoint    = time(NULL);
+    item->timeout       = timeout;
+    item->friend_number = friend_number;
+    item->file_number   = file_number;
+    item->kind          = kind;
+    item->job_id        = job_id;
+
+    if (toxfile_add(self, TOX_FILE_BUCKET_SEND, item, err) == false) {
+        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+        goto ERROR;
+    }
+
+    return file_number;
+
+ERROR:
+
+    free(data);
+
+    toxfile_free(item);
+
+    return UINT32_MAX;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_job_free(ToxFileJob* job)
+{
+    free(job->path);
+    free(job->filename);
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_queue_clear(ToxFileQueue* queue)
+{
+    size_t i;
+    for (i = 0; i < queue->index; i++)
+        toxfile_job_free(&queue->jobs[i]);
+
+    free(queue->jobs);
+
+    queue->jobs  = NULL;
+    queue->index = 0;
+    queue->count = 0;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_queue_pump(ToxCore* self, time_t t)
+{
+    ToxFileQueue*  queue  = &self->send_queue;
+    ToxFileBucket* bucket = &self->send_files;
+
+    if (queue->index == 0)
+        return;
+
+    // recount active jobs only when something changed or once a second for friends going online
+    if (queue->dirty == false && queue->last_index == bucket->index && queue->checkpoint == t)
+        return;
+
+    queue->dirty      = false;
+    queue->checkpoint = t;
+
+    size_t    i;
+    uint32_t  friend_count = 0;
+    size_t    total_active = 0;
+    uint32_t* active       = NULL;
+
+    for (i = 0; i < queue->index; i++)
+        if (queue->jobs[i].friend_number >= friend_count)
+            friend_count = queue->jobs[i].friend_number + 1;
+
+    active = calloc(friend_count, sizeof(uint32_t));
+    if (active == NULL)
+        return;
+
+    for (i = 0; i < bucket->index; i++) {
+        ToxFile* item = bucket->files[i];
+        if (item != NULL && item->job_id != 0) {
+            total_active++;
+            if (item->friend_number < friend_count)
+                active[item->friend_number]++;
+        }
+    }
+
+    // callbacks may queue or cancel jobs, so a finished job leaves the array before Python runs
+    i = 0;
+    while (i < queue->index) {
+        ToxFileJob job = queue->jobs[i];
+
+        bool     started     = false;
+        bool     failed      = false;
+        uint32_t file_number = UINT32_MAX;
+
+        if (PyErr_Occurred() != NULL) {
+            // keep job, callback raised exception
+        } else if (job.friend_number >= friend_count) {
+            // queued by a callback during this pass, counted on the next one
+            queue->dirty = true;
+        } else if (queue->total_limit != 0 && total_active >= queue->total_limit) {
+            // keep job
+        } else if (queue->friend_limit != 0 && active[job.friend_number] >= queue->friend_limit) {
+            // keep job
+        } else if (tox_friend_exists(self->tox, job.friend_number) == false)
+            failed = true;
+        else if (tox_friend_get_connection_status(self->tox, job.friend_number, NULL) != TOX_CONNECTION_NONE) {
+            TOX_ERR_FILE_SEND error;
+            int               err = 0;
+
+            PyThreadState* gil = PyEval_SaveThread();
+
+            file_number = toxfile_sendfile(self, job.friend_number, job.kind, job.path, job.path_len, -1, job.filename, job.filename_len, job.timeout, job.job_id, &error, &err);
+
+            PyEval_RestoreThread(gil);
+
+            if (file_number != UINT32_MAX) {
+                started = true;
+                total_active++;
+                active[job.friend_number]++;
+            } else if (err != 0 || (error != TOX_ERR_FILE_SEND_FRIEND_NOT_CONNECTED && error != TOX_ERR_FILE_SEND_TOO_MANY))
+                failed = true;
+        }
+
+        if (started == false && failed == false) {
+            i++;
+            continue;
+        }
+
+        memmove(queue->jobs + i, queue->jobs + i + 1, (queue->index - i - 1) * sizeof(ToxFileJob));
+        queue->index--;
+
+        PyObject_CallMethod((PyObject*)self, "tox_sendqueue_cb", "IIIs#s#I", job.job_id, job.friend_number, file_number, job.path, job.path_len, job.filename, job.filename_len, (started == true ? TOX_SENDQUEUE_STARTED : TOX_SENDQUEUE_ERROR));
+
+        toxfile_job_free(&job);
+    }
+
+    queue->last_index = bucket->index;
+
+    free(active);
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_restore_free(ToxFileRestore* restore)
+{
+    free(restore->path);
+    free(restore->filename);
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_restore_clear(ToxCore* self)
+{
+    size_t i;
+    for (i = 0; i < self->restores_index; i++)
+        toxfile_restore_free(&self->restores[i]);
+
+    free(self->restores);
+
+    self->restores       = NULL;
+    self->restores_index = 0;
+    self->restores_count = 0;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_restore_remove(ToxCore* self, size_t index)
+{
+    toxfile_restore_free(&self->restores[index]);
+
+    memmove(self->restores + index, self->restores + index + 1, (self->restores_index - index - 1) * sizeof(ToxFileRestore));
+    self->restores_index--;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_restore_expire(ToxCore* self, time_t t)
+{
+    size_t i = 0;
+    while (i < self->restores_index) {
+        if (self->restores[i].expires < t)
+            toxfile_restore_remove(self, i);
+        else
+            i++;
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_restore_forget(ToxCore* self, const uint8_t* public_key)
+{
+    size_t i = 0;
+    while (i < self->restores_index) {
+        if (memcmp(self->restores[i].public_key, public_key, TOX_PUBLIC_KEY_SIZE) == 0)
+            toxfile_restore_remove(self, i);
+        else
+            i++;
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static bool toxfile_restore_arm_send(ToxCore* self, uint32_t friend_number, const ToxFileRestore* restore)
+{
+    int err = 0;
+
+    ToxFile* item = toxfile_alloc(restore->path, restore->path_len, restore->filename, restore->filename_len, &err);
+    if (item == NULL)
+        return false;
+
+    struct stat info;
+
+    item->fd = open(restore->path, O_RDONLY);
+    if (item->fd == -1 || fstat(item->fd, &info) != 0 || S_ISREG(info.st_mode) == 0 || (uint64_t)info.st_size != restore->size)
+        goto ERROR;
+
+    toxfile_fd_register(self, item, O_RDONLY);
+
+    // same file_id lets receiver recognize the transfer and seek to its offset
+    TOX_ERR_FILE_SEND error;
+    uint32_t file_number = tox_file_send(self->tox, friend_number, restore->kind, restore->size, restore->file_id, restore->filename, restore->filename_len, &error);
+    if (error != TOX_ERR_FILE_SEND_OK || file_number == UINT32_MAX)
+        goto ERROR;
+
+    item->size          = restore->size;
+    item->offset        = restore->offset;
+    item->checkpoint    = time(NULL);
+    item->timeout       = restore->timeout;
+    item->friend_number = friend_number;
+    item->file_number   = file_number;
+    item->kind          = restore->kind;
+
+    if (toxfile_add(self, TOX_FILE_BUCKET_SEND, item, &err) == false) {
+        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+        goto ERROR;
+    }
+
+    return true;
+
+ERROR:
+
+    toxfile_free(item);
+
+    return false;
+}
+//----------------------------------------------------------------------------------------------
+
+static void toxfile_restore_friend(ToxCore* self, uint32_t friend_number)
+{
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+    if (tox_friend_get_public_key(self->tox, friend_number, public_key, NULL) == false)
+        return;
+
+    size_t i = 0;
+    while (i < self->restores_index) {
+        ToxFileRestore* restore = &self->restores[i];
+        // entry failed to arm is retried on next connection until it expires
+        if (restore->send == true && memcmp(restore->public_key, public_key, TOX_PUBLIC_KEY_SIZE) == 0 &&
+            toxfile_restore_arm_send(self, friend_number, restore) == true)
+            toxfile_restore_remove(self, i);
+        else
+            i++;
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static bool toxfile_restore_recv(ToxCore* self, uint32_t friend_number, uint32_t file_number, uint64_t file_size)
+{
+    if (self->restores_index == 0)
+        return false;
+
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+    uint8_t file_id[TOX_FILE_ID_LENGTH];
+
+    if (tox_friend_get_public_key(self->tox, friend_number, public_key, NULL) == false ||
+        tox_file_get_file_id(self->tox, friend_number, file_number, file_id, NULL) == false)
+        return false;
+
+    size_t i;
+    for (i = 0; i < self->restores_index; i++) {
+        ToxFileRestore* restore = &self->restores[i];
+        if (restore->send == false && restore->size == file_size &&
+            memcmp(restore->public_key, public_key, TOX_PUBLIC_KEY_SIZE) == 0 &&
+            memcmp(restore->file_id, file_id, TOX_FILE_ID_LENGTH) == 0)
+            break;
+    }
+
+    if (i == self->restores_index)
+        return false;
+
+    ToxFileRestore* restore = &self->restores[i];
+
+    int err = 0;
+
+    ToxFile* item = toxfile_alloc(restore->path, restore->path_len, restore->filename, restore->filename_len, &err);
+    if (item == NULL)
+        return false;
+
+    // keep received part, continue from saved offset
+    item->fd = open(restore->path, O_CREAT | O_RDWR, 0644);
+    if (item->fd == -1)
+        goto ERROR;
+
+    toxfile_fd_register(self, item, O_RDWR);
+
+    // file lost or truncated since save, receive it again from start
+    uint64_t offset = restore->offset;
+
+    struct stat info;
+    if (fstat(item->fd, &info) != 0 || (uint64_t)info.st_size < offset)
+        offset = 0;
+
+    item->size = file_size;
+
+    if (toxfile_hash_init(self, item, friend_number, file_number) == false)
+        goto ERROR;
+
+    if (restore->kind == TOX_FILE_KIND_AVATAR) {
+        memcpy(item->file_id, file_id, TOX_FILE_ID_LENGTH);
+        item->verify = true;
+    }
+
+    if (offset != 0 && tox_file_seek(self->tox, friend_number, file_number, offset, NULL) == false)
+        goto ERROR;
+
+    if (tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_RESUME, NULL) == false)
+        goto ERROR;
+
+    item->offset        = offset;
+    item->checkpoint    = time(NULL);
+    item->timeout       = restore->timeout;
+    item->friend_number = friend_number;
+    item->file_number   = file_number;
+    item->kind          = restore->kind;
+
+    if (toxfile_add(self, TOX_FILE_BUCKET_RECV, item, &err) == false) {
+        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+        goto ERROR;
+    }
+
+    toxfile_restore_remove(self, i);
+
+    return true;
+
+ERROR:
+
+    toxfile_free(item);
+
+    return false;
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_self_connection_status(Tox* tox, TOX_CONNECTION connection_status, void* self)
+{
+    if (connection_status == TOX_CONNECTION_NONE)
+        toxfile_clear(self);
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_self_connection_status_cb", "I", connection_status);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_friend_request(Tox* tox, const uint8_t* public_key, const uint8_t* message, size_t length, void* self)
+{
+    uint8_t buf[TOX_PUBLIC_KEY_SIZE * 2 + 1];
+    bytes_to_hex_string(public_key, TOX_PUBLIC_KEY_SIZE, buf);
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_friend_request_cb", "ss#", buf, message, length);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_friend_message(Tox* tox, uint32_t friend_number, TOX_MESSAGE_TYPE type, const uint8_t* message, size_t length, void* self)
+{
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_friend_message_cb", "Is#", friend_number, message, length);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_friend_name(Tox* tox, uint32_t friend_number, const uint8_t* name, size_t length, void* self)
+{
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_friend_name_cb", "Is#", friend_number, name, length);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_friend_status_message(Tox* tox, uint32_t friend_number, const uint8_t* message, size_t length, void* self)
+{
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_friend_status_message_cb", "Is#", friend_number, message, length);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_friend_status(Tox* tox, uint32_t friend_number, TOX_USER_STATUS status, void* self)
+{
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_friend_status_cb", "II", friend_number, status);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_friend_read_receipt(Tox* tox, uint32_t friend_number, uint32_t message_id, void* self)
+{
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_friend_read_receipt_cb", "II", friend_number, message_id);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_friend_connection_status(Tox* tox, uint32_t friend_number, TOX_CONNECTION connection_status, void* self)
+{
+    if (connection_status == TOX_CONNECTION_NONE)
+        toxfile_purge(self, friend_number);
+    else
+        toxfile_restore_friend(self, friend_number);
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_friend_connection_status_cb", "II", friend_number, connection_status);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_friend_typing(Tox* tox, uint32_t friend_number, bool is_typing, void* self)
+{
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_friend_typing_cb", "II", friend_number, is_typing);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_file_chunk_request(Tox* tox, uint32_t friend_number, uint32_t file_number, uint64_t position, size_t length, void* self)
+{
+    size_t index;
+    ToxFile* item = toxfile_get(self, TOX_FILE_BUCKET_SEND, friend_number, file_number, &index);
+    if (item == NULL) {
+        PyGILState_STATE gil = PyGILState_Ensure();
+        PyObject_CallMethod((PyObject*)self, "tox_file_chunk_request_cb", "IIKK", friend_number, file_number, position, length);
+        PyGILState_Release(gil);
+        return;
+    }
+
+    // streamed fd answers requests in order as data arrives
+    if (item->pipe_buffer != NULL) {
+        if (length == 0)
+            goto ERROR;
+
+        if (item->pending_length == 0)
+            item->pending_chunk = length;
+
+        item->pending_length += length;
+
+        if (toxfile_pipe_serve(self, item) == false)
+            goto ERROR;
+
+        return;
+    }
+
+    TOX_ERR_FILE_SEND_CHUNK error;
+
+    if (item->deferred_length != 0 && length != 0) {
+        // pause was not applied or friend paused transfer too - request joins deferred range,
+        // which goes first and only as budget allows
+        item->deferred_length += length;
+
+        if (toxfile_deferred_serve(self, item, false, &error) == false && error != TOX_ERR_FILE_SEND_CHUNK_NOT_TRANSFERRING)
+            goto ERROR;
+
+        toxfile_deferred_settle(self, item);
+
+        return;
+    }
+
+    if (length == 0)
+        goto ERROR;
+
+    if (toxfile_limit_acquire(self, friend_number, length) == false) {
+        item->deferred_position = position;
+        item->deferred_length   = length;
+        item->deferred_chunk    = length;
+        item->paused            = true;
+
+        tox_file_control(tox, friend_number, file_number, TOX_FILE_CONTROL_PAUSE, NULL);
+
+        return;
+    }
+
+    if (toxfile_send_chunk(self, item, position, length, &error) == false)
+        goto ERROR;
+
+    return;
+
+ERROR:
+
+    if (length != 0)
+        tox_file_control(tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+    if (length == 0)
+        PyObject_CallMethod((PyObject*)self, "tox_sendfile_cb", "IIs#s#I", friend_number, file_number, item->path, item->path_len, item->filename, item->filename_len, TOX_SENDFILE_COMPLETED);
+    else
+        PyObject_CallMethod((PyObject*)self, "tox_sendfile_cb", "IIs#s#I", friend_number, file_number, item->path, item->path_len, item->filename, item->filename_len, TOX_SENDFILE_ERROR);
+    PyGILState_Release(gil);
+
+    toxfile_remove(self, TOX_FILE_BUCKET_SEND, index);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_file_recv(Tox* tox, uint32_t friend_number, uint32_t file_number, uint32_t kind, uint64_t file_size, const uint8_t* filename, size_t filename_length, void* self)
+{
+    if (toxfile_restore_recv(self, friend_number, file_number, file_size) == true)
+        return;
+
+    if (toxfile_cache_lookup(self, friend_number, file_number, file_size, filename, filename_length) == true)
+        return;
+
+    if (kind == TOX_FILE_KIND_AVATAR) {
+        uint8_t file_id[TOX_FILE_ID_LENGTH];
+        if (tox_file_get_file_id(tox, friend_number, file_number, file_id, NULL) == true)
+            toxfile_announce_add(self, friend_number, file_number, file_id);
+    }
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+
+    if (kind == TOX_FILE_KIND_DATA)
+        PyObject_CallMethod((PyObject*)self, "tox_file_recv_cb", "IIIKs#", friend_number, file_number, kind, file_size, filename, filename_length);
+    else if (kind == TOX_FILE_KIND_AVATAR)
+        PyObject_CallMethod((PyObject*)self, "tox_file_recv_cb", "IIIKs#", friend_number, file_number, kind, file_size, NULL, 0);
+
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_file_recv_control(Tox* tox, uint32_t friend_number, uint32_t file_number, TOX_FILE_CONTROL control, void* self)
+{
+    if (control == TOX_FILE_CONTROL_CANCEL) {
+        toxfile_announce_remove(self, friend_number, file_number, false);
+        toxfile_coalesce_remove(self, friend_number, file_number, false);
+
+        size_t index;
+        ToxFile* item = toxfile_get(self, TOX_FILE_BUCKET_SEND, friend_number, file_number, &index);
+        if (item != NULL)
+            toxfile_remove(self, TOX_FILE_BUCKET_SEND, index);
+        else {
+            item = toxfile_get(self, TOX_FILE_BUCKET_RECV, friend_number, file_number, &index);
+            if (item != NULL)
+                toxfile_remove(self, TOX_FILE_BUCKET_RECV, index);
+        }
+    } else {
+        size_t index;
+        ToxFile* item = toxfile_get(self, TOX_FILE_BUCKET_SEND, friend_number, file_number, &index);
+        if (item == NULL)
+            item = toxfile_get(self, TOX_FILE_BUCKET_RECV, friend_number, file_number, &index);
+
+        // transfer paused by friend is not idle, timeout counts again from resume
+        if (item != NULL) {
+            item->remote_paused = (control == TOX_FILE_CONTROL_PAUSE);
+            item->checkpoint    = time(NULL);
+        }
+    }
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_file_recv_control_cb", "III", friend_number, file_number, control);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_file_recv_chunk(Tox* tox, uint32_t friend_number, uint32_t file_number, uint64_t position, const uint8_t* data, size_t length, void* self)
+{
+    size_t index;
+    ToxFile* item = toxfile_get(self, TOX_FILE_BUCKET_RECV, friend_number, file_number, &index);
+    if (item == NULL) {
+        if (toxfile_coalesce_chunk(self, friend_number, file_number, position, data, length) == true)
+            return;
+
+        PyGILState_STATE gil = PyGILState_Ensure();
+        PyObject_CallMethod((PyObject*)self, "tox_file_recv_chunk_cb", "IIK" BUF_TCS, friend_number, file_number, position, data, length);
+        PyGILState_Release(gil);
+        return;
+    }
+
+    if (length == 0)
+        goto ERROR;
+
+    if (position + length > item->size)
+        goto ERROR;
+
+    bool seek = (item->offset != position);
+
+    if (item->memory != NULL)
+        memcpy(item->memory + position, data, length);
+    else if (item->stream != NULL) {
+        if (toxfile_stream_write(item, position, data, length) == false)
+            goto ERROR;
+    } else {
+        if (toxfile_fd_acquire(self, item) == false)
+            goto ERROR;
+
+        size_t completed = 0;
+        while (completed < length) {
+            ssize_t actual = pwrite(item->fd, data + completed, length - completed, position + completed);
+            if (actual <= 0)
+                goto ERROR;
+
+            completed += actual;
+        }
+    }
+
+    toxfile_hash_chunk(item, position, data, length);
+
+    item->offset = position + length;
+    item->checkpoint = time(NULL);
+
+    toxfile_account(self, TOX_FILE_BUCKET_RECV, item, length, seek);
+
+    return;
+
+ERROR:
+
+    if (length != 0)
+        tox_file_control(tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+
+    TOX_RECVFILE_STATUS status = TOX_RECVFILE_ERROR;
+
+    uint8_t digest[crypto_hash_sha256_BYTES];
+    uint8_t digest_hex[crypto_hash_sha256_BYTES * 2 + 1];
+    bool    has_digest = false;
+
+    if (length == 0 && toxfile_stream_flush(item) == true) {
+        status     = TOX_RECVFILE_COMPLETED;
+        has_digest = toxfile_hash_final(self, item, digest);
+
+        if (has_digest == true) {
+            bytes_to_hex_string(digest, sizeof(digest), digest_hex);
+
+            if (item->verify == true && memcmp(digest, item->file_id, TOX_FILE_ID_LENGTH) != 0)
+                status = TOX_RECVFILE_CORRUPTED;
+        }
+
+        // only content addressed transfers are cached, file_id of anything else can not be trusted
+        if (status == TOX_RECVFILE_COMPLETED && has_digest == true && memcmp(digest, item->file_id, TOX_FILE_ID_LENGTH) == 0 &&
+            item->cacheable == true && item->stream == NULL && ((ToxCore*)self)->cache_path != NULL)
+            toxfile_cache_store(self, item);
+    }
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_recvfile_cb", "IIs#s#Iz", friend_number, file_number, item->path, item->path_len, item->filename, item->filename_len, status, (has_digest == true ? (const char*)digest_hex : NULL));
+    PyGILState_Release(gil);
+
+    toxfile_remove(self, TOX_FILE_BUCKET_RECV, index);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_friend_lossy_packet(Tox* tox, uint32_t friend_number, const uint8_t* data, size_t length, void* self)
+{
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_friend_lossy_packet_cb", "I" BUF_TCS, friend_number, data, length);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static void callback_friend_lossless_packet(Tox* tox, uint32_t friend_number, const uint8_t* data, size_t length, void* self)
+{
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject_CallMethod((PyObject*)self, "tox_friend_lossless_packet_cb", "I" BUF_TCS, friend_number, data, length);
+    PyGILState_Release(gil);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_callback_stub(ToxCore* self, PyObject* args)
+{
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_version_major(ToxCore* self, PyObject* args)
+{
+    uint32_t result = tox_version_major();
+
+    return PyLong_FromUnsignedLong(result);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_version_minor(ToxCore* self, PyObject* args)
+{
+    uint32_t result = tox_version_minor();
+
+    return PyLong_FromUnsignedLong(result);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_version_patch(ToxCore* self, PyObject* args)
+{
+    uint32_t result = tox_version_patch();
+
+    return PyLong_FromUnsignedLong(result);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_version_is_compatible(ToxCore* self, PyObject* args)
+{
+    uint32_t major;
+    uint32_t minor;
+    uint32_t patch;
+
+    if (PyArg_ParseTuple(args, "III", &major, &minor, &patch) == false)
+        return NULL;
+
+    bool result = tox_version_is_compatible(major, minor, patch);
+
+    return PyBool_FromLong(result);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_options_default(ToxCore* self, PyObject* args)
+{
+    struct Tox_Options options;
+    tox_options_default(&options);
+
+    PyObject* dict = PyDict_New();
+    if (dict == NULL)
+        return NULL;
+
+    PyObject* obj_ipv6_enabled = PyBool_FromLong(options.ipv6_enabled);
+    PyDict_SetItemString(dict, "ipv6_enabled", obj_ipv6_enabled);
+    Py_DECREF(obj_ipv6_enabled);
+
+    PyObject* obj_udp_enabled = PyBool_FromLong(options.udp_enabled);
+    PyDict_SetItemString(dict, "udp_enabled", obj_udp_enabled);
+    Py_DECREF(obj_udp_enabled);
+
+    PyObject* obj_proxy_type = PyLong_FromUnsignedLong(options.proxy_type);
+    PyDict_SetItemString(dict, "proxy_type", obj_proxy_type);
+    Py_DECREF(obj_proxy_type);
+
+    PyObject* obj_proxy_host = (options.proxy_host == NULL ? PyNone_New() : PYSTRING_FromString(options.proxy_host));
+    PyDict_SetItemString(dict, "proxy_host", obj_proxy_host);
+    Py_DECREF(obj_proxy_host);
+
+    PyObject* obj_proxy_port = PyLong_FromUnsignedLong(options.proxy_port);
+    PyDict_SetItemString(dict, "proxy_port", obj_proxy_port);
+    Py_DECREF(obj_proxy_port);
+
+    PyObject* obj_start_port = PyLong_FromUnsignedLong(options.start_port);
+    PyDict_SetItemString(dict, "start_port", obj_start_port);
+    Py_DECREF(obj_start_port);
+
+    PyObject* obj_end_port = PyLong_FromUnsignedLong(options.end_port);
+    PyDict_SetItemString(dict, "end_port", obj_end_port);
+    Py_DECREF(obj_end_port);
+
+    PyObject* obj_tcp_port = PyLong_FromUnsignedLong(options.tcp_port);
+    PyDict_SetItemString(dict, "tcp_port", obj_tcp_port);
+    Py_DECREF(obj_tcp_port);
+
+    PyObject* obj_savedata_type = PyLong_FromUnsignedLong(options.savedata_type);
+    PyDict_SetItemString(dict, "savedata_type", obj_savedata_type);
+    Py_DECREF(obj_savedata_type);
+
+    PyObject* obj_savedata_data = (options.savedata_data == NULL ? PyNone_New() : PYBYTES_FromStringAndSize((const char*)options.savedata_data, options.savedata_length));
+    PyDict_SetItemString(dict, "savedata_data", obj_savedata_data);
+    Py_DECREF(obj_savedata_data);
+
+    return dict;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_address(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t address[TOX_ADDRESS_SIZE];
+    tox_self_get_address(self->tox, address);
+
+    uint8_t address_hex[TOX_ADDRESS_SIZE * 2 + 1];
+    bytes_to_hex_string(address, TOX_ADDRESS_SIZE, address_hex);
+
+    return PYSTRING_FromString((const char*)address_hex);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_set_nospam(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t*   nospam_hex;
+    Py_ssize_t nospam_hex_len;
+
+    if (PyArg_ParseTuple(args, "s#", &nospam_hex, &nospam_hex_len) == false)
+        return NULL;
+
+    if (nospam_hex_len != sizeof(uint32_t) * 2) {
+        PyErr_SetString(ToxCoreException, "nospam must be hex string of 4 bytes length.");
+        return NULL;
+    }
+
+    uint32_t nospam;
+    if (hex_string_to_bytes(nospam_hex, sizeof(uint32_t), (uint8_t*)(&nospam)) == false) {
+        PyErr_SetString(ToxCoreException, "Invalid nospam hex value.");
+        return NULL;
+    }
+
+    tox_self_set_nospam(self->tox, nospam);
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_nospam(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t result = tox_self_get_nospam(self->tox);
+
+    uint8_t result_hex[sizeof(uint32_t) * 2 + 1];
+    bytes_to_hex_string((const uint8_t*)(&result), sizeof(uint32_t), result_hex);
+
+    return PYSTRING_FromString((const char*)result_hex);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_public_key(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+    tox_self_get_public_key(self->tox, public_key);
+
+    uint8_t public_key_hex[TOX_PUBLIC_KEY_SIZE * 2 + 1];
+    bytes_to_hex_string(public_key, TOX_PUBLIC_KEY_SIZE, public_key_hex);
+
+    return PYSTRING_FromString((const char*)public_key_hex);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_secret_key(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t secret_key[TOX_SECRET_KEY_SIZE];
+    tox_self_get_secret_key(self->tox, secret_key);
+
+    uint8_t secret_key_hex[TOX_SECRET_KEY_SIZE * 2 + 1];
+    bytes_to_hex_string(secret_key, TOX_SECRET_KEY_SIZE, secret_key_hex);
+
+    return PYSTRING_FromString((const char*)secret_key_hex);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_kill(ToxCore* self, PyObject* args)
+{
+    if (self->tox != NULL) {
+        tox_kill(self->tox);
+        self->tox = NULL;
+    }
+
+    toxfile_clear(self);
+
+    toxblob_unref(self->avatar);
+    self->avatar = NULL;
+
+    free(self->friend_limits);
+    self->friend_limits       = NULL;
+    self->friend_limits_count = 0;
+
+    memset(&self->send_limit, 0, sizeof(ToxFileLimit));
+
+    toxfile_queue_clear(&self->send_queue);
+
+    free(self->avatar_announces);
+    self->avatar_announces       = NULL;
+    self->avatar_announces_index = 0;
+    self->avatar_announces_count = 0;
+
+    free(self->cache_path);
+    self->cache_path     = NULL;
+    self->cache_path_len = 0;
+
+    toxfile_cache_reset(self);
+
+    self->fd_lru.head  = NULL;
+    self->fd_lru.tail  = NULL;
+    self->fd_lru.count = 0;
+
+    toxfile_restore_clear(self);
+
+    toxfile_coalesce_clear(self);
+    self->coalesce_size = 0;
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_get_savedata_size(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    size_t size = tox_get_savedata_size(self->tox);
+
+    return PyLong_FromSize_t(size);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_get_savedata(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    size_t size = tox_get_savedata_size(self->tox);
+
+    uint8_t* savedata = (uint8_t*)malloc(size);
+    if (savedata == NULL) {
+        PyErr_SetString(ToxCoreException, "Can not allocate memory.");
+        return NULL;
+    }
+
+    tox_get_savedata(self->tox, savedata);
+
+    PyObject* result = PYBYTES_FromStringAndSize((const char*)savedata, size);
+
+    free(savedata);
+
+    return result;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* parse_TOX_ERR_BOOTSTRAP(bool result, TOX_ERR_BOOTSTRAP error)
+{
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_BOOTSTRAP_OK:
+            success = true;
+            break;
+        case TOX_ERR_BOOTSTRAP_NULL:
+            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
+            break;
+        case TOX_ERR_BOOTSTRAP_BAD_HOST:
+            PyErr_SetString(ToxCoreException, "The address could not be resolved to an IP address, or the IP address passed was invalid.");
+            break;
+        case TOX_ERR_BOOTSTRAP_BAD_PORT:
+            PyErr_SetString(ToxCoreException, "The port passed was invalid. The valid port range is (1, 65535).");
+            break;
+    }
+
+    if (result == false || success == false)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_bootstrap(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    char*      address;
+    Py_ssize_t address_len;
+    uint16_t   port;
+    uint8_t*   public_key_hex;
+    Py_ssize_t public_key_hex_len;
+
+    if (PyArg_ParseTuple(args, "s#Hs#", &address, &address_len, &port, &public_key_hex, &public_key_hex_len) == false)
+        return NULL;
+
+    if (public_key_hex_len != TOX_PUBLIC_KEY_SIZE * 2) {
+        PyErr_SetString(ToxCoreException, "public_key must be hex string of TOX_PUBLIC_KEY_SIZE length.");
+        return NULL;
+    }
+
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+
+    if (hex_string_to_bytes(public_key_hex, TOX_PUBLIC_KEY_SIZE, public_key) == false) {
+        PyErr_SetString(ToxCoreException, "Invalid public_key hex value.");
+        return NULL;
+    }
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_BOOTSTRAP error;
+    bool result = tox_bootstrap(self->tox, address, port, public_key, &error);
+
+    PyEval_RestoreThread(gil);
+
+    return parse_TOX_ERR_BOOTSTRAP(result, error);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_add_tcp_relay(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    char*      address;
+    Py_ssize_t address_len;
+    uint16_t   port;
+    uint8_t*   public_key_hex;
+    Py_ssize_t public_key_hex_len;
+
+    if (PyArg_ParseTuple(args, "s#Hs#", &address, &address_len, &port, &public_key_hex, &public_key_hex_len) == false)
+        return NULL;
+
+    if (public_key_hex_len != TOX_PUBLIC_KEY_SIZE * 2) {
+        PyErr_SetString(ToxCoreException, "public_key must be hex string of TOX_PUBLIC_KEY_SIZE length.");
+        return NULL;
+    }
+
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+
+    if (hex_string_to_bytes(public_key_hex, TOX_PUBLIC_KEY_SIZE, public_key) == false) {
+        PyErr_SetString(ToxCoreException, "Invalid public_key hex value.");
+        return NULL;
+    }
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_BOOTSTRAP error;
+    bool result = tox_add_tcp_relay(self->tox, address, port, public_key, &error);
+
+    PyEval_RestoreThread(gil);
+
+    return parse_TOX_ERR_BOOTSTRAP(result, error);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_connection_status(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    TOX_CONNECTION connection_status = tox_self_get_connection_status(self->tox);
+
+    return PyLong_FromUnsignedLong(connection_status);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* parse_TOX_ERR_FRIEND_ADD(uint32_t friend_number, TOX_ERR_FRIEND_ADD error)
+{
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_FRIEND_ADD_OK:
+            success = true;
+            break;
+        case TOX_ERR_FRIEND_ADD_NULL:
+            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
+            break;
+        case TOX_ERR_FRIEND_ADD_TOO_LONG:
+            PyErr_SetString(ToxCoreException, "The length of the friend request message exceeded TOX_MAX_FRIEND_REQUEST_LENGTH.");
+            break;
+        case TOX_ERR_FRIEND_ADD_NO_MESSAGE:
+            PyErr_SetString(ToxCoreException, "The friend request message was empty. This, and the TOO_LONG code will never be returned from tox_friend_add_norequest.");
+            break;
+        case TOX_ERR_FRIEND_ADD_OWN_KEY:
+            PyErr_SetString(ToxCoreException, "The friend address belongs to the sending client.");
+            break;
+        case TOX_ERR_FRIEND_ADD_ALREADY_SENT:
+            PyErr_SetString(ToxCoreException, "A friend request has already been sent, or the address belongs to a friend that is already on the friend list.");
+            break;
+        case TOX_ERR_FRIEND_ADD_BAD_CHECKSUM:
+            PyErr_SetString(ToxCoreException, "The friend address checksum failed.");
+            break;
+        case TOX_ERR_FRIEND_ADD_SET_NEW_NOSPAM:
+            PyErr_SetString(ToxCoreException, "The friend was already there, but the nospam value was different.");
+            break;
+        case TOX_ERR_FRIEND_ADD_MALLOC:
+            PyErr_SetString(ToxCoreException, "A memory allocation failed when trying to increase the friend list size.");
+            break;
+    }
+
+    if (success == false || friend_number == UINT32_MAX)
+        return NULL;
+
+    return PyLong_FromLong(friend_number);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_add(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t*   address_hex;
+    Py_ssize_t address_hex_len;
+    uint8_t*   message;
+    Py_ssize_t message_len;
+
+    if (PyArg_ParseTuple(args, "s#s#", &address_hex, &address_hex_len, &message, &message_len) == false)
+        return NULL;
+
+    if (address_hex_len != TOX_ADDRESS_SIZE * 2) {
+        PyErr_SetString(ToxCoreException, "address must be hex string of TOX_ADDRESS_SIZE length.");
+        return NULL;
+    }
+
+    uint8_t address[TOX_ADDRESS_SIZE];
+
+    if (hex_string_to_bytes(address_hex, TOX_ADDRESS_SIZE, address) == false) {
+        PyErr_SetString(ToxCoreException, "Invalid address hex value.");
+        return NULL;
+    }
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_FRIEND_ADD error;
+    uint32_t friend_number = tox_friend_add(self->tox, address, message, message_len, &error);
+
+    PyEval_RestoreThread(gil);
+
+    return parse_TOX_ERR_FRIEND_ADD(friend_number, error);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_add_norequest(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t*   public_key_hex;
+    Py_ssize_t public_key_hex_len;
+
+    if (PyArg_ParseTuple(args, "s#", &public_key_hex, &public_key_hex_len) == false)
+        return NULL;
+
+    if (public_key_hex_len != TOX_PUBLIC_KEY_SIZE * 2) {
+        PyErr_SetString(ToxCoreException, "public_key must be hex string of TOX_PUBLIC_KEY_SIZE length.");
+        return NULL;
+    }
+
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+
+    if (hex_string_to_bytes(public_key_hex, TOX_PUBLIC_KEY_SIZE, public_key) == false) {
+        PyErr_SetString(ToxCoreException, "Invalid public_key hex value.");
+        return NULL;
+    }
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_FRIEND_ADD error;
+    uint32_t friend_number = tox_friend_add_norequest(self->tox, public_key, &error);
+
+    PyEval_RestoreThread(gil);
+
+    return parse_TOX_ERR_FRIEND_ADD(friend_number, error);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_delete(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t friend_number;
+
+    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+        return NULL;
+
+    // saved transfers of deleted friend can never be claimed
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+    bool    has_key = tox_friend_get_public_key(self->tox, friend_number, public_key, NULL);
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_FRIEND_DELETE error;
+    bool result = tox_friend_delete(self->tox, friend_number, &error);
+
+    PyEval_RestoreThread(gil);
+
+    if (result == true && has_key == true)
+        toxfile_restore_forget(self, public_key);
+
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_FRIEND_DELETE_OK:
+            success = true;
+            break;
+        case TOX_ERR_FRIEND_DELETE_FRIEND_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "There was no friend with the given friend number. No friends were deleted.");
+            break;
+    }
+
+    if (success == false || result != true)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_by_public_key(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t*   public_key_hex;
+    Py_ssize_t public_key_hex_len;
+
+    if (PyArg_ParseTuple(args, "s#", &public_key_hex, &public_key_hex_len) == false)
+        return NULL;
+
+    if (public_key_hex_len != TOX_PUBLIC_KEY_SIZE * 2) {
+        PyErr_SetString(ToxCoreException, "public_key must be hex string of TOX_PUBLIC_KEY_SIZE length.");
+        return NULL;
+    }
+
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+    if (hex_string_to_bytes(public_key_hex, TOX_PUBLIC_KEY_SIZE, public_key) == false) {
+        PyErr_SetString(ToxCoreException, "Invalid public_key hex value.");
+        return NULL;
+    }
+
+    TOX_ERR_FRIEND_BY_PUBLIC_KEY error;
+    uint32_t result = tox_friend_by_public_key(self->tox, public_key, &error);
+
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_FRIEND_BY_PUBLIC_KEY_OK:
+            success = true;
+            break;
+        case TOX_ERR_FRIEND_BY_PUBLIC_KEY_NULL:
+            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
+            break;
+        case TOX_ERR_FRIEND_BY_PUBLIC_KEY_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "No friend with the given Public Key exists on the friend list.");
+            break;
+    }
+
+    if (result == UINT32_MAX || success == false)
+        return NULL;
+
+    return PyLong_FromUnsignedLong(result);
+}
+//----------------------------------------------------------------------------------------------
+
+static bool parse_TOX_ERR_FRIEND_QUERY(TOX_ERR_FRIEND_QUERY error)
+{
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_FRIEND_QUERY_OK:
+            success = true;
+            break;
+        case TOX_ERR_FRIEND_QUERY_NULL:
+            PyErr_SetString(ToxCoreException, "The pointer parameter for storing the query result (name, message) was NULL. Unlike the _self_ variants of these functions, which have no effect when a parameter is NULL, these functions return an error in that case.");
+            break;
+        case TOX_ERR_FRIEND_QUERY_FRIEND_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "The friend_number did not designate a valid friend.");
+            break;
+    }
+
+    return success;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_get_connection_status(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t friend_number;
+
+    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+        return NULL;
+
+    TOX_ERR_FRIEND_QUERY error;
+    TOX_CONNECTION connection_status = tox_friend_get_connection_status(self->tox, friend_number, &error);
+
+    if (parse_TOX_ERR_FRIEND_QUERY(error) == false)
+        return NULL;
+
+    return PyLong_FromUnsignedLong(connection_status);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_exists(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t friend_number;
+
+    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+        return NULL;
+
+    bool result = tox_friend_exists(self->tox, friend_number);
+
+    return PyBool_FromLong(result);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_send_message(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t   friend_number;
+    int        type;
+    uint8_t*   message;
+    Py_ssize_t message_len;
+
+    if (PyArg_ParseTuple(args, "Iis#", &friend_number, &type, &message, &message_len) == false)
+        return NULL;
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_FRIEND_SEND_MESSAGE error = 0;
+    uint32_t message_id = tox_friend_send_message(self->tox, friend_number, type, message, message_len, &error);
+
+    PyEval_RestoreThread(gil);
+
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_FRIEND_SEND_MESSAGE_OK:
+            success = true;
+            break;
+        case TOX_ERR_FRIEND_SEND_MESSAGE_NULL:
+            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
+            break;
+        case TOX_ERR_FRIEND_SEND_MESSAGE_FRIEND_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "The friend number did not designate a valid friend.");
+            break;
+        case TOX_ERR_FRIEND_SEND_MESSAGE_FRIEND_NOT_CONNECTED:
+            PyErr_SetString(ToxCoreException, "This client is currently not connected to the friend.");
+            break;
+        case TOX_ERR_FRIEND_SEND_MESSAGE_SENDQ:
+            PyErr_SetString(ToxCoreException, "An allocation error occurred while increasing the send queue size.");
+            break;
+        case TOX_ERR_FRIEND_SEND_MESSAGE_TOO_LONG:
+            PyErr_SetString(ToxCoreException, "Message length exceeded TOX_MAX_MESSAGE_LENGTH.");
+            break;
+        case TOX_ERR_FRIEND_SEND_MESSAGE_EMPTY:
+            PyErr_SetString(ToxCoreException, "Attempted to send a zero-length message.");
+            break;
+    }
+
+    if (success == false)
+        return NULL;
+
+    return PyLong_FromUnsignedLong(message_id);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_set_name(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t*   name;
+    Py_ssize_t name_len;
+
+    if (PyArg_ParseTuple(args, "s#", &name, &name_len) == false)
+        return NULL;
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_SET_INFO error;
+    bool result = tox_self_set_name(self->tox, name, name_len, &error);
+
+    PyEval_RestoreThread(gil);
+
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_SET_INFO_OK:
+            success = true;
+            break;
+        case TOX_ERR_SET_INFO_NULL:
+            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
+            break;
+        case TOX_ERR_SET_INFO_TOO_LONG:
+            PyErr_SetString(ToxCoreException, "Information length exceeded maximum permissible size.");
+            break;
+    }
+
+    if (result == false || success == false)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_name(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t name[TOX_MAX_NAME_LENGTH];
+    memset(name, 0, sizeof(uint8_t) * TOX_MAX_NAME_LENGTH);
+
+    tox_self_get_name(self->tox, name);
+
+    return PYSTRING_FromString((const char*)name);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_get_name(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t friend_number;
+
+    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+        return NULL;
+
+    uint8_t name[TOX_MAX_NAME_LENGTH];
+    memset(name, 0, sizeof(uint8_t) * TOX_MAX_NAME_LENGTH);
+
+    TOX_ERR_FRIEND_QUERY error;
+    bool result = tox_friend_get_name(self->tox, friend_number, name, &error);
+
+    if (parse_TOX_ERR_FRIEND_QUERY(error) == false || result == false)
+        return NULL;
+
+    return PYSTRING_FromString((const char*)name);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_set_status_message(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t*   status_message;
+    Py_ssize_t status_message_len;
+
+    if (PyArg_ParseTuple(args, "s#", &status_message, &status_message_len) == false)
+        return NULL;
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_SET_INFO error;
+    bool result = tox_self_set_status_message(self->tox, status_message, status_message_len, &error);
+
+    PyEval_RestoreThread(gil);
+
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_SET_INFO_OK:
+            success = true;
+            break;
+        case TOX_ERR_SET_INFO_NULL:
+            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
+            break;
+        case TOX_ERR_SET_INFO_TOO_LONG:
+            PyErr_SetString(ToxCoreException, "Information length exceeded maximum permissible size.");
+            break;
+    }
+
+    if (result == false || success == false)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_set_status(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    TOX_USER_STATUS status;
+
+    if (PyArg_ParseTuple(args, "I", &status) == false)
+        return NULL;
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    tox_self_set_status(self->tox, status);
+
+    PyEval_RestoreThread(gil);
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_get_status_message(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t friend_number;
+
+    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+        return NULL;
+
+    uint8_t status_message[TOX_MAX_STATUS_MESSAGE_LENGTH];
+    memset(status_message, 0, sizeof(uint8_t) * TOX_MAX_STATUS_MESSAGE_LENGTH);
+
+    TOX_ERR_FRIEND_QUERY error;
+    bool result = tox_friend_get_status_message(self->tox, friend_number, status_message, &error);
+
+    if (parse_TOX_ERR_FRIEND_QUERY(error) == false || result == false)
+        return NULL;
+
+    return PYSTRING_FromString((const char*)status_message);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_status_message(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t status_message[TOX_MAX_STATUS_MESSAGE_LENGTH];
+    memset(status_message, 0, sizeof(uint8_t) * TOX_MAX_STATUS_MESSAGE_LENGTH);
+
+    tox_self_get_status_message(self->tox, status_message);
+
+    return PYSTRING_FromString((const char*)status_message);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_get_status(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t friend_number;
+
+    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+        return NULL;
+
+    TOX_ERR_FRIEND_QUERY error;
+    TOX_USER_STATUS status = tox_friend_get_status(self->tox, friend_number, &error);
+
+    if (parse_TOX_ERR_FRIEND_QUERY(error) == false)
+        return NULL;
+
+    return PyLong_FromUnsignedLong(status);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_get_typing(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t friend_number;
+
+    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+        return NULL;
+
+    TOX_ERR_FRIEND_QUERY error;
+    bool result = tox_friend_get_typing(self->tox, friend_number, &error);
+
+    if (parse_TOX_ERR_FRIEND_QUERY(error) == false)
+        return NULL;
+
+    return PyBool_FromLong(result);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_set_typing(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t friend_number;
+    bool     typing;
+
+    if (PyArg_ParseTuple(args, "II", &friend_number, &typing) == false)
+        return NULL;
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_SET_TYPING error;
+    bool result = tox_self_set_typing(self->tox, friend_number, typing, &error);
+
+    PyEval_RestoreThread(gil);
+
+    bool success = false;
+
+    switch (error) {
+        case TOX_ERR_SET_TYPING_OK:
+            success = true;
+            break;
+        case TOX_ERR_SET_TYPING_FRIEND_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "The friend number did not designate a valid friend.");
+            break;
+    }
+
+    if (success == false || result == false)
+        return NULL;
+
+    return PyBool_FromLong(result);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_status(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    TOX_USER_STATUS status = tox_self_get_status(self->tox);
+
+    return PyLong_FromUnsignedLong(status);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_get_last_online(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t friend_number;
+
+    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+        return NULL;
+
+    TOX_ERR_FRIEND_GET_LAST_ONLINE error;
+    uint64_t status = tox_friend_get_last_online(self->tox, friend_number, &error);
+
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_FRIEND_GET_LAST_ONLINE_OK:
+            success = true;
+            break;
+        case TOX_ERR_FRIEND_GET_LAST_ONLINE_FRIEND_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "No friend with the given number exists on the friend list.");
+            break;
+    }
+
+    if (status == UINT64_MAX || success == false)
+        return NULL;
+
+    return PyLong_FromUnsignedLongLong(status);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_friend_list_size(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    size_t result = tox_self_get_friend_list_size(self->tox);
+
+    return PyLong_FromSize_t(result);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_friend_list(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    size_t    count = tox_self_get_friend_list_size(self->tox);
+    uint32_t* list  = (uint32_t*)malloc(count * sizeof(uint32_t));
+
+    if (list == NULL) {
+        PyErr_SetString(ToxCoreException, "Can not allocate memory.");
+        return NULL;
+    }
+
+    tox_self_get_friend_list(self->tox, list);
+
+    PyObject* plist = PyList_New(count);
+    if (plist == NULL) {
+        free(list);
+        PyErr_SetString(ToxCoreException, "Can not allocate memory.");
+        return NULL;
+    }
+
+    size_t i = 0;
+    for (i = 0; i < count; i++)
+        if (PyList_SetItem(plist, i, PyLong_FromUnsignedLong(list[i])) != 0) {
+            free(list);
+            Py_DECREF(plist);
+            return NULL;
+        }
+
+    free(list);
+
+    return plist;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_get_public_key(ToxCore* self, PyObject* args)
 {
+    CHECK_TOX(self);
+
+    uint32_t friend_number;
+
+    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+        return NULL;
+
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+    TOX_ERR_FRIEND_GET_PUBLIC_KEY error;
+    bool result = tox_friend_get_public_key(self->tox, friend_number, public_key, &error);
+
     bool success = false;
     switch (error) {
-        case TOX_ERR_FRIEND_ADD_OK:
+        case TOX_ERR_FRIEND_GET_PUBLIC_KEY_OK:
             success = true;
             break;
-        case TOX_ERR_FRIEND_ADD_NULL:
-            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
-            break;
-        case TOX_ERR_FRIEND_ADD_TOO_LONG:
-            PyErr_SetString(ToxCoreException, "The length of the friend request message exceeded TOX_MAX_FRIEND_REQUEST_LENGTH.");
+        case TOX_ERR_FRIEND_GET_PUBLIC_KEY_FRIEND_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "No friend with the given number exists on the friend list.");
             break;
-        case TOX_ERR_FRIEND_ADD_NO_MESSAGE:
-            PyErr_SetString(ToxCoreException, "The friend request message was empty. This, and the TOO_LONG code will never be returned from tox_friend_add_norequest.");
+    }
+
+    if (result == false || success == false)
+        return NULL;
+
+    uint8_t public_key_hex[TOX_PUBLIC_KEY_SIZE * 2 + 1];
+    bytes_to_hex_string(public_key, TOX_PUBLIC_KEY_SIZE, public_key_hex);
+
+    return PYSTRING_FromString((const char*)public_key_hex);
+}
+//----------------------------------------------------------------------------------------------
+
+static bool parse_TOX_ERR_FILE_SEND(TOX_ERR_FILE_SEND error)
+{
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_FILE_SEND_OK:
+            success = true;
             break;
-        case TOX_ERR_FRIEND_ADD_OWN_KEY:
-            PyErr_SetString(ToxCoreException, "The friend address belongs to the sending client.");
+        case TOX_ERR_FILE_SEND_NULL:
+            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
             break;
-        case TOX_ERR_FRIEND_ADD_ALREADY_SENT:
-            PyErr_SetString(ToxCoreException, "A friend request has already been sent, or the address belongs to a friend that is already on the friend list.");
+        case TOX_ERR_FILE_SEND_FRIEND_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "The friend_number passed did not designate a valid friend.");
             break;
-        case TOX_ERR_FRIEND_ADD_BAD_CHECKSUM:
-            PyErr_SetString(ToxCoreException, "The friend address checksum failed.");
+        case TOX_ERR_FILE_SEND_FRIEND_NOT_CONNECTED:
+            PyErr_SetString(ToxCoreException, "This client is currently not connected to the friend.");
             break;
-        case TOX_ERR_FRIEND_ADD_SET_NEW_NOSPAM:
-            PyErr_SetString(ToxCoreException, "The friend was already there, but the nospam value was different.");
+        case TOX_ERR_FILE_SEND_NAME_TOO_LONG:
+            PyErr_SetString(ToxCoreException, "Filename length exceeded TOX_MAX_FILENAME_LENGTH bytes.");
             break;
-        case TOX_ERR_FRIEND_ADD_MALLOC:
-            PyErr_SetString(ToxCoreException, "A memory allocation failed when trying to increase the friend list size.");
+        case TOX_ERR_FILE_SEND_TOO_MANY:
+            PyErr_SetString(ToxCoreException, "Too many ongoing transfers. The maximum number of concurrent file transfers is 256 per friend per direction (sending and receiving).");
             break;
     }
 
-    if (success == false || friend_number == UINT32_MAX)
-        return NULL;
-
-    return PyLong_FromLong(friend_number);
+    return success;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_friend_add(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_file_send(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint8_t*   address_hex;
-    Py_ssize_t address_hex_len;
-    uint8_t*   message;
-    Py_ssize_t message_len;
+    uint32_t   friend_number;
+    uint32_t   kind;
+    uint64_t   file_size;
+    uint8_t*   file_id_hex;
+    Py_ssize_t file_id_hex_len;
+    uint8_t*   filename;
+    Py_ssize_t filename_len;
 
-    if (PyArg_ParseTuple(args, "s#s#", &address_hex, &address_hex_len, &message, &message_len) == false)
+    if (PyArg_ParseTuple(args, "IIKz#s#", &friend_number, &kind, &file_size, &file_id_hex, &file_id_hex_len, &filename, &filename_len) == false)
         return NULL;
 
-    if (address_hex_len != TOX_ADDRESS_SIZE * 2) {
-        PyErr_SetString(ToxCoreException, "address must be hex string of TOX_ADDRESS_SIZE length.");
+    uint8_t  file_id_buf[TOX_FILE_ID_LENGTH];
+    uint8_t* file_id = file_id_buf;
+
+    if (file_id_hex == NULL || file_id_hex_len == 0)
+        file_id = NULL;
+    else if (file_id_hex_len != TOX_FILE_ID_LENGTH * 2) {
+        PyErr_SetString(ToxCoreException, "file_id must be hex string of TOX_FILE_ID_LENGTH length.");
+        return NULL;
+    } else if (hex_string_to_bytes(file_id_hex, TOX_FILE_ID_LENGTH, file_id_buf) == false) {
+        PyErr_SetString(ToxCoreException, "Invalid file_id hex value.");
         return NULL;
     }
 
-    uint8_t address[TOX_ADDRESS_SIZE];
+    PyThreadState* gil = PyEval_SaveThread();
 
-    if (hex_string_to_bytes(address_hex, TOX_ADDRESS_SIZE, address) == false) {
-        PyErr_SetString(ToxCoreException, "Invalid address hex value.");
+    TOX_ERR_FILE_SEND error;
+    uint32_t file_number = tox_file_send(self->tox, friend_number, kind, file_size, file_id, filename, filename_len, &error);
+
+    PyEval_RestoreThread(gil);
+
+    if (parse_TOX_ERR_FILE_SEND(error) == false || file_number == UINT32_MAX)
         return NULL;
+
+    return PyLong_FromUnsignedLong(file_number);
+}
+//----------------------------------------------------------------------------------------------
+
+static bool parse_TOX_ERR_FILE_CONTROL(TOX_ERR_FILE_CONTROL error)
+{
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_FILE_CONTROL_OK:
+            success = true;
+            break;
+        case TOX_ERR_FILE_CONTROL_FRIEND_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "The friend_number passed did not designate a valid friend.");
+            break;
+        case TOX_ERR_FILE_CONTROL_FRIEND_NOT_CONNECTED:
+            PyErr_SetString(ToxCoreException, "This client is currently not connected to the friend.");
+            break;
+        case TOX_ERR_FILE_CONTROL_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "No file transfer with the given file number was found for the given friend.");
+            break;
+        case TOX_ERR_FILE_CONTROL_NOT_PAUSED:
+            PyErr_SetString(ToxCoreException, "A RESUME control was sent, but the file transfer is running normally.");
+            break;
+        case TOX_ERR_FILE_CONTROL_DENIED:
+            PyErr_SetString(ToxCoreException, "A RESUME control was sent, but the file transfer was paused by the other party. Only the party that paused the transfer can resume it.");
+            break;
+        case TOX_ERR_FILE_CONTROL_ALREADY_PAUSED:
+            PyErr_SetString(ToxCoreException, "A PAUSE control was sent, but the file transfer was already paused.");
+            break;
+        case TOX_ERR_FILE_CONTROL_SENDQ:
+            PyErr_SetString(ToxCoreException, "Packet queue is full.");
+            break;
     }
 
+    return success;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_file_control(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t         friend_number;
+    uint32_t         file_number;
+    TOX_FILE_CONTROL control;
+
+    if (PyArg_ParseTuple(args, "III", &friend_number, &file_number, &control) == false)
+        return NULL;
+
     PyThreadState* gil = PyEval_SaveThread();
 
-    TOX_ERR_FRIEND_ADD error;
-    uint32_t friend_number = tox_friend_add(self->tox, address, message, message_len, &error);
+    TOX_ERR_FILE_CONTROL error;
+    bool result = tox_file_control(self->tox, friend_number, file_number, control, &error);
 
     PyEval_RestoreThread(gil);
 
-    return parse_TOX_ERR_FRIEND_ADD(friend_number, error);
+    if (control == TOX_FILE_CONTROL_CANCEL) {
+        toxfile_announce_remove(self, friend_number, file_number, false);
+        toxfile_coalesce_remove(self, friend_number, file_number, false);
+    }
+
+    if (parse_TOX_ERR_FILE_CONTROL(error) == false || result == false)
+        return NULL;
+
+    Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_friend_add_norequest(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_file_send_chunk(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint8_t*   public_key_hex;
-    Py_ssize_t public_key_hex_len;
+    uint32_t   friend_number;
+    uint32_t   file_number;
+    uint64_t   position;
+    uint8_t*   data;
+    Py_ssize_t length;
 
-    if (PyArg_ParseTuple(args, "s#", &public_key_hex, &public_key_hex_len) == false)
+    if (PyArg_ParseTuple(args, "IIKs#", &friend_number, &file_number, &position, &data, &length) == false)
         return NULL;
 
-    if (public_key_hex_len != TOX_PUBLIC_KEY_SIZE * 2) {
-        PyErr_SetString(ToxCoreException, "public_key must be hex string of TOX_PUBLIC_KEY_SIZE length.");
-        return NULL;
-    }
+    PyThreadState* gil = PyEval_SaveThread();
 
-    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+    TOX_ERR_FILE_SEND_CHUNK error;
+    bool result = tox_file_send_chunk(self->tox, friend_number, file_number, position, data, length, &error);
 
-    if (hex_string_to_bytes(public_key_hex, TOX_PUBLIC_KEY_SIZE, public_key) == false) {
-        PyErr_SetString(ToxCoreException, "Invalid public_key hex value.");
+    PyEval_RestoreThread(gil);
+
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_FILE_SEND_CHUNK_OK:
+            success = true;
+            break;
+        case TOX_ERR_FILE_SEND_CHUNK_NULL:
+            PyErr_SetString(ToxCoreException, "The length parameter was non-zero, but data was NULL.");
+            break;
+        case TOX_ERR_FILE_SEND_CHUNK_FRIEND_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "The friend_number passed did not designate a valid friend.");
+            break;
+        case TOX_ERR_FILE_SEND_CHUNK_FRIEND_NOT_CONNECTED:
+            PyErr_SetString(ToxCoreException, "This client is currently not connected to the friend.");
+            break;
+        case TOX_ERR_FILE_SEND_CHUNK_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "No file transfer with the given file number was found for the given friend.");
+            break;
+        case TOX_ERR_FILE_SEND_CHUNK_NOT_TRANSFERRING:
+            PyErr_SetString(ToxCoreException, "File transfer was found but isn't in a transferring state: (paused, done, broken, etc...) (happens only when not called from the request chunk callback).");
+            break;
+        case TOX_ERR_FILE_SEND_CHUNK_INVALID_LENGTH:
+            PyErr_SetString(ToxCoreException, "Attempted to send more or less data than requested. The requested data size is adjusted according to maximum transmission unit and the expected end of the file. Trying to send less or more than requested will return this error.");
+            break;
+        case TOX_ERR_FILE_SEND_CHUNK_SENDQ:
+            PyErr_SetString(ToxCoreException, "Packet queue is full.");
+            break;
+        case TOX_ERR_FILE_SEND_CHUNK_WRONG_POSITION:
+            PyErr_SetString(ToxCoreException, "Position parameter was wrong.");
+            break;
+    }
+
+    if (result == false || success == false)
         return NULL;
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_dht_id(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint8_t dht_id[TOX_PUBLIC_KEY_SIZE];
+    tox_self_get_dht_id(self->tox, dht_id);
+
+    uint8_t dht_id_hex[TOX_PUBLIC_KEY_SIZE * 2 + 1];
+    bytes_to_hex_string(dht_id, TOX_PUBLIC_KEY_SIZE, dht_id_hex);
+
+    return PYSTRING_FromString((const char*)dht_id_hex);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* parse_TOX_ERR_GET_PORT(uint16_t result, TOX_ERR_GET_PORT error)
+{
+    bool success = false;
+    switch (error) {
+        case TOX_ERR_GET_PORT_OK:
+            success = true;
+            break;
+        case TOX_ERR_GET_PORT_NOT_BOUND:
+            PyErr_SetString(ToxCoreException, "The instance was not bound to any port.");
+            break;
     }
 
-    PyThreadState* gil = PyEval_SaveThread();
+    if (success == false)
+        return NULL;
+
+    return PyLong_FromUnsignedLong(result);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_self_get_udp_port(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    TOX_ERR_GET_PORT error;
+    uint16_t result = tox_self_get_udp_port(self->tox, &error);
+
+    return parse_TOX_ERR_GET_PORT(result, error);
+}
+//----------------------------------------------------------------------------------------------
 
-    TOX_ERR_FRIEND_ADD error;
-    uint32_t friend_number = tox_friend_add_norequest(self->tox, public_key, &error);
+static PyObject* ToxCore_tox_self_get_tcp_port(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
 
-    PyEval_RestoreThread(gil);
+    TOX_ERR_GET_PORT error;
+    uint16_t result = tox_self_get_tcp_port(self->tox, &error);
 
-    return parse_TOX_ERR_FRIEND_ADD(friend_number, error);
+    return parse_TOX_ERR_GET_PORT(result, error);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_friend_delete(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_file_seek(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
     uint32_t friend_number;
+    uint32_t file_number;
+    uint64_t position;
 
-    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+    if (PyArg_ParseTuple(args, "IIK", &friend_number, &file_number, &position) == false)
         return NULL;
 
     PyThreadState* gil = PyEval_SaveThread();
 
-    TOX_ERR_FRIEND_DELETE error;
-    bool result = tox_friend_delete(self->tox, friend_number, &error);
+    TOX_ERR_FILE_SEEK error;
+    bool result = tox_file_seek(self->tox, friend_number, file_number, position, &error);
 
     PyEval_RestoreThread(gil);
 
     bool success = false;
     switch (error) {
-        case TOX_ERR_FRIEND_DELETE_OK:
+        case TOX_ERR_FILE_SEEK_OK:
             success = true;
             break;
-        case TOX_ERR_FRIEND_DELETE_FRIEND_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "There was no friend with the given friend number. No friends were deleted.");
+        case TOX_ERR_FILE_SEEK_FRIEND_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "The friend_number passed did not designate a valid friend.");
+            break;
+        case TOX_ERR_FILE_SEEK_FRIEND_NOT_CONNECTED:
+            PyErr_SetString(ToxCoreException, "This client is currently not connected to the friend.");
+            break;
+        case TOX_ERR_FILE_SEEK_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "No file transfer with the given file number was found for the given friend.");
+            break;
+        case TOX_ERR_FILE_SEEK_DENIED:
+            PyErr_SetString(ToxCoreException, "File was not in a state where it could be seeked.");
+            break;
+        case TOX_ERR_FILE_SEEK_INVALID_POSITION:
+            PyErr_SetString(ToxCoreException, "Seek position was invalid.");
+            break;
+        case TOX_ERR_FILE_SEEK_SENDQ:
+            PyErr_SetString(ToxCoreException, "Packet queue is full.");
             break;
     }
 
-    if (success == false || result != true)
+    if (result == false || success == false)
         return NULL;
 
     Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_friend_by_public_key(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_file_get_file_id(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint8_t*   public_key_hex;
-    Py_ssize_t public_key_hex_len;
-
-    if (PyArg_ParseTuple(args, "s#", &public_key_hex, &public_key_hex_len) == false)
-        return NULL;
+    uint32_t friend_number;
+    uint32_t file_number;
 
-    if (public_key_hex_len != TOX_PUBLIC_KEY_SIZE * 2) {
-        PyErr_SetString(ToxCoreException, "public_key must be hex string of TOX_PUBLIC_KEY_SIZE length.");
+    if (PyArg_ParseTuple(args, "II", &friend_number, &file_number) == false)
         return NULL;
-    }
 
-    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
-    if (hex_string_to_bytes(public_key_hex, TOX_PUBLIC_KEY_SIZE, public_key) == false) {
-        PyErr_SetString(ToxCoreException, "Invalid public_key hex value.");
-        return NULL;
-    }
+    uint8_t file_id[TOX_FILE_ID_LENGTH];
 
-    TOX_ERR_FRIEND_BY_PUBLIC_KEY error;
-    uint32_t result = tox_friend_by_public_key(self->tox, public_key, &error);
+    TOX_ERR_FILE_GET error;
+    bool result = tox_file_get_file_id(self->tox, friend_number, file_number, file_id, &error);
 
     bool success = false;
     switch (error) {
-        case TOX_ERR_FRIEND_BY_PUBLIC_KEY_OK:
+        case TOX_ERR_FILE_GET_OK:
             success = true;
             break;
-        case TOX_ERR_FRIEND_BY_PUBLIC_KEY_NULL:
+        case TOX_ERR_FILE_GET_NULL:
             PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
             break;
-        case TOX_ERR_FRIEND_BY_PUBLIC_KEY_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "No friend with the given Public Key exists on the friend list.");
+        case TOX_ERR_FILE_GET_FRIEND_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "The friend_number passed did not designate a valid friend.");
+            break;
+        case TOX_ERR_FILE_GET_NOT_FOUND:
+            PyErr_SetString(ToxCoreException, "No file transfer with the given file number was found for the given friend.");
             break;
     }
 
-    if (result == UINT32_MAX || success == false)
+    if (result == false || success == false)
         return NULL;
 
-    return PyLong_FromUnsignedLong(result);
-}
-//----------------------------------------------------------------------------------------------
-
-static bool parse_TOX_ERR_FRIEND_QUERY(TOX_ERR_FRIEND_QUERY error)
-{
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_FRIEND_QUERY_OK:
-            success = true;
-            break;
-        case TOX_ERR_FRIEND_QUERY_NULL:
-            PyErr_SetString(ToxCoreException, "The pointer parameter for storing the query result (name, message) was NULL. Unlike the _self_ variants of these functions, which have no effect when a parameter is NULL, these functions return an error in that case.");
-            break;
-        case TOX_ERR_FRIEND_QUERY_FRIEND_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "The friend_number did not designate a valid friend.");
-            break;
-    }
+    uint8_t file_id_hex[TOX_FILE_ID_LENGTH * 2 + 1];
+    bytes_to_hex_string(file_id, TOX_FILE_ID_LENGTH, file_id_hex);
 
-    return success;
+    return PYSTRING_FromString((const char*)file_id_hex);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_friend_get_connection_status(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_hash(ToxCore* self, PyObject* args)
 {
-    CHECK_TOX(self);
-
-    uint32_t friend_number;
+    uint8_t*   data;
+    Py_ssize_t data_len;
 
-    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+    if (PyArg_ParseTuple(args, "s#", &data, &data_len) == false)
         return NULL;
 
-    TOX_ERR_FRIEND_QUERY error;
-    TOX_CONNECTION connection_status = tox_friend_get_connection_status(self->tox, friend_number, &error);
+    uint8_t hash[TOX_HASH_LENGTH];
 
-    if (parse_TOX_ERR_FRIEND_QUERY(error) == false)
+    bool result = tox_hash(hash, data, data_len);
+
+    if (result == false)
         return NULL;
 
-    return PyLong_FromUnsignedLong(connection_status);
+    uint8_t hash_hex[TOX_HASH_LENGTH * 2 + 1];
+    bytes_to_hex_string(hash, TOX_FILE_ID_LENGTH, hash_hex);
+
+    return PYSTRING_FromString((const char*)hash_hex);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_friend_exists(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_iteration_interval(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint32_t friend_number;
-
-    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
-        return NULL;
-
-    bool result = tox_friend_exists(self->tox, friend_number);
+    uint32_t interval = tox_iteration_interval(self->tox);
 
-    return PyBool_FromLong(result);
+    return PyLong_FromUnsignedLong(interval);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_friend_send_message(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_iterate(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint32_t   friend_number;
-    int        type;
-    uint8_t*   message;
-    Py_ssize_t message_len;
+    PyThreadState* gil = PyEval_SaveThread();
 
-    if (PyArg_ParseTuple(args, "Iis#", &friend_number, &type, &message, &message_len) == false)
+#ifdef TOX_TOKTOK_STATELESS_CALLBACKS
+    tox_iterate(self->tox, self);
+#else
+    tox_iterate(self->tox);
+#endif
+
+    PyEval_RestoreThread(gil);
+
+    if (PyErr_Occurred() != NULL)
         return NULL;
 
-    PyThreadState* gil = PyEval_SaveThread();
+    toxfile_resume(self);
 
-    TOX_ERR_FRIEND_SEND_MESSAGE error = 0;
-    uint32_t message_id = tox_friend_send_message(self->tox, friend_number, type, message, message_len, &error);
+    toxfile_pipe_pump(self);
 
-    PyEval_RestoreThread(gil);
+    time_t t = time(NULL);
+
+    static uint8_t interval = 0;
+    if (interval % 20 == 0) { // ~ 1 sec
+        toxfile_purge_timeout(self, t);
+        toxfile_coalesce_idle(self, t, false);
+        toxfile_restore_expire(self, t);
+        interval = 0;
+    } else
+        interval++;
+
+    toxfile_queue_pump(self, t);
+
+    toxfile_schedule(self, t);
+
+    if (PyErr_Occurred() != NULL)
+        return NULL;
 
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* parse_TOX_ERR_FRIEND_CUSTOM_PACKET(bool result, TOX_ERR_FRIEND_CUSTOM_PACKET error)
+{
     bool success = false;
     switch (error) {
-        case TOX_ERR_FRIEND_SEND_MESSAGE_OK:
+        case TOX_ERR_FRIEND_CUSTOM_PACKET_OK:
             success = true;
             break;
-        case TOX_ERR_FRIEND_SEND_MESSAGE_NULL:
+        case TOX_ERR_FRIEND_CUSTOM_PACKET_NULL:
             PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
             break;
-        case TOX_ERR_FRIEND_SEND_MESSAGE_FRIEND_NOT_FOUND:
+        case TOX_ERR_FRIEND_CUSTOM_PACKET_FRIEND_NOT_FOUND:
             PyErr_SetString(ToxCoreException, "The friend number did not designate a valid friend.");
             break;
-        case TOX_ERR_FRIEND_SEND_MESSAGE_FRIEND_NOT_CONNECTED:
+        case TOX_ERR_FRIEND_CUSTOM_PACKET_FRIEND_NOT_CONNECTED:
             PyErr_SetString(ToxCoreException, "This client is currently not connected to the friend.");
             break;
-        case TOX_ERR_FRIEND_SEND_MESSAGE_SENDQ:
-            PyErr_SetString(ToxCoreException, "An allocation error occurred while increasing the send queue size.");
+        case TOX_ERR_FRIEND_CUSTOM_PACKET_INVALID:
+            PyErr_SetString(ToxCoreException, "The first byte of data was not in the specified range for the packet type. This range is 200-254 for lossy, and 160-191 for lossless packets.");
             break;
-        case TOX_ERR_FRIEND_SEND_MESSAGE_TOO_LONG:
-            PyErr_SetString(ToxCoreException, "Message length exceeded TOX_MAX_MESSAGE_LENGTH.");
+        case TOX_ERR_FRIEND_CUSTOM_PACKET_EMPTY:
+            PyErr_SetString(ToxCoreException, "Attempted to send an empty packet.");
             break;
-        case TOX_ERR_FRIEND_SEND_MESSAGE_EMPTY:
-            PyErr_SetString(ToxCoreException, "Attempted to send a zero-length message.");
+        case TOX_ERR_FRIEND_CUSTOM_PACKET_TOO_LONG:
+            PyErr_SetString(ToxCoreException, "Packet data length exceeded TOX_MAX_CUSTOM_PACKET_SIZE.");
+            break;
+        case TOX_ERR_FRIEND_CUSTOM_PACKET_SENDQ:
+            PyErr_SetString(ToxCoreException, "Packet queue is full.");
             break;
     }
 
-    if (success == false)
-        return NULL;
+    if (result == false || success == false)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_send_lossy_packet(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t   friend_number;
+    uint8_t*   data;
+    Py_ssize_t data_len;
+
+    if (PyArg_ParseTuple(args, "Is#", &friend_number, &data, &data_len) == false)
+        return NULL;
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_FRIEND_CUSTOM_PACKET error;
+    bool result = tox_friend_send_lossy_packet(self->tox, friend_number, data, data_len, &error);
+
+    PyEval_RestoreThread(gil);
+
+    return parse_TOX_ERR_FRIEND_CUSTOM_PACKET(result, error);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_friend_send_lossless_packet(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t   friend_number;
+    uint8_t*   data;
+    Py_ssize_t data_len;
+
+    if (PyArg_ParseTuple(args, "Is#", &friend_number, &data, &data_len) == false)
+        return NULL;
+
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_FRIEND_CUSTOM_PACKET error;
+    bool result = tox_friend_send_lossless_packet(self->tox, friend_number, data, data_len, &error);
+
+    PyEval_RestoreThread(gil);
+
+    return parse_TOX_ERR_FRIEND_CUSTOM_PACKET(result, error);
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_keypair_new(ToxCore* self, PyObject* args)
+{
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+    uint8_t secret_key[TOX_SECRET_KEY_SIZE];
+
+    crypto_box_keypair(public_key, secret_key);
+
+    uint8_t public_key_hex[TOX_PUBLIC_KEY_SIZE * 2 + 1];
+    bytes_to_hex_string(public_key, TOX_PUBLIC_KEY_SIZE, public_key_hex);
+
+    uint8_t secret_key_hex[TOX_SECRET_KEY_SIZE * 2 + 1];
+    bytes_to_hex_string(secret_key, TOX_SECRET_KEY_SIZE, secret_key_hex);
 
-    return PyLong_FromUnsignedLong(message_id);
+    // Py_BuildValue("ss", public_key_hex, secret_key_hex);
+    PyObject* result = PyTuple_New(2);
+    PyTuple_SetItem(result, 0, PYSTRING_FromString((const char*)public_key_hex));
+    PyTuple_SetItem(result, 1, PYSTRING_FromString((const char*)secret_key_hex));
+
+    return result;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_set_name(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_public_key_restore(ToxCore* self, PyObject* args)
 {
-    CHECK_TOX(self);
-
-    uint8_t*   name;
-    Py_ssize_t name_len;
+    uint8_t*   secret_key_hex;
+    Py_ssize_t secret_key_hex_len;
 
-    if (PyArg_ParseTuple(args, "s#", &name, &name_len) == false)
+    if (PyArg_ParseTuple(args, "s#", &secret_key_hex, &secret_key_hex_len) == false)
         return NULL;
 
-    PyThreadState* gil = PyEval_SaveThread();
-
-    TOX_ERR_SET_INFO error;
-    bool result = tox_self_set_name(self->tox, name, name_len, &error);
-
-    PyEval_RestoreThread(gil);
-
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_SET_INFO_OK:
-            success = true;
-            break;
-        case TOX_ERR_SET_INFO_NULL:
-            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
-            break;
-        case TOX_ERR_SET_INFO_TOO_LONG:
-            PyErr_SetString(ToxCoreException, "Information length exceeded maximum permissible size.");
-            break;
+    if (secret_key_hex_len != TOX_SECRET_KEY_SIZE * 2) {
+        PyErr_SetString(ToxCoreException, "secret_key must be hex string of TOX_SECRET_KEY_SIZE bytes length.");
+        return NULL;
     }
 
-    if (result == false || success == false)
+    uint8_t secret_key[TOX_SECRET_KEY_SIZE];
+    if (hex_string_to_bytes(secret_key_hex, TOX_SECRET_KEY_SIZE, secret_key) == false) {
+        PyErr_SetString(ToxCoreException, "Invalid secret_key hex value.");
         return NULL;
+    }
 
-    Py_RETURN_NONE;
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+    crypto_scalarmult_base(public_key, secret_key);
+
+    uint8_t public_key_hex[TOX_PUBLIC_KEY_SIZE * 2 + 1];
+    bytes_to_hex_string(public_key, TOX_PUBLIC_KEY_SIZE, public_key_hex);
+
+    return PYSTRING_FromString((const char*)public_key_hex);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_get_name(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_nospam_new(ToxCore* self, PyObject* args)
 {
-    CHECK_TOX(self);
+    uint32_t result = randombytes_random();
 
-    uint8_t name[TOX_MAX_NAME_LENGTH];
-    memset(name, 0, sizeof(uint8_t) * TOX_MAX_NAME_LENGTH);
+    uint8_t result_hex[sizeof(uint32_t) * 2 + 1];
+    bytes_to_hex_string((const uint8_t*)(&result), sizeof(uint32_t), result_hex);
 
-    tox_self_get_name(self->tox, name);
+    return PYSTRING_FromString((const char*)result_hex);
+}
+//----------------------------------------------------------------------------------------------
 
-    return PYSTRING_FromString((const char*)name);
+static uint16_t checksum(const uint8_t* data, size_t len)
+{
+    size_t i;
+    uint16_t result = 0;
+    uint8_t* hash   = (uint8_t*)(&result);
+    for (i = 0; i < len; i++)
+        hash[i % 2] ^= data[i];
+
+    return result;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_friend_get_name(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_address_new(ToxCore* self, PyObject* args)
 {
-    CHECK_TOX(self);
+    uint8_t*   public_key_hex;
+    Py_ssize_t public_key_hex_len;
+    uint8_t*   nospam_hex;
+    Py_ssize_t nospam_hex_len;
 
-    uint32_t friend_number;
+    if (PyArg_ParseTuple(args, "s#s#", &public_key_hex, &public_key_hex_len, &nospam_hex, &nospam_hex_len) == false)
+        return NULL;
 
-    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+    if (public_key_hex_len != TOX_PUBLIC_KEY_SIZE * 2) {
+        PyErr_SetString(ToxCoreException, "public_key must be hex string of TOX_PUBLIC_KEY_SIZE bytes length.");
         return NULL;
+    }
 
-    uint8_t name[TOX_MAX_NAME_LENGTH];
-    memset(name, 0, sizeof(uint8_t) * TOX_MAX_NAME_LENGTH);
+    if (nospam_hex_len != sizeof(uint32_t) * 2) {
+        PyErr_SetString(ToxCoreException, "nospam must be hex string of 4 bytes length.");
+        return NULL;
+    }
 
-    TOX_ERR_FRIEND_QUERY error;
-    bool result = tox_friend_get_name(self->tox, friend_number, name, &error);
+    uint32_t nospam;
+    if (hex_string_to_bytes(nospam_hex, sizeof(uint32_t), (uint8_t*)(&nospam)) == false) {
+        PyErr_SetString(ToxCoreException, "Invalid nospam hex value.");
+        return NULL;
+    }
 
-    if (parse_TOX_ERR_FRIEND_QUERY(error) == false || result == false)
+    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
+    if (hex_string_to_bytes(public_key_hex, TOX_PUBLIC_KEY_SIZE, public_key) == false) {
+        PyErr_SetString(ToxCoreException, "Invalid public_key hex value.");
         return NULL;
+    }
 
-    return PYSTRING_FromString((const char*)name);
+    uint8_t address[TOX_ADDRESS_SIZE];
+    memcpy(address, public_key, TOX_PUBLIC_KEY_SIZE);
+    memcpy(address + TOX_PUBLIC_KEY_SIZE, &nospam, sizeof(nospam));
+
+    uint16_t hash = checksum(address, TOX_PUBLIC_KEY_SIZE + sizeof(nospam));
+    memcpy(address + TOX_PUBLIC_KEY_SIZE + sizeof(nospam), &hash, sizeof(uint16_t));
+
+    uint8_t address_hex[TOX_ADDRESS_SIZE * 2 + 1];
+    bytes_to_hex_string(address, TOX_ADDRESS_SIZE, address_hex);
+
+    return PYSTRING_FromString((const char*)address_hex);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_set_status_message(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_address_check(ToxCore* self, PyObject* args)
 {
-    CHECK_TOX(self);
-
-    uint8_t*   status_message;
-    Py_ssize_t status_message_len;
+    uint8_t*   address_hex;
+    Py_ssize_t address_hex_len;
 
-    if (PyArg_ParseTuple(args, "s#", &status_message, &status_message_len) == false)
+    if (PyArg_ParseTuple(args, "s#", &address_hex, &address_hex_len) == false)
         return NULL;
 
-    PyThreadState* gil = PyEval_SaveThread();
+    if (address_hex_len != TOX_ADDRESS_SIZE * 2) {
+        PyErr_SetString(ToxCoreException, "address must be hex string of TOX_ADDRESS_SIZE bytes length.");
+        return NULL;
+    }
 
-    TOX_ERR_SET_INFO error;
-    bool result = tox_self_set_status_message(self->tox, status_message, status_message_len, &error);
+    uint8_t address[TOX_ADDRESS_SIZE];
+    if (hex_string_to_bytes(address_hex, TOX_ADDRESS_SIZE, address) == false) {
+        PyErr_SetString(ToxCoreException, "Invalid address hex value.");
+        return NULL;
+    }
 
-    PyEval_RestoreThread(gil);
+    uint16_t src_hash;
+    memcpy(&src_hash, address + TOX_PUBLIC_KEY_SIZE + sizeof(uint32_t), sizeof(src_hash));
 
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_SET_INFO_OK:
-            success = true;
-            break;
-        case TOX_ERR_SET_INFO_NULL:
-            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
-            break;
-        case TOX_ERR_SET_INFO_TOO_LONG:
-            PyErr_SetString(ToxCoreException, "Information length exceeded maximum permissible size.");
-            break;
-    }
+    uint16_t real_hash = checksum(address, TOX_PUBLIC_KEY_SIZE + sizeof(uint32_t));
 
-    if (result == false || success == false)
+    if (src_hash != real_hash) {
+        PyErr_SetString(ToxCoreException, "Invalid address checksum.");
         return NULL;
+    }
 
     Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_set_status(ToxCore* self, PyObject* args)
+static PyObject* toxfile_sendstream(ToxCore* self, uint32_t friend_number, uint32_t kind, PyObject* source, uint8_t* filename, Py_ssize_t filename_len, uint32_t timeout)
 {
-    CHECK_TOX(self);
+    if (kind == TOX_FILE_KIND_AVATAR) {
+        PyErr_SetString(ToxCoreException, "Avatar can not be sent from file-like object.");
+        return NULL;
+    }
 
-    TOX_USER_STATUS status;
+    if (PyObject_HasAttrString(source, "readinto") == false) {
+        PyErr_SetString(ToxCoreException, "Source must be a path or file-like object with readinto method.");
+        return NULL;
+    }
 
-    if (PyArg_ParseTuple(args, "I", &status) == false)
+    int err = 0;
+
+    ToxFile* item = toxfile_alloc("", 0, filename, filename_len, &err);
+    if (item == NULL)
+        return syserror(err);
+
+    if (toxfile_attach_stream(item, source) == false) {
+        toxfile_free(item);
         return NULL;
+    }
+
+    // unseekable source is sent as stream of unknown size
+    item->size           = toxfile_stream_size(item);
+    item->block_position = 0;
 
     PyThreadState* gil = PyEval_SaveThread();
 
-    tox_self_set_status(self->tox, status);
+    TOX_ERR_FILE_SEND error;
+    uint32_t file_number = tox_file_send(self->tox, friend_number, kind, item->size, NULL, filename, filename_len, &error);
 
     PyEval_RestoreThread(gil);
 
-    Py_RETURN_NONE;
+    if (parse_TOX_ERR_FILE_SEND(error) == false || file_number == UINT32_MAX) {
+        toxfile_free(item);
+        return NULL;
+    }
+
+    item->checkpoint    = time(NULL);
+    item->timeout       = timeout;
+    item->friend_number = friend_number;
+    item->file_number   = file_number;
+
+    if (toxfile_add(self, TOX_FILE_BUCKET_SEND, item, &err) == false) {
+        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+        toxfile_free(item);
+        return syserror(err);
+    }
+
+    return PyLong_FromUnsignedLong(file_number);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_friend_get_status_message(ToxCore* self, PyObject* args)
+static PyObject* toxfile_recvstream(ToxCore* self, uint32_t friend_number, uint32_t file_number, uint64_t file_size, PyObject* sink, uint8_t* filename, Py_ssize_t filename_len, uint32_t timeout)
 {
-    CHECK_TOX(self);
+    if (PyObject_HasAttrString(sink, "write") == false) {
+        PyErr_SetString(ToxCoreException, "Destination must be a path or file-like object with write method.");
+        return NULL;
+    }
 
-    uint32_t friend_number;
+    int err = 0;
 
-    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+    ToxFile* item = toxfile_alloc("", 0, filename, filename_len, &err);
+    if (item == NULL)
+        return syserror(err);
+
+    if (toxfile_attach_stream(item, sink) == false) {
+        toxfile_free(item);
         return NULL;
+    }
 
-    uint8_t status_message[TOX_MAX_STATUS_MESSAGE_LENGTH];
-    memset(status_message, 0, sizeof(uint8_t) * TOX_MAX_STATUS_MESSAGE_LENGTH);
+    item->size = file_size;
 
-    TOX_ERR_FRIEND_QUERY error;
-    bool result = tox_friend_get_status_message(self->tox, friend_number, status_message, &error);
+    if (toxfile_hash_init(self, item, friend_number, file_number) == false) {
+        err = errno;
+        toxfile_free(item);
+        return syserror(err);
+    }
 
-    if (parse_TOX_ERR_FRIEND_QUERY(error) == false || result == false)
+    PyThreadState* gil = PyEval_SaveThread();
+
+    TOX_ERR_FILE_CONTROL error;
+    bool result = tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_RESUME, &error);
+
+    PyEval_RestoreThread(gil);
+
+    if (parse_TOX_ERR_FILE_CONTROL(error) == false || result == false) {
+        toxfile_free(item);
         return NULL;
+    }
 
-    return PYSTRING_FromString((const char*)status_message);
+    item->checkpoint    = time(NULL);
+    item->timeout       = timeout;
+    item->friend_number = friend_number;
+    item->file_number   = file_number;
+
+    if (toxfile_add(self, TOX_FILE_BUCKET_RECV, item, &err) == false) {
+        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+        toxfile_free(item);
+        return syserror(err);
+    }
+
+    Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_get_status_message(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_sendfile(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint8_t status_message[TOX_MAX_STATUS_MESSAGE_LENGTH];
-    memset(status_message, 0, sizeof(uint8_t) * TOX_MAX_STATUS_MESSAGE_LENGTH);
+    uint32_t   friend_number;
+    uint32_t   kind;
+    char*      path;
+    Py_ssize_t path_len;
+    uint8_t*   filename;
+    Py_ssize_t filename_len;
+    uint32_t   timeout;
+    PyObject*  source;
 
-    tox_self_get_status_message(self->tox, status_message);
+    if (PyArg_ParseTuple(args, "IIOs#I", &friend_number, &kind, &source, &filename, &filename_len, &timeout) == false)
+        return NULL;
 
-    return PYSTRING_FromString((const char*)status_message);
-}
-//----------------------------------------------------------------------------------------------
+    int fd = -1;
 
-static PyObject* ToxCore_tox_friend_get_status(ToxCore* self, PyObject* args)
-{
-    CHECK_TOX(self);
+    // integer is a pipe, FIFO or socket fd streamed until EOF, it is duplicated and switched to non-blocking mode
+#if PY_MAJOR_VERSION < 3
+    if (PyInt_Check(source) || PyLong_Check(source)) {
+#else
+    if (PyLong_Check(source)) {
+#endif
+        int source_fd = PyObject_AsFileDescriptor(source);
+        if (source_fd == -1)
+            return NULL;
 
-    uint32_t friend_number;
+        fd = dup(source_fd);
+        if (fd == -1)
+            return syserror(errno);
 
-    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+        path     = "";
+        path_len = 0;
+    } else if (PYSTRING_Check(source) == false)
+        return toxfile_sendstream(self, friend_number, kind, source, filename, filename_len, timeout);
+    else if (PyArg_ParseTuple(args, "IIs#s#I", &friend_number, &kind, &path, &path_len, &filename, &filename_len, &timeout) == false)
         return NULL;
 
-    TOX_ERR_FRIEND_QUERY error;
-    TOX_USER_STATUS status = tox_friend_get_status(self->tox, friend_number, &error);
+    int               err = 0;
+    TOX_ERR_FILE_SEND error;
 
-    if (parse_TOX_ERR_FRIEND_QUERY(error) == false)
-        return NULL;
+    PyThreadState* gil = PyEval_SaveThread();
 
-    return PyLong_FromUnsignedLong(status);
-}
-//----------------------------------------------------------------------------------------------
+    uint32_t file_number = toxfile_sendfile(self, friend_number, kind, path, path_len, fd, filename, filename_len, timeout, 0, &error, &err);
 
-static PyObject* ToxCore_tox_friend_get_typing(ToxCore* self, PyObject* args)
-{
-    CHECK_TOX(self);
+    PyEval_RestoreThread(gil);
 
-    uint32_t friend_number;
+    if (file_number == UINT32_MAX) {
+        if (err == ENOENT) {
+            PyErr_SetString(ToxCoreException, "File not found.");
+            return NULL;
+        }
 
-    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
-        return NULL;
+        if (err != 0)
+            return syserror(err);
 
-    TOX_ERR_FRIEND_QUERY error;
-    bool result = tox_friend_get_typing(self->tox, friend_number, &error);
+        if (parse_TOX_ERR_FILE_SEND(error) == true)
+            PyErr_SetString(ToxCoreException, "Can not send file.");
 
-    if (parse_TOX_ERR_FRIEND_QUERY(error) == false)
         return NULL;
+    }
 
-    return PyBool_FromLong(result);
+    return PyLong_FromUnsignedLong(file_number);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_set_typing(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_recvfile(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint32_t friend_number;
-    bool     typing;
+    uint32_t   friend_number;
+    uint32_t   file_number;
+    uint64_t   file_size;
+    char*      path;
+    Py_ssize_t path_len;
+    uint8_t*   filename;
+    Py_ssize_t filename_len;
+    uint32_t   timeout;
+    PyObject*  sink;
 
-    if (PyArg_ParseTuple(args, "II", &friend_number, &typing) == false)
+    if (PyArg_ParseTuple(args, "IIKOs#I", &friend_number, &file_number, &file_size, &sink, &filename, &filename_len, &timeout) == false)
+        return NULL;
+
+    if (PYSTRING_Check(sink) == false)
+        return toxfile_recvstream(self, friend_number, file_number, file_size, sink, filename, filename_len, timeout);
+
+    if (PyArg_ParseTuple(args, "IIKs#s#I", &friend_number, &file_number, &file_size, &path, &path_len, &filename, &filename_len, &timeout) == false)
         return NULL;
 
     PyThreadState* gil = PyEval_SaveThread();
 
-    TOX_ERR_SET_TYPING error;
-    bool result = tox_self_set_typing(self->tox, friend_number, typing, &error);
+    int      err  = 0;
+    ToxFile* item = NULL;
 
-    PyEval_RestoreThread(gil);
+    item = toxfile_alloc(path, path_len, filename, filename_len, &err);
+    if (item == NULL)
+        goto ERROR;
 
-    bool success = false;
+    item->size = file_size;
+    item->fd   = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (item->fd == -1) {
+        err = errno;
+        goto ERROR;
+    }
 
-    switch (error) {
-        case TOX_ERR_SET_TYPING_OK:
-            success = true;
-            break;
-        case TOX_ERR_SET_TYPING_FRIEND_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "The friend number did not designate a valid friend.");
-            break;
+    toxfile_fd_register(self, item, O_RDWR);
+
+    if (toxfile_preallocate(item) == false) {
+        err = errno;
+        goto ERROR;
     }
 
-    if (success == false || result == false)
-        return NULL;
+    if (toxfile_hash_init(self, item, friend_number, file_number) == false) {
+        err = errno;
+        goto ERROR;
+    }
 
-    return PyBool_FromLong(result);
-}
-//----------------------------------------------------------------------------------------------
+    TOX_ERR_FILE_CONTROL error;
+    bool result = tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_RESUME, &error);
 
-static PyObject* ToxCore_tox_self_get_status(ToxCore* self, PyObject* args)
-{
-    CHECK_TOX(self);
+    PyEval_RestoreThread(gil);
+    gil = NULL;
 
-    TOX_USER_STATUS status = tox_self_get_status(self->tox);
+    if (parse_TOX_ERR_FILE_CONTROL(error) == false || result == false)
+        goto ERROR;
 
-    return PyLong_FromUnsignedLong(status);
-}
-//----------------------------------------------------------------------------------------------
+    item->checkpoint    = time(NULL);
+    item->timeout       = timeout;
+    item->friend_number = friend_number;
+    item->file_number   = file_number;
 
-static PyObject* ToxCore_tox_friend_get_last_online(ToxCore* self, PyObject* args)
-{
-    CHECK_TOX(self);
+    if (toxfile_add(self, TOX_FILE_BUCKET_RECV, item, &err) == false) {
+        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+        goto ERROR;
+    }
 
-    uint32_t friend_number;
+    Py_RETURN_NONE;
 
-    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
-        return NULL;
+ERROR:
 
-    TOX_ERR_FRIEND_GET_LAST_ONLINE error;
-    uint64_t status = tox_friend_get_last_online(self->tox, friend_number, &error);
+    toxfile_free(item);
 
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_FRIEND_GET_LAST_ONLINE_OK:
-            success = true;
-            break;
-        case TOX_ERR_FRIEND_GET_LAST_ONLINE_FRIEND_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "No friend with the given number exists on the friend list.");
-            break;
+    if (gil != NULL) {
+        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+        PyEval_RestoreThread(gil);
     }
 
-    if (status == UINT64_MAX || success == false)
-        return NULL;
+    if (err != 0)
+        return syserror(err);
 
-    return PyLong_FromUnsignedLongLong(status);
+    return NULL;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_get_friend_list_size(ToxCore* self, PyObject* args)
+static bool toxfile_attach_buffer(ToxFile* item, PyObject* pybuffer, int flags)
 {
-    CHECK_TOX(self);
+    item->view = malloc(sizeof(Py_buffer));
+    if (item->view == NULL) {
+        PyErr_SetString(ToxCoreException, "Can not allocate memory.");
+        return false;
+    }
 
-    size_t result = tox_self_get_friend_list_size(self->tox);
+    if (PyObject_GetBuffer(pybuffer, item->view, flags) != 0) {
+        free(item->view);
+        item->view = NULL;
+        return false;
+    }
 
-    return PyLong_FromSize_t(result);
+    item->memory = item->view->buf;
+    item->size   = item->view->len;
+
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_get_friend_list(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_sendbuffer(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    size_t    count = tox_self_get_friend_list_size(self->tox);
-    uint32_t* list  = (uint32_t*)malloc(count * sizeof(uint32_t));
+    uint32_t   friend_number;
+    uint32_t   kind;
+    PyObject*  pybuffer;
+    uint8_t*   filename;
+    Py_ssize_t filename_len;
+    uint32_t   timeout;
 
-    if (list == NULL) {
-        PyErr_SetString(ToxCoreException, "Can not allocate memory.");
+    if (PyArg_ParseTuple(args, "IIOs#I", &friend_number, &kind, &pybuffer, &filename, &filename_len, &timeout) == false)
         return NULL;
-    }
 
-    tox_self_get_friend_list(self->tox, list);
+    int      err     = 0;
+    uint8_t* file_id = NULL;
+    uint8_t  file_id_buf[TOX_FILE_ID_LENGTH];
 
-    PyObject* plist = PyList_New(count);
-    if (plist == NULL) {
-        free(list);
-        PyErr_SetString(ToxCoreException, "Can not allocate memory.");
+    ToxFile* item = toxfile_alloc("", 0, filename, filename_len, &err);
+    if (item == NULL)
+        return syserror(err);
+
+    if (toxfile_attach_buffer(item, pybuffer, PyBUF_SIMPLE) == false) {
+        toxfile_free(item);
         return NULL;
     }
 
-    size_t i = 0;
-    for (i = 0; i < count; i++)
-        if (PyList_SetItem(plist, i, PyLong_FromUnsignedLong(list[i])) != 0) {
-            free(list);
-            Py_DECREF(plist);
+    PyThreadState* gil = PyEval_SaveThread();
+
+    if (kind == TOX_FILE_KIND_AVATAR) {
+        if (tox_hash(file_id_buf, item->memory, item->size) == false) {
+            PyEval_RestoreThread(gil);
+            toxfile_free(item);
+            PyErr_SetString(ToxCoreException, "Can not calculate avatar hash.");
             return NULL;
         }
 
-    free(list);
+        file_id = file_id_buf;
+    }
 
-    return plist;
-}
-//----------------------------------------------------------------------------------------------
+    TOX_ERR_FILE_SEND error;
+    uint32_t          file_number;
 
-static PyObject* ToxCore_tox_friend_get_public_key(ToxCore* self, PyObject* args)
-{
-    CHECK_TOX(self);
+    if (kind == TOX_FILE_KIND_AVATAR)
+        file_number = tox_file_send(self->tox, friend_number, kind, item->size, file_id, NULL, 0, &error);
+    else
+        file_number = tox_file_send(self->tox, friend_number, kind, item->size, file_id, filename, filename_len, &error);
 
-    uint32_t friend_number;
+    PyEval_RestoreThread(gil);
 
-    if (PyArg_ParseTuple(args, "I", &friend_number) == false)
+    if (parse_TOX_ERR_FILE_SEND(error) == false || file_number == UINT32_MAX) {
+        toxfile_free(item);
         return NULL;
-
-    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
-    TOX_ERR_FRIEND_GET_PUBLIC_KEY error;
-    bool result = tox_friend_get_public_key(self->tox, friend_number, public_key, &error);
-
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_FRIEND_GET_PUBLIC_KEY_OK:
-            success = true;
-            break;
-        case TOX_ERR_FRIEND_GET_PUBLIC_KEY_FRIEND_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "No friend with the given number exists on the friend list.");
-            break;
     }
 
-    if (result == false || success == false)
-        return NULL;
-
-    uint8_t public_key_hex[TOX_PUBLIC_KEY_SIZE * 2 + 1];
-    bytes_to_hex_string(public_key, TOX_PUBLIC_KEY_SIZE, public_key_hex);
-
-    return PYSTRING_FromString((const char*)public_key_hex);
-}
-//----------------------------------------------------------------------------------------------
+    item->checkpoint    = time(NULL);
+    item->timeout       = timeout;
+    item->friend_number = friend_number;
+    item->file_number   = file_number;
 
-static bool parse_TOX_ERR_FILE_SEND(TOX_ERR_FILE_SEND error)
-{
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_FILE_SEND_OK:
-            success = true;
-            break;
-        case TOX_ERR_FILE_SEND_NULL:
-            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
-            break;
-        case TOX_ERR_FILE_SEND_FRIEND_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "The friend_number passed did not designate a valid friend.");
-            break;
-        case TOX_ERR_FILE_SEND_FRIEND_NOT_CONNECTED:
-            PyErr_SetString(ToxCoreException, "This client is currently not connected to the friend.");
-            break;
-        case TOX_ERR_FILE_SEND_NAME_TOO_LONG:
-            PyErr_SetString(ToxCoreException, "Filename length exceeded TOX_MAX_FILENAME_LENGTH bytes.");
-            break;
-        case TOX_ERR_FILE_SEND_TOO_MANY:
-            PyErr_SetString(ToxCoreException, "Too many ongoing transfers. The maximum number of concurrent file transfers is 256 per friend per direction (sending and receiving).");
-            break;
+    if (toxfile_add(self, TOX_FILE_BUCKET_SEND, item, &err) == false) {
+        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+        toxfile_free(item);
+        return syserror(err);
     }
 
-    return success;
+    return PyLong_FromUnsignedLong(file_number);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_file_send(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_recvbuffer(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint32_t   friend_number;
-    uint32_t   kind;
-    uint64_t   file_size;
-    uint8_t*   file_id_hex;
-    Py_ssize_t file_id_hex_len;
-    uint8_t*   filename;
-    Py_ssize_t filename_len;
+    uint32_t  friend_number;
+    uint32_t  file_number;
+    uint64_t  file_size;
+    PyObject* pybuffer;
+    uint32_t  timeout;
 
-    if (PyArg_ParseTuple(args, "IIKz#s#", &friend_number, &kind, &file_size, &file_id_hex, &file_id_hex_len, &filename, &filename_len) == false)
+    if (PyArg_ParseTuple(args, "IIKOI", &friend_number, &file_number, &file_size, &pybuffer, &timeout) == false)
         return NULL;
 
-    uint8_t  file_id_buf[TOX_FILE_ID_LENGTH];
-    uint8_t* file_id = file_id_buf;
+    int err = 0;
 
-    if (file_id_hex == NULL || file_id_hex_len == 0)
-        file_id = NULL;
-    else if (file_id_hex_len != TOX_FILE_ID_LENGTH * 2) {
-        PyErr_SetString(ToxCoreException, "file_id must be hex string of TOX_FILE_ID_LENGTH length.");
+    ToxFile* item = toxfile_alloc("", 0, (const uint8_t*)"", 0, &err);
+    if (item == NULL)
+        return syserror(err);
+
+    if (toxfile_attach_buffer(item, pybuffer, PyBUF_WRITABLE) == false) {
+        toxfile_free(item);
         return NULL;
-    } else if (hex_string_to_bytes(file_id_hex, TOX_FILE_ID_LENGTH, file_id_buf) == false) {
-        PyErr_SetString(ToxCoreException, "Invalid file_id hex value.");
+    }
+
+    if (item->size < file_size) {
+        toxfile_free(item);
+        PyErr_SetString(ToxCoreException, "Buffer is smaller than file_size.");
         return NULL;
     }
 
+    item->size = file_size;
+
+    if (toxfile_hash_init(self, item, friend_number, file_number) == false) {
+        err = errno;
+        toxfile_free(item);
+        return syserror(err);
+    }
+
     PyThreadState* gil = PyEval_SaveThread();
 
-    TOX_ERR_FILE_SEND error;
-    uint32_t file_number = tox_file_send(self->tox, friend_number, kind, file_size, file_id, filename, filename_len, &error);
+    TOX_ERR_FILE_CONTROL error;
+    bool result = tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_RESUME, &error);
 
     PyEval_RestoreThread(gil);
 
-    if (parse_TOX_ERR_FILE_SEND(error) == false || file_number == UINT32_MAX)
+    if (parse_TOX_ERR_FILE_CONTROL(error) == false || result == false) {
+        toxfile_free(item);
         return NULL;
+    }
 
-    return PyLong_FromUnsignedLong(file_number);
+    item->checkpoint    = time(NULL);
+    item->timeout       = timeout;
+    item->friend_number = friend_number;
+    item->file_number   = file_number;
+
+    if (toxfile_add(self, TOX_FILE_BUCKET_RECV, item, &err) == false) {
+        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+        toxfile_free(item);
+        return syserror(err);
+    }
+
+    Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static bool parse_TOX_ERR_FILE_CONTROL(TOX_ERR_FILE_CONTROL error)
+static uint32_t toxfile_send_avatar(ToxCore* self, uint32_t friend_number, uint32_t timeout, TOX_ERR_FILE_SEND* error, int* err)
 {
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_FILE_CONTROL_OK:
-            success = true;
-            break;
-        case TOX_ERR_FILE_CONTROL_FRIEND_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "The friend_number passed did not designate a valid friend.");
-            break;
-        case TOX_ERR_FILE_CONTROL_FRIEND_NOT_CONNECTED:
-            PyErr_SetString(ToxCoreException, "This client is currently not connected to the friend.");
-            break;
-        case TOX_ERR_FILE_CONTROL_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "No file transfer with the given file number was found for the given friend.");
-            break;
-        case TOX_ERR_FILE_CONTROL_NOT_PAUSED:
-            PyErr_SetString(ToxCoreException, "A RESUME control was sent, but the file transfer is running normally.");
-            break;
-        case TOX_ERR_FILE_CONTROL_DENIED:
-            PyErr_SetString(ToxCoreException, "A RESUME control was sent, but the file transfer was paused by the other party. Only the party that paused the transfer can resume it.");
-            break;
-        case TOX_ERR_FILE_CONTROL_ALREADY_PAUSED:
-            PyErr_SetString(ToxCoreException, "A PAUSE control was sent, but the file transfer was already paused.");
-            break;
-        case TOX_ERR_FILE_CONTROL_SENDQ:
-            PyErr_SetString(ToxCoreException, "Packet queue is full.");
-            break;
+    ToxBlob*    blob     = self->avatar;
+    const char* path     = (blob != NULL ? blob->path : "");
+    size_t      path_len = (blob != NULL ? blob->path_len : 0);
+
+    ToxFile* item = toxfile_alloc(path, path_len, (const uint8_t*)"", 0, err);
+    if (item == NULL)
+        return UINT32_MAX;
+
+    item->blob   = toxblob_ref(blob);
+    item->memory = (blob != NULL ? blob->data : NULL);
+    item->size   = (blob != NULL ? blob->size : 0);
+
+    uint32_t file_number = tox_file_send(self->tox, friend_number, TOX_FILE_KIND_AVATAR, item->size, (blob != NULL ? blob->hash : NULL), NULL, 0, error);
+    if (*error != TOX_ERR_FILE_SEND_OK || file_number == UINT32_MAX) {
+        toxfile_free(item);
+        return UINT32_MAX;
     }
 
-    return success;
+    item->checkpoint    = time(NULL);
+    item->timeout       = timeout;
+    item->friend_number = friend_number;
+    item->file_number   = file_number;
+
+    if (toxfile_add(self, TOX_FILE_BUCKET_SEND, item, err) == false) {
+        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+        toxfile_free(item);
+        return UINT32_MAX;
+    }
+
+    return file_number;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_file_control(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_set_self_avatar(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint32_t         friend_number;
-    uint32_t         file_number;
-    TOX_FILE_CONTROL control;
+    PyObject* pyavatar;
 
-    if (PyArg_ParseTuple(args, "III", &friend_number, &file_number, &control) == false)
+    if (PyArg_ParseTuple(args, "O", &pyavatar) == false)
         return NULL;
 
-    PyThreadState* gil = PyEval_SaveThread();
+    int      err  = 0;
+    ToxBlob* blob = NULL;
 
-    TOX_ERR_FILE_CONTROL error;
-    bool result = tox_file_control(self->tox, friend_number, file_number, control, &error);
+    if (pyavatar == Py_None) {
+        toxblob_unref(self->avatar);
+        self->avatar = NULL;
 
-    PyEval_RestoreThread(gil);
+        Py_RETURN_NONE;
+    }
 
-    if (parse_TOX_ERR_FILE_CONTROL(error) == false || result == false)
-        return NULL;
+    if (PYSTRING_Check(pyavatar)) {
+        char*      path;
+        Py_ssize_t path_len;
 
-    Py_RETURN_NONE;
+        if (PyArg_ParseTuple(args, "s#", &path, &path_len) == false)
+            return NULL;
+
+        PyThreadState* gil = PyEval_SaveThread();
+        blob = toxblob_load(path, path_len, &err);
+        PyEval_RestoreThread(gil);
+    } else {
+        Py_buffer data;
+
+        if (PyArg_ParseTuple(args, "s*", &data) == false)
+            return NULL;
+
+        blob = toxblob_alloc(data.buf, data.len, "", 0, &err);
+
+        PyBuffer_Release(&data);
+    }
+
+    if (blob == NULL)
+        return syserror(err);
+
+    toxblob_unref(self->avatar);
+    self->avatar = blob;
+
+    uint8_t hash_hex[TOX_HASH_LENGTH * 2 + 1];
+    bytes_to_hex_string(blob->hash, TOX_HASH_LENGTH, hash_hex);
+
+    return PYSTRING_FromString((const char*)hash_hex);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_file_send_chunk(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_send_avatar(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint32_t   friend_number;
-    uint32_t   file_number;
-    uint64_t   position;
-    uint8_t*   data;
-    Py_ssize_t length;
+    uint32_t friend_number;
+    uint32_t timeout;
 
-    if (PyArg_ParseTuple(args, "IIKs#", &friend_number, &file_number, &position, &data, &length) == false)
+    if (PyArg_ParseTuple(args, "II", &friend_number, &timeout) == false)
         return NULL;
 
-    PyThreadState* gil = PyEval_SaveThread();
-
-    TOX_ERR_FILE_SEND_CHUNK error;
-    bool result = tox_file_send_chunk(self->tox, friend_number, file_number, position, data, length, &error);
+    int               err   = 0;
+    TOX_ERR_FILE_SEND error = TOX_ERR_FILE_SEND_OK;
 
-    PyEval_RestoreThread(gil);
+    uint32_t file_number = toxfile_send_avatar(self, friend_number, timeout, &error, &err);
+    if (file_number == UINT32_MAX) {
+        if (err != 0)
+            return syserror(err);
 
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_FILE_SEND_CHUNK_OK:
-            success = true;
-            break;
-        case TOX_ERR_FILE_SEND_CHUNK_NULL:
-            PyErr_SetString(ToxCoreException, "The length parameter was non-zero, but data was NULL.");
-            break;
-        case TOX_ERR_FILE_SEND_CHUNK_FRIEND_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "The friend_number passed did not designate a valid friend.");
-            break;
-        case TOX_ERR_FILE_SEND_CHUNK_FRIEND_NOT_CONNECTED:
-            PyErr_SetString(ToxCoreException, "This client is currently not connected to the friend.");
-            break;
-        case TOX_ERR_FILE_SEND_CHUNK_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "No file transfer with the given file number was found for the given friend.");
-            break;
-        case TOX_ERR_FILE_SEND_CHUNK_NOT_TRANSFERRING:
-            PyErr_SetString(ToxCoreException, "File transfer was found but isn't in a transferring state: (paused, done, broken, etc...) (happens only when not called from the request chunk callback).");
-            break;
-        case TOX_ERR_FILE_SEND_CHUNK_INVALID_LENGTH:
-            PyErr_SetString(ToxCoreException, "Attempted to send more or less data than requested. The requested data size is adjusted according to maximum transmission unit and the expected end of the file. Trying to send less or more than requested will return this error.");
-            break;
-        case TOX_ERR_FILE_SEND_CHUNK_SENDQ:
-            PyErr_SetString(ToxCoreException, "Packet queue is full.");
-            break;
-        case TOX_ERR_FILE_SEND_CHUNK_WRONG_POSITION:
-            PyErr_SetString(ToxCoreException, "Position parameter was wrong.");
-            break;
-    }
+        parse_TOX_ERR_FILE_SEND(error);
 
-    if (result == false || success == false)
         return NULL;
+    }
 
-    Py_RETURN_NONE;
+    return PyLong_FromUnsignedLong(file_number);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_self_get_dht_id(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_broadcast_avatar(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint8_t dht_id[TOX_PUBLIC_KEY_SIZE];
-    tox_self_get_dht_id(self->tox, dht_id);
+    uint32_t timeout;
 
-    uint8_t dht_id_hex[TOX_PUBLIC_KEY_SIZE * 2 + 1];
-    bytes_to_hex_string(dht_id, TOX_PUBLIC_KEY_SIZE, dht_id_hex);
+    if (PyArg_ParseTuple(args, "I", &timeout) == false)
+        return NULL;
 
-    return PYSTRING_FromString((const char*)dht_id_hex);
-}
-//----------------------------------------------------------------------------------------------
+    size_t    count = tox_self_get_friend_list_size(self->tox);
+    uint32_t* list  = (uint32_t*)malloc(count * sizeof(uint32_t) + 1);
 
-static PyObject* parse_TOX_ERR_GET_PORT(uint16_t result, TOX_ERR_GET_PORT error)
-{
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_GET_PORT_OK:
-            success = true;
-            break;
-        case TOX_ERR_GET_PORT_NOT_BOUND:
-            PyErr_SetString(ToxCoreException, "The instance was not bound to any port.");
-            break;
+    if (list == NULL) {
+        PyErr_SetString(ToxCoreException, "Can not allocate memory.");
+        return NULL;
     }
 
-    if (success == false)
+    tox_self_get_friend_list(self->tox, list);
+
+    PyObject* plist = PyList_New(0);
+    if (plist == NULL) {
+        free(list);
+        PyErr_SetString(ToxCoreException, "Can not allocate memory.");
         return NULL;
+    }
 
-    return PyLong_FromUnsignedLong(result);
-}
-//----------------------------------------------------------------------------------------------
+    size_t i;
+    for (i = 0; i < count; i++) {
+        TOX_ERR_FRIEND_QUERY query_error;
+        if (tox_friend_get_connection_status(self->tox, list[i], &query_error) == TOX_CONNECTION_NONE)
+            continue;
 
-static PyObject* ToxCore_tox_self_get_udp_port(ToxCore* self, PyObject* args)
-{
-    CHECK_TOX(self);
+        int               err   = 0;
+        TOX_ERR_FILE_SEND error = TOX_ERR_FILE_SEND_OK;
 
-    TOX_ERR_GET_PORT error;
-    uint16_t result = tox_self_get_udp_port(self->tox, &error);
+        uint32_t file_number = toxfile_send_avatar(self, list[i], timeout, &error, &err);
+        if (file_number == UINT32_MAX) {
+            if (err == 0)
+                continue;
 
-    return parse_TOX_ERR_GET_PORT(result, error);
-}
-//----------------------------------------------------------------------------------------------
+            free(list);
+            Py_DECREF(plist);
+            return syserror(err);
+        }
 
-static PyObject* ToxCore_tox_self_get_tcp_port(ToxCore* self, PyObject* args)
-{
-    CHECK_TOX(self);
+        PyObject* item = Py_BuildValue("II", list[i], file_number);
+        if (item == NULL || PyList_Append(plist, item) != 0) {
+            Py_XDECREF(item);
+            free(list);
+            Py_DECREF(plist);
+            return NULL;
+        }
 
-    TOX_ERR_GET_PORT error;
-    uint16_t result = tox_self_get_tcp_port(self->tox, &error);
+        Py_DECREF(item);
+    }
 
-    return parse_TOX_ERR_GET_PORT(result, error);
+    free(list);
+
+    return plist;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_file_seek(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_file_stats(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
+    double now = toxfile_time();
+
+    if (PyTuple_Size(args) == 0) {
+        PyObject* send = toxfile_stats_dict(&self->send_files.stats, now);
+        PyObject* recv = toxfile_stats_dict(&self->recv_files.stats, now);
+
+        PyObject* result = NULL;
+        if (send != NULL && recv != NULL)
+            result = Py_BuildValue("{s:O,s:O}", "send", send, "recv", recv);
+
+        Py_XDECREF(send);
+        Py_XDECREF(recv);
+
+        return result;
+    }
+
     uint32_t friend_number;
     uint32_t file_number;
-    uint64_t position;
 
-    if (PyArg_ParseTuple(args, "IIK", &friend_number, &file_number, &position) == false)
+    if (PyArg_ParseTuple(args, "II", &friend_number, &file_number) == false)
         return NULL;
 
-    PyThreadState* gil = PyEval_SaveThread();
+    size_t   index;
+    ToxFile* item = toxfile_get(self, TOX_FILE_BUCKET_SEND, friend_number, file_number, &index);
+    if (item == NULL)
+        item = toxfile_get(self, TOX_FILE_BUCKET_RECV, friend_number, file_number, &index);
 
-    TOX_ERR_FILE_SEEK error;
-    bool result = tox_file_seek(self->tox, friend_number, file_number, position, &error);
+    if (item == NULL) {
+        PyErr_SetString(ToxCoreException, "No tox_sendfile or tox_recvfile transfer with the given file number was found for the given friend.");
+        return NULL;
+    }
 
-    PyEval_RestoreThread(gil);
+    PyObject* result = toxfile_stats_dict(&item->stats, now);
+    if (result == NULL)
+        return NULL;
 
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_FILE_SEEK_OK:
-            success = true;
-            break;
-        case TOX_ERR_FILE_SEEK_FRIEND_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "The friend_number passed did not designate a valid friend.");
-            break;
-        case TOX_ERR_FILE_SEEK_FRIEND_NOT_CONNECTED:
-            PyErr_SetString(ToxCoreException, "This client is currently not connected to the friend.");
-            break;
-        case TOX_ERR_FILE_SEEK_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "No file transfer with the given file number was found for the given friend.");
-            break;
-        case TOX_ERR_FILE_SEEK_DENIED:
-            PyErr_SetString(ToxCoreException, "File was not in a state where it could be seeked.");
-            break;
-        case TOX_ERR_FILE_SEEK_INVALID_POSITION:
-            PyErr_SetString(ToxCoreException, "Seek position was invalid.");
-            break;
-        case TOX_ERR_FILE_SEEK_SENDQ:
-            PyErr_SetString(ToxCoreException, "Packet queue is full.");
-            break;
+    PyObject* offset = PyLong_FromUnsignedLongLong(item->offset);
+    PyObject* size   = PyLong_FromUnsignedLongLong(item->size);
+    PyObject* gap    = PyFloat_FromDouble(item->gap_avg);
+
+    if (offset == NULL || size == NULL || gap == NULL ||
+        PyDict_SetItemString(result, "offset", offset) != 0 ||
+        PyDict_SetItemString(result, "size", size) != 0 ||
+        PyDict_SetItemString(result, "chunk_gap", gap) != 0) {
+        Py_XDECREF(offset);
+        Py_XDECREF(size);
+        Py_XDECREF(gap);
+        Py_DECREF(result);
+        return NULL;
     }
 
-    if (result == false || success == false)
+    Py_DECREF(offset);
+    Py_DECREF(size);
+    Py_DECREF(gap);
+
+    return result;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_sendfile_rate_limit(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint64_t rate;
+    uint64_t burst = 0;
+
+    if (PyArg_ParseTuple(args, "K|K", &rate, &burst) == false)
         return NULL;
 
+    toxfile_limit_set(&self->send_limit, rate, burst);
+
     Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_file_get_file_id(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_sendfile_friend_rate_limit(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
     uint32_t friend_number;
-    uint32_t file_number;
+    uint64_t rate;
+    uint64_t burst = 0;
 
-    if (PyArg_ParseTuple(args, "II", &friend_number, &file_number) == false)
+    if (PyArg_ParseTuple(args, "IK|K", &friend_number, &rate, &burst) == false)
         return NULL;
 
-    uint8_t file_id[TOX_FILE_ID_LENGTH];
+    if (tox_friend_exists(self->tox, friend_number) == false) {
+        PyErr_SetString(ToxCoreException, "The friend_number passed did not designate a valid friend.");
+        return NULL;
+    }
 
-    TOX_ERR_FILE_GET error;
-    bool result = tox_file_get_file_id(self->tox, friend_number, file_number, file_id, &error);
+    if (friend_number >= self->friend_limits_count) {
+        size_t new_count = friend_number + 1;
 
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_FILE_GET_OK:
-            success = true;
-            break;
-        case TOX_ERR_FILE_GET_NULL:
-            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
-            break;
-        case TOX_ERR_FILE_GET_FRIEND_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "The friend_number passed did not designate a valid friend.");
-            break;
-        case TOX_ERR_FILE_GET_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "No file transfer with the given file number was found for the given friend.");
-            break;
-    }
+        ToxFileLimit* limits = realloc(self->friend_limits, new_count * sizeof(ToxFileLimit));
+        if (limits == NULL)
+            return syserror(errno);
 
-    if (result == false || success == false)
-        return NULL;
+        memset(limits + self->friend_limits_count, 0, (new_count - self->friend_limits_count) * sizeof(ToxFileLimit));
 
-    uint8_t file_id_hex[TOX_FILE_ID_LENGTH * 2 + 1];
-    bytes_to_hex_string(file_id, TOX_FILE_ID_LENGTH, file_id_hex);
+        self->friend_limits       = limits;
+        self->friend_limits_count = new_count;
+    }
 
-    return PYSTRING_FromString((const char*)file_id_hex);
+    toxfile_limit_set(&self->friend_limits[friend_number], rate, burst);
+
+    Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_hash(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_sendqueue(ToxCore* self, PyObject* args)
 {
-    uint8_t*   data;
-    Py_ssize_t data_len;
+    CHECK_TOX(self);
 
-    if (PyArg_ParseTuple(args, "s#", &data, &data_len) == false)
+    uint32_t   friend_number;
+    uint32_t   kind;
+    char*      path;
+    Py_ssize_t path_len;
+    uint8_t*   filename;
+    Py_ssize_t filename_len;
+    uint32_t   timeout;
+
+    if (PyArg_ParseTuple(args, "IIs#s#I", &friend_number, &kind, &path, &path_len, &filename, &filename_len, &timeout) == false)
         return NULL;
 
-    uint8_t hash[TOX_HASH_LENGTH];
+    ToxFileQueue* queue = &self->send_queue;
 
-    bool result = tox_hash(hash, data, data_len);
+    if (queue->index >= queue->count) {
+        size_t new_count = (queue->count == 0 ? 16 : queue->count * 2);
 
-    if (result == false)
-        return NULL;
+        ToxFileJob* jobs = realloc(queue->jobs, new_count * sizeof(ToxFileJob));
+        if (jobs == NULL)
+            return syserror(errno);
 
-    uint8_t hash_hex[TOX_HASH_LENGTH * 2 + 1];
-    bytes_to_hex_string(hash, TOX_FILE_ID_LENGTH, hash_hex);
+        queue->count = new_count;
+        queue->jobs  = jobs;
+    }
 
-    return PYSTRING_FromString((const char*)hash_hex);
+    ToxFileJob job;
+    memset(&job, 0, sizeof(ToxFileJob));
+
+    job.path     = malloc(path_len + 1);
+    job.filename = malloc(filename_len + 1);
+    if (job.path == NULL || job.filename == NULL) {
+        toxfile_job_free(&job);
+        return syserror(errno);
+    }
+
+    memcpy(job.path, path, path_len);
+    job.path[path_len] = 0;
+    job.path_len = path_len;
+
+    memcpy(job.filename, filename, filename_len);
+    job.filename[filename_len] = 0;
+    job.filename_len = filename_len;
+
+    // zero job_id marks transfers not started by queue
+    queue->next_job_id++;
+    if (queue->next_job_id == 0)
+        queue->next_job_id++;
+
+    job.job_id        = queue->next_job_id;
+    job.friend_number = friend_number;
+    job.kind          = kind;
+    job.timeout       = timeout;
+
+    queue->jobs[queue->index] = job;
+    queue->index++;
+    queue->dirty = true;
+
+    return PyLong_FromUnsignedLong(job.job_id);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_iteration_interval(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_sendqueue_limit(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint32_t interval = tox_iteration_interval(self->tox);
+    uint32_t friend_limit;
+    uint32_t total_limit;
 
-    return PyLong_FromUnsignedLong(interval);
+    if (PyArg_ParseTuple(args, "II", &friend_limit, &total_limit) == false)
+        return NULL;
+
+    self->send_queue.friend_limit = friend_limit;
+    self->send_queue.total_limit  = total_limit;
+    self->send_queue.dirty        = true;
+
+    Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_iterate(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_sendqueue_cancel(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    PyThreadState* gil = PyEval_SaveThread();
+    uint32_t job_id;
 
-#ifdef TOX_TOKTOK_STATELESS_CALLBACKS
-    tox_iterate(self->tox, self);
-#else
-    tox_iterate(self->tox);
-#endif
+    if (PyArg_ParseTuple(args, "I", &job_id) == false)
+        return NULL;
 
-    PyEval_RestoreThread(gil);
+    ToxFileQueue* queue = &self->send_queue;
 
-    if (PyErr_Occurred() != NULL)
-        return NULL;
+    size_t i;
+    for (i = 0; i < queue->index; i++) {
+        if (queue->jobs[i].job_id == job_id) {
+            toxfile_job_free(&queue->jobs[i]);
+            memmove(queue->jobs + i, queue->jobs + i + 1, (queue->index - i - 1) * sizeof(ToxFileJob));
+            queue->index--;
+            Py_RETURN_TRUE;
+        }
+    }
 
-    static uint8_t interval = 0;
-    if (interval % 20 == 0) { // ~ 1 sec
-        toxfile_purge_timeout(self, time(NULL));
-        interval = 0;
-    } else
-        interval++;
+    ToxFileBucket* bucket = &self->send_files;
 
-    Py_RETURN_NONE;
+    if (job_id != 0) {
+        for (i = 0; i < bucket->index; i++) {
+            ToxFile* item = bucket->files[i];
+            if (item != NULL && item->job_id == job_id) {
+                tox_file_control(self->tox, item->friend_number, item->file_number, TOX_FILE_CONTROL_CANCEL, NULL);
+                toxfile_remove(self, TOX_FILE_BUCKET_SEND, i);
+                Py_RETURN_TRUE;
+            }
+        }
+    }
+
+    Py_RETURN_FALSE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* parse_TOX_ERR_FRIEND_CUSTOM_PACKET(bool result, TOX_ERR_FRIEND_CUSTOM_PACKET error)
+static PyObject* ToxCore_tox_sendqueue_state(ToxCore* self, PyObject* args)
 {
-    bool success = false;
-    switch (error) {
-        case TOX_ERR_FRIEND_CUSTOM_PACKET_OK:
-            success = true;
-            break;
-        case TOX_ERR_FRIEND_CUSTOM_PACKET_NULL:
-            PyErr_SetString(ToxCoreException, "One of the arguments to the function was NULL when it was not expected.");
-            break;
-        case TOX_ERR_FRIEND_CUSTOM_PACKET_FRIEND_NOT_FOUND:
-            PyErr_SetString(ToxCoreException, "The friend number did not designate a valid friend.");
-            break;
-        case TOX_ERR_FRIEND_CUSTOM_PACKET_FRIEND_NOT_CONNECTED:
-            PyErr_SetString(ToxCoreException, "This client is currently not connected to the friend.");
-            break;
-        case TOX_ERR_FRIEND_CUSTOM_PACKET_INVALID:
-            PyErr_SetString(ToxCoreException, "The first byte of data was not in the specified range for the packet type. This range is 200-254 for lossy, and 160-191 for lossless packets.");
-            break;
-        case TOX_ERR_FRIEND_CUSTOM_PACKET_EMPTY:
-            PyErr_SetString(ToxCoreException, "Attempted to send an empty packet.");
-            break;
-        case TOX_ERR_FRIEND_CUSTOM_PACKET_TOO_LONG:
-            PyErr_SetString(ToxCoreException, "Packet data length exceeded TOX_MAX_CUSTOM_PACKET_SIZE.");
-            break;
-        case TOX_ERR_FRIEND_CUSTOM_PACKET_SENDQ:
-            PyErr_SetString(ToxCoreException, "Packet queue is full.");
-            break;
+    CHECK_TOX(self);
+
+    ToxFileQueue*  queue  = &self->send_queue;
+    ToxFileBucket* bucket = &self->send_files;
+
+    PyObject* pending = PyList_New(0);
+    PyObject* active  = PyList_New(0);
+    PyObject* result  = NULL;
+
+    if (pending == NULL || active == NULL)
+        goto ERROR;
+
+    size_t i;
+    for (i = 0; i < queue->index; i++) {
+        ToxFileJob* job = &queue->jobs[i];
+
+        PyObject* entry = Py_BuildValue("IIs#s#", job->job_id, job->friend_number, job->path, job->path_len, job->filename, job->filename_len);
+        if (entry == NULL || PyList_Append(pending, entry) != 0) {
+            Py_XDECREF(entry);
+            goto ERROR;
+        }
+
+        Py_DECREF(entry);
     }
 
-    if (result == false || success == false)
+    for (i = 0; i < bucket->index; i++) {
+        ToxFile* item = bucket->files[i];
+        if (item == NULL || item->job_id == 0)
+            continue;
+
+        PyObject* entry = Py_BuildValue("IIIKK", item->job_id, item->friend_number, item->file_number, item->offset, item->size);
+        if (entry == NULL || PyList_Append(active, entry) != 0) {
+            Py_XDECREF(entry);
+            goto ERROR;
+        }
+
+        Py_DECREF(entry);
+    }
+
+    result = Py_BuildValue("{s:O,s:O,s:n,s:n}",
+        "pending",      pending,
+        "active",       active,
+        "friend_limit", (Py_ssize_t)queue->friend_limit,
+        "total_limit",  (Py_ssize_t)queue->total_limit);
+
+ERROR:
+
+    Py_XDECREF(pending);
+    Py_XDECREF(active);
+
+    return result;
+}
+//----------------------------------------------------------------------------------------------
+
+static PyObject* ToxCore_tox_sendfile_priority(ToxCore* self, PyObject* args)
+{
+    CHECK_TOX(self);
+
+    uint32_t friend_number;
+    uint32_t file_number;
+    int32_t  priority;
+
+    if (PyArg_ParseTuple(args, "IIi", &friend_number, &file_number, &priority) == false)
+        return NULL;
+
+    size_t index;
+    ToxFile* item = toxfile_get(self, TOX_FILE_BUCKET_SEND, friend_number, file_number, &index);
+    if (item == NULL) {
+        PyErr_SetString(ToxCoreException, "No native transfer found for the given friend_number and file_number.");
         return NULL;
+    }
+
+    item->priority       = priority;
+    self->priority_dirty = true;
 
     Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_friend_send_lossy_packet(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_sendfile_priority_budget(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint32_t   friend_number;
-    uint8_t*   data;
-    Py_ssize_t data_len;
+    uint32_t budget;
 
-    if (PyArg_ParseTuple(args, "Is#", &friend_number, &data, &data_len) == false)
+    if (PyArg_ParseTuple(args, "I", &budget) == false)
         return NULL;
 
-    PyThreadState* gil = PyEval_SaveThread();
+    // zero budget disables scheduling, resume everything preempted before
+    if (budget == 0) {
+        size_t i;
+        for (i = 0; i < self->send_files.index; i++) {
+            ToxFile* item = self->send_files.files[i];
+            if (item == NULL || item->preempted == false)
+                continue;
 
-    TOX_ERR_FRIEND_CUSTOM_PACKET error;
-    bool result = tox_friend_send_lossy_packet(self->tox, friend_number, data, data_len, &error);
+            item->preempted  = false;
+            item->checkpoint = time(NULL);
 
-    PyEval_RestoreThread(gil);
+            if (item->paused == false)
+                tox_file_control(self->tox, item->friend_number, item->file_number, TOX_FILE_CONTROL_RESUME, NULL);
+        }
+    }
 
-    return parse_TOX_ERR_FRIEND_CUSTOM_PACKET(result, error);
+    self->priority_budget = budget;
+    self->priority_dirty  = true;
+
+    Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_friend_send_lossless_packet(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_recvfile_cache(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint32_t   friend_number;
-    uint8_t*   data;
-    Py_ssize_t data_len;
+    char*              path;
+    Py_ssize_t         path_len;
+    unsigned long long limit = TOX_FILE_CACHE_LIMIT;
 
-    if (PyArg_ParseTuple(args, "Is#", &friend_number, &data, &data_len) == false)
+    if (PyArg_ParseTuple(args, "z#|K", &path, &path_len, &limit) == false)
         return NULL;
 
-    PyThreadState* gil = PyEval_SaveThread();
+    char* cache_path = NULL;
 
-    TOX_ERR_FRIEND_CUSTOM_PACKET error;
-    bool result = tox_friend_send_lossless_packet(self->tox, friend_number, data, data_len, &error);
+    if (path != NULL) {
+        struct stat info;
+        if (stat(path, &info) != 0)
+            return syserror(errno);
 
-    PyEval_RestoreThread(gil);
+        if (S_ISDIR(info.st_mode) == 0)
+            return syserror(ENOTDIR);
 
-    return parse_TOX_ERR_FRIEND_CUSTOM_PACKET(result, error);
+        cache_path = malloc(path_len + 1);
+        if (cache_path == NULL)
+            return syserror(errno);
+
+        memcpy(cache_path, path, path_len);
+        cache_path[path_len] = 0;
+    }
+
+    free(self->cache_path);
+
+    self->cache_path     = cache_path;
+    self->cache_path_len = (cache_path != NULL ? path_len : 0);
+    self->cache_limit    = limit;
+
+    if (cache_path != NULL) {
+        toxfile_cache_scan(self);
+        toxfile_cache_evict(self);
+    } else
+        toxfile_cache_reset(self);
+
+    Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_keypair_new(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_file_fd_limit(ToxCore* self, PyObject* args)
 {
-    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
-    uint8_t secret_key[TOX_SECRET_KEY_SIZE];
+    CHECK_TOX(self);
 
-    crypto_box_keypair(public_key, secret_key);
+    uint32_t limit;
 
-    uint8_t public_key_hex[TOX_PUBLIC_KEY_SIZE * 2 + 1];
-    bytes_to_hex_string(public_key, TOX_PUBLIC_KEY_SIZE, public_key_hex);
+    if (PyArg_ParseTuple(args, "I", &limit) == false)
+        return NULL;
 
-    uint8_t secret_key_hex[TOX_SECRET_KEY_SIZE * 2 + 1];
-    bytes_to_hex_string(secret_key, TOX_SECRET_KEY_SIZE, secret_key_hex);
+    self->fd_limit = limit;
 
-    // Py_BuildValue("ss", public_key_hex, secret_key_hex);
-    PyObject* result = PyTuple_New(2);
-    PyTuple_SetItem(result, 0, PYSTRING_FromString((const char*)public_key_hex));
-    PyTuple_SetItem(result, 1, PYSTRING_FromString((const char*)secret_key_hex));
+    toxfile_fd_reserve(self, NULL);
 
-    return result;
+    return PyLong_FromSize_t(self->fd_lru.count);
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_public_key_restore(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_file_adaptive_timeout(ToxCore* self, PyObject* args)
 {
-    uint8_t*   secret_key_hex;
-    Py_ssize_t secret_key_hex_len;
+    CHECK_TOX(self);
 
-    if (PyArg_ParseTuple(args, "s#", &secret_key_hex, &secret_key_hex_len) == false)
-        return NULL;
+    double   multiplier;
+    uint32_t floor_timeout = TOX_FILE_ADAPTIVE_FLOOR;
 
-    if (secret_key_hex_len != TOX_SECRET_KEY_SIZE * 2) {
-        PyErr_SetString(ToxCoreException, "secret_key must be hex string of TOX_SECRET_KEY_SIZE bytes length.");
+    if (PyArg_ParseTuple(args, "d|I", &multiplier, &floor_timeout) == false)
         return NULL;
-    }
 
-    uint8_t secret_key[TOX_SECRET_KEY_SIZE];
-    if (hex_string_to_bytes(secret_key_hex, TOX_SECRET_KEY_SIZE, secret_key) == false) {
-        PyErr_SetString(ToxCoreException, "Invalid secret_key hex value.");
+    if (multiplier < 0) {
+        PyErr_SetString(ToxCoreException, "Multiplier must not be negative.");
         return NULL;
     }
 
-    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
-    crypto_scalarmult_base(public_key, secret_key);
-
-    uint8_t public_key_hex[TOX_PUBLIC_KEY_SIZE * 2 + 1];
-    bytes_to_hex_string(public_key, TOX_PUBLIC_KEY_SIZE, public_key_hex);
+    self->timeout_multiplier = multiplier;
+    self->timeout_floor      = floor_timeout;
 
-    return PYSTRING_FromString((const char*)public_key_hex);
+    Py_RETURN_NONE;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_nospam_new(ToxCore* self, PyObject* args)
+static uint8_t* toxfile_pack(uint8_t* p, uint64_t value, size_t size)
 {
-    uint32_t result = randombytes_random();
-
-    uint8_t result_hex[sizeof(uint32_t) * 2 + 1];
-    bytes_to_hex_string((const uint8_t*)(&result), sizeof(uint32_t), result_hex);
+    size_t i;
+    for (i = 0; i < size; i++)
+        p[i] = (uint8_t)(value >> ((size - 1 - i) * 8));
 
-    return PYSTRING_FromString((const char*)result_hex);
+    return p + size;
 }
 //----------------------------------------------------------------------------------------------
 
-static uint16_t checksum(const uint8_t* data, size_t len)
+static bool toxfile_unpack(const uint8_t** p, const uint8_t* end, uint64_t* value, size_t size)
 {
+    if ((size_t)(end - *p) < size)
+        return false;
+
+    *value = 0;
+
     size_t i;
-    uint16_t result = 0;
-    uint8_t* hash   = (uint8_t*)(&result);
-    for (i = 0; i < len; i++)
-        hash[i % 2] ^= data[i];
+    for (i = 0; i < size; i++)
+        *value = (*value << 8) | (*p)[i];
 
-    return result;
+    *p += size;
+
+    return true;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_address_new(ToxCore* self, PyObject* args)
+static bool toxfile_restore_from_item(ToxCore* self, bool send, const ToxFile* item, ToxFileRestore* restore)
 {
-    uint8_t*   public_key_hex;
-    Py_ssize_t public_key_hex_len;
-    uint8_t*   nospam_hex;
-    Py_ssize_t nospam_hex_len;
+    // only regular files opened by path can be reopened after restart
+    if (item == NULL || item->fd_lru == NULL)
+        return false;
+
+    if (tox_friend_get_public_key(self->tox, item->friend_number, restore->public_key, NULL) == false ||
+        tox_file_get_file_id(self->tox, item->friend_number, item->file_number, restore->file_id, NULL) == false)
+        return false;
+
+    restore->send         = send;
+    restore->kind         = (item->verify == true ? TOX_FILE_KIND_AVATAR : item->kind);
+    restore->offset       = item->offset;
+    restore->size         = item->size;
+    restore->timeout      = item->timeout;
+    restore->path         = item->path;
+    restore->path_len     = item->path_len;
+    restore->filename     = item->filename;
+    restore->filename_len = item->filename_len;
 
-    if (PyArg_ParseTuple(args, "s#s#", &public_key_hex, &public_key_hex_len, &nospam_hex, &nospam_hex_len) == false)
-        return NULL;
+    return true;
+}
+//----------------------------------------------------------------------------------------------
 
-    if (public_key_hex_len != TOX_PUBLIC_KEY_SIZE * 2) {
-        PyErr_SetString(ToxCoreException, "public_key must be hex string of TOX_PUBLIC_KEY_SIZE bytes length.");
-        return NULL;
-    }
+static size_t toxfile_restore_size(const ToxFileRestore* restore)
+{
+    return 1 + 4 + TOX_PUBLIC_KEY_SIZE + TOX_FILE_ID_LENGTH + 8 + 8 + 4 + 2 + restore->path_len + 2 + restore->filename_len;
+}
+//----------------------------------------------------------------------------------------------
 
-    if (nospam_hex_len != sizeof(uint32_t) * 2) {
-        PyErr_SetString(ToxCoreException, "nospam must be hex string of 4 bytes length.");
-        return NULL;
-    }
+static uint8_t* toxfile_restore_pack(uint8_t* p, const ToxFileRestore* restore)
+{
+    p = toxfile_pack(p, restore->send, 1);
+    p = toxfile_pack(p, restore->kind, 4);
 
-    uint32_t nospam;
-    if (hex_string_to_bytes(nospam_hex, sizeof(uint32_t), (uint8_t*)(&nospam)) == false) {
-        PyErr_SetString(ToxCoreException, "Invalid nospam hex value.");
-        return NULL;
-    }
+    memcpy(p, restore->public_key, TOX_PUBLIC_KEY_SIZE);
+    p += TOX_PUBLIC_KEY_SIZE;
 
-    uint8_t public_key[TOX_PUBLIC_KEY_SIZE];
-    if (hex_string_to_bytes(public_key_hex, TOX_PUBLIC_KEY_SIZE, public_key) == false) {
-        PyErr_SetString(ToxCoreException, "Invalid public_key hex value.");
-        return NULL;
-    }
+    memcpy(p, restore->file_id, TOX_FILE_ID_LENGTH);
+    p += TOX_FILE_ID_LENGTH;
 
-    uint8_t address[TOX_ADDRESS_SIZE];
-    memcpy(address, public_key, TOX_PUBLIC_KEY_SIZE);
-    memcpy(address + TOX_PUBLIC_KEY_SIZE, &nospam, sizeof(nospam));
+    p = toxfile_pack(p, restore->offset, 8);
+    p = toxfile_pack(p, restore->size, 8);
+    p = toxfile_pack(p, restore->timeout, 4);
 
-    uint16_t hash = checksum(address, TOX_PUBLIC_KEY_SIZE + sizeof(nospam));
-    memcpy(address + TOX_PUBLIC_KEY_SIZE + sizeof(nospam), &hash, sizeof(uint16_t));
+    p = toxfile_pack(p, restore->path_len, 2);
+    memcpy(p, restore->path, restore->path_len);
+    p += restore->path_len;
 
-    uint8_t address_hex[TOX_ADDRESS_SIZE * 2 + 1];
-    bytes_to_hex_string(address, TOX_ADDRESS_SIZE, address_hex);
+    p = toxfile_pack(p, restore->filename_len, 2);
+    memcpy(p, restore->filename, restore->filename_len);
+    p += restore->filename_len;
 
-    return PYSTRING_FromString((const char*)address_hex);
+    return p;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_address_check(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_transfers_save(ToxCore* self, PyObject* args)
 {
-    uint8_t*   address_hex;
-    Py_ssize_t address_hex_len;
+    CHECK_TOX(self);
 
-    if (PyArg_ParseTuple(args, "s#", &address_hex, &address_hex_len) == false)
-        return NULL;
+    size_t total   = self->send_files.index + self->recv_files.index + self->restores_index;
+    size_t count   = 0;
+    size_t size    = 4 + 1 + 4;
+    uint8_t* data  = NULL;
 
-    if (address_hex_len != TOX_ADDRESS_SIZE * 2) {
-        PyErr_SetString(ToxCoreException, "address must be hex string of TOX_ADDRESS_SIZE bytes length.");
-        return NULL;
+    ToxFileRestore* entries = malloc((total != 0 ? total : 1) * sizeof(ToxFileRestore));
+    if (entries == NULL)
+        return syserror(errno);
+
+    size_t i;
+    for (i = 0; i < self->send_files.index; i++)
+        if (toxfile_restore_from_item(self, true, self->send_files.files[i], &entries[count]) == true)
+            count++;
+
+    for (i = 0; i < self->recv_files.index; i++)
+        if (toxfile_restore_from_item(self, false, self->recv_files.files[i], &entries[count]) == true)
+            count++;
+
+    // entries restored earlier but not armed yet survive another restart
+    for (i = 0; i < self->restores_index; i++)
+        entries[count++] = self->restores[i];
+
+    for (i = 0; i < count; i++) {
+        if (entries[i].path_len > UINT16_MAX || entries[i].filename_len > UINT16_MAX) {
+            entries[i--] = entries[--count];
+            continue;
+        }
+
+        size += toxfile_restore_size(&entries[i]);
     }
 
-    uint8_t address[TOX_ADDRESS_SIZE];
-    if (hex_string_to_bytes(address_hex, TOX_ADDRESS_SIZE, address) == false) {
-        PyErr_SetString(ToxCoreException, "Invalid address hex value.");
-        return NULL;
+    data = malloc(size);
+    if (data == NULL) {
+        free(entries);
+        return syserror(errno);
     }
 
-    uint16_t src_hash;
-    memcpy(&src_hash, address + TOX_PUBLIC_KEY_SIZE + sizeof(uint32_t), sizeof(src_hash));
+    uint8_t* p = data;
+    p = toxfile_pack(p, TOX_FILE_RESTORE_MAGIC, 4);
+    p = toxfile_pack(p, TOX_FILE_RESTORE_VERSION, 1);
+    p = toxfile_pack(p, count, 4);
 
-    uint16_t real_hash = checksum(address, TOX_PUBLIC_KEY_SIZE + sizeof(uint32_t));
+    for (i = 0; i < count; i++)
+        p = toxfile_restore_pack(p, &entries[i]);
 
-    if (src_hash != real_hash) {
-        PyErr_SetString(ToxCoreException, "Invalid address checksum.");
-        return NULL;
-    }
+    PyObject* result = PYBYTES_FromStringAndSize((const char*)data, size);
 
-    Py_RETURN_NONE;
+    free(data);
+    free(entries);
+
+    return result;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_sendfile(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_transfers_restore(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint32_t   friend_number;
-    uint32_t   kind;
-    char*      path;
-    Py_ssize_t path_len;
-    uint8_t*   filename;
-    Py_ssize_t filename_len;
-    uint32_t   timeout;
+    uint8_t*   data;
+    Py_ssize_t size;
 
-    if (PyArg_ParseTuple(args, "IIs#s#I", &friend_number, &kind, &path, &path_len, &filename, &filename_len, &timeout) == false)
+    if (PyArg_ParseTuple(args, BUF_TCS, &data, &size) == false)
         return NULL;
 
-    PyThreadState* gil = PyEval_SaveThread();
+    const uint8_t* p   = data;
+    const uint8_t* end = data + size;
 
-    int      err     = 0;
-    ToxFile* item    = NULL;
-    uint8_t* data    = NULL;
-    uint8_t* file_id = NULL;
-    uint8_t  file_id_buf[TOX_FILE_ID_LENGTH];
+    uint64_t magic;
+    uint64_t version;
+    uint64_t count;
 
-    struct stat info;
-    if (stat(path, &info) != 0) {
-        err = errno;
-        goto ERROR;
-    }
+    if (toxfile_unpack(&p, end, &magic, 4) == false || magic != TOX_FILE_RESTORE_MAGIC ||
+        toxfile_unpack(&p, end, &version, 1) == false || version != TOX_FILE_RESTORE_VERSION ||
+        toxfile_unpack(&p, end, &count, 4) == false)
+        goto INVALID;
 
-    if (S_ISREG(info.st_mode) == 0) {
-        PyEval_RestoreThread(gil);
-        PyErr_SetString(ToxCoreException, "File not found.");
-        return NULL;
-    }
+    // each entry takes at least fixed part, reject count before allocating
+    if (count > (uint64_t)(end - p) / (1 + 4 + TOX_PUBLIC_KEY_SIZE + TOX_FILE_ID_LENGTH + 8 + 8 + 4 + 2 + 2))
+        goto INVALID;
 
-    item = toxfile_alloc(path, path_len, filename, filename_len, &err);
-    if (item == NULL)
-        goto ERROR;
+    ToxFileRestore* restores = calloc(count != 0 ? count : 1, sizeof(ToxFileRestore));
+    if (restores == NULL)
+        return syserror(errno);
 
-    item->size = info.st_size;
-    item->fd   = open(path, O_RDONLY);
-    if (item->fd == -1) {
-        err = errno;
-        goto ERROR;
-    }
+    time_t expires = time(NULL) + TOX_FILE_RESTORE_EXPIRY;
 
-    if (kind == TOX_FILE_KIND_AVATAR) {
-        data = malloc(info.st_size);
-        if (data == NULL) {
-            err = errno;
-            goto ERROR;
-        }
+    size_t i;
+    for (i = 0; i < count; i++) {
+        ToxFileRestore* restore = &restores[i];
 
-        while (item->offset < item->size) {
-            ssize_t actual = read(item->fd, data + item->offset, item->size - item->offset);
-            if (actual == -1) {
-                err = errno;
-                goto ERROR;
-            }
+        uint64_t send, kind, timeout, path_len, filename_len;
 
-            item->offset += actual;
-        }
+        if (toxfile_unpack(&p, end, &send, 1) == false ||
+            toxfile_unpack(&p, end, &kind, 4) == false ||
+            (size_t)(end - p) < TOX_PUBLIC_KEY_SIZE + TOX_FILE_ID_LENGTH)
+            break;
 
-        if (tox_hash(file_id_buf, data, item->size) == false)
-            goto ERROR;
+        memcpy(restore->public_key, p, TOX_PUBLIC_KEY_SIZE);
+        p += TOX_PUBLIC_KEY_SIZE;
 
-        free(data);
+        memcpy(restore->file_id, p, TOX_FILE_ID_LENGTH);
+        p += TOX_FILE_ID_LENGTH;
 
-        data    = NULL;
-        file_id = file_id_buf;
+        if (toxfile_unpack(&p, end, &restore->offset, 8) == false ||
+            toxfile_unpack(&p, end, &restore->size, 8) == false ||
+            toxfile_unpack(&p, end, &timeout, 4) == false ||
+            toxfile_unpack(&p, end, &path_len, 2) == false ||
+            (uint64_t)(end - p) < path_len)
+            break;
 
-        if (lseek(item->fd, 0, SEEK_SET) == -1) {
-            err = errno;
-            goto ERROR;
-        }
+        restore->path = malloc(path_len + 1);
+        if (restore->path == NULL)
+            break;
 
-        item->offset = 0;
-    }
+        memcpy(restore->path, p, path_len);
+        restore->path[path_len] = 0;
+        p += path_len;
 
-    TOX_ERR_FILE_SEND error;
-    uint32_t          file_number;
+        if (toxfile_unpack(&p, end, &filename_len, 2) == false || (uint64_t)(end - p) < filename_len)
+            break;
 
-    if (kind == TOX_FILE_KIND_AVATAR)
-        file_number = tox_file_send(self->tox, friend_number, kind, item->size, file_id, NULL, 0, &error);
-    else
-        file_number = tox_file_send(self->tox, friend_number, kind, item->size, file_id, filename, filename_len, &error);
+        restore->filename = malloc(filename_len + 1);
+        if (restore->filename == NULL)
+            break;
 
-    PyEval_RestoreThread(gil);
-    gil = NULL;
+        memcpy(restore->filename, p, filename_len);
+        restore->filename[filename_len] = 0;
+        p += filename_len;
 
-    if (parse_TOX_ERR_FILE_SEND(error) == false || file_number == UINT32_MAX)
-        goto ERROR;
+        restore->send         = (send != 0);
+        restore->kind         = kind;
+        restore->timeout      = timeout;
+        restore->path_len     = path_len;
+        restore->filename_len = filename_len;
+        restore->expires      = expires;
+    }
 
-    item->checkpoint    = time(NULL);
-    item->timeout       = timeout;
-    item->friend_number = friend_number;
-    item->file_number   = file_number;
+    if (i != count) {
+        for (i = 0; i < count; i++)
+            toxfile_restore_free(&restores[i]);
 
-    if (toxfile_add(self, TOX_FILE_BUCKET_SEND, item, &err) == false) {
-        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
-        goto ERROR;
+        free(restores);
+        goto INVALID;
     }
 
-    return PyLong_FromUnsignedLong(file_number);
+    toxfile_restore_clear(self);
 
-ERROR:
+    self->restores       = restores;
+    self->restores_index = count;
+    self->restores_count = (count != 0 ? count : 1);
 
-    free(data);
+    // friends already online get their sends re-armed now, others on reconnect
+    size_t    friends = tox_self_get_friend_list_size(self->tox);
+    uint32_t* list    = malloc((friends != 0 ? friends : 1) * sizeof(uint32_t));
+    if (list != NULL) {
+        tox_self_get_friend_list(self->tox, list);
 
-    toxfile_free(item);
+        for (i = 0; i < friends; i++)
+            if (tox_friend_get_connection_status(self->tox, list[i], NULL) != TOX_CONNECTION_NONE)
+                toxfile_restore_friend(self, list[i]);
 
-    if (gil != NULL)
-        PyEval_RestoreThread(gil);
+        free(list);
+    }
 
-    if (err != 0)
-        return syserror(err);
+    return PyLong_FromSize_t(count);
 
+INVALID:
+
+    PyErr_SetString(ToxCoreException, "Invalid transfers data.");
     return NULL;
 }
 //----------------------------------------------------------------------------------------------
 
-static PyObject* ToxCore_tox_recvfile(ToxCore* self, PyObject* args)
+static PyObject* ToxCore_tox_file_recv_chunk_coalesce(ToxCore* self, PyObject* args)
 {
     CHECK_TOX(self);
 
-    uint32_t   friend_number;
-    uint32_t   file_number;
-    uint64_t   file_size;
-    char*      path;
-    Py_ssize_t path_len;
-    uint8_t*   filename;
-    Py_ssize_t filename_len;
-    uint32_t   timeout;
+    uint32_t block_size;
 
-    if (PyArg_ParseTuple(args, "IIKs#s#I", &friend_number, &file_number, &file_size, &path, &path_len, &filename, &filename_len, &timeout) == false)
+    if (PyArg_ParseTuple(args, "I", &block_size) == false)
         return NULL;
 
-    PyThreadState* gil = PyEval_SaveThread();
-
-    int      err  = 0;
-    ToxFile* item = NULL;
-
-    item = toxfile_alloc(path, path_len, filename, filename_len, &err);
-    if (item == NULL)
-        goto ERROR;
-
-    item->size = file_size;
-    item->fd   = open(path, O_CREAT | O_TRUNC | O_APPEND | O_WRONLY, 0644);
-    if (item->fd == -1) {
-        err = errno;
-        goto ERROR;
-    }
-
-    TOX_ERR_FILE_CONTROL error;
-    bool result = tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_RESUME, &error);
-
-    PyEval_RestoreThread(gil);
-    gil = NULL;
-
-    if (parse_TOX_ERR_FILE_CONTROL(error) == false || result == false)
-        goto ERROR;
+    // buffers are sized for the previous block size, deliver them first
+    toxfile_coalesce_idle(self, 0, true);
 
-    item->checkpoint    = time(NULL);
-    item->timeout       = timeout;
-    item->friend_number = friend_number;
-    item->file_number   = file_number;
+    toxfile_coalesce_clear(self);
 
-    if (toxfile_add(self, TOX_FILE_BUCKET_RECV, item, &err) == false) {
-        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
-        goto ERROR;
-    }
+    self->coalesce_size = block_size;
 
     Py_RETURN_NONE;
-
-ERROR:
-
-    toxfile_free(item);
-
-    if (gil != NULL) {
-        tox_file_control(self->tox, friend_number, file_number, TOX_FILE_CONTROL_CANCEL, NULL);
-        PyEval_RestoreThread(gil);
-    }
-
-    if (err != 0)
-        return syserror(err);
-
-    return NULL;
 }
 //----------------------------------------------------------------------------------------------
 
@@ -2458,8 +5707,14 @@ PyMethodDef ToxCore_methods[] = {
     },
     {
         "tox_recvfile_cb", (PyCFunction)ToxCore_callback_stub, METH_VARARGS,
-        "tox_recvfile_cb(friend_number, file_number, path, filename, status)\n"
-        "This event is triggered when tox_recvfile call finished."
+        "tox_recvfile_cb(friend_number, file_number, path, filename, status, digest)\n"
+        "This event is triggered when tox_recvfile call finished. Digest is hex SHA-256 "
+        "of received data or None."
+    },
+    {
+        "tox_sendqueue_cb", (PyCFunction)ToxCore_callback_stub, METH_VARARGS,
+        "tox_sendqueue_cb(job_id, friend_number, file_number, path, filename, status)\n"
+        "This event is triggered when queued job started or can not be started."
     },
 
     //
@@ -2850,12 +6105,139 @@ PyMethodDef ToxCore_methods[] = {
     {
         "tox_sendfile", (PyCFunction)ToxCore_tox_sendfile, METH_VARARGS,
         "tox_sendfile(friend_number, kind, path, filename, timeout)\n"
-        "Send file to a friend like system sendfile."
+        "Send file to a friend like system sendfile. Path may be a file-like object "
+        "with readinto method. FIFO, socket or integer fd is streamed until EOF as file "
+        "of unknown size."
     },
     {
         "tox_recvfile", (PyCFunction)ToxCore_tox_recvfile, METH_VARARGS,
         "tox_recvfile(friend_number, file_number, file_size, path, filename, timeout)\n"
-        "Receive file from a friend and store it to path."
+        "Receive file from a friend and store it to path. Path may be a file-like "
+        "object with write method."
+    },
+    {
+        "tox_sendbuffer", (PyCFunction)ToxCore_tox_sendbuffer, METH_VARARGS,
+        "tox_sendbuffer(friend_number, kind, buffer, filename, timeout)\n"
+        "Send content of bytes-like object to a friend like tox_sendfile."
+    },
+    {
+        "tox_recvbuffer", (PyCFunction)ToxCore_tox_recvbuffer, METH_VARARGS,
+        "tox_recvbuffer(friend_number, file_number, file_size, buffer, timeout)\n"
+        "Receive file from a friend into writable bytes-like object (bytearray, memoryview) "
+        "of at least file_size bytes like tox_recvfile."
+    },
+    {
+        "tox_set_self_avatar", (PyCFunction)ToxCore_tox_set_self_avatar, METH_VARARGS,
+        "tox_set_self_avatar(data_or_path)\n"
+        "Load avatar from path (string) or data (bytes-like object) once and keep it "
+        "in memory for tox_send_avatar and tox_broadcast_avatar. Return avatar hash. "
+        "None clears avatar."
+    },
+    {
+        "tox_send_avatar", (PyCFunction)ToxCore_tox_send_avatar, METH_VARARGS,
+        "tox_send_avatar(friend_number, timeout)\n"
+        "Send avatar set by tox_set_self_avatar to a friend. Return file_number."
+    },
+    {
+        "tox_broadcast_avatar", (PyCFunction)ToxCore_tox_broadcast_avatar, METH_VARARGS,
+        "tox_broadcast_avatar(timeout)\n"
+        "Send avatar set by tox_set_self_avatar to all online friends. Return list of "
+        "(friend_number, file_number) tuples."
+    },
+    {
+        "tox_file_stats", (PyCFunction)ToxCore_tox_file_stats, METH_VARARGS,
+        "tox_file_stats([friend_number, file_number])\n"
+        "Return throughput statistics of tox_sendfile and tox_recvfile transfers. Without "
+        "arguments return aggregate {\"send\": {...}, \"recv\": {...}} of the instance, "
+        "otherwise statistics of the given transfer."
+    },
+    {
+        "tox_sendfile_rate_limit", (PyCFunction)ToxCore_tox_sendfile_rate_limit, METH_VARARGS,
+        "tox_sendfile_rate_limit(rate, burst=rate)\n"
+        "Limit total send rate (bytes per second) of tox_sendfile transfers. Zero rate "
+        "disables limit. Throttled transfers are paused and resumed automatically."
+    },
+    {
+        "tox_sendfile_friend_rate_limit", (PyCFunction)ToxCore_tox_sendfile_friend_rate_limit, METH_VARARGS,
+        "tox_sendfile_friend_rate_limit(friend_number, rate, burst=rate)\n"
+        "Limit send rate (bytes per second) of tox_sendfile transfers to a friend. Zero "
+        "rate disables limit."
+    },
+    {
+        "tox_sendqueue", (PyCFunction)ToxCore_tox_sendqueue, METH_VARARGS,
+        "tox_sendqueue(friend_number, kind, path, filename, timeout)\n"
+        "Queue file for tox_sendfile. Queued files are started from tox_iterate within "
+        "limits set by tox_sendqueue_limit. Return job_id."
+    },
+    {
+        "tox_sendqueue_limit", (PyCFunction)ToxCore_tox_sendqueue_limit, METH_VARARGS,
+        "tox_sendqueue_limit(friend_limit, total_limit)\n"
+        "Limit number of active queued transfers per friend and total. Zero disables limit."
+    },
+    {
+        "tox_sendqueue_cancel", (PyCFunction)ToxCore_tox_sendqueue_cancel, METH_VARARGS,
+        "tox_sendqueue_cancel(job_id)\n"
+        "Remove pending job from queue or cancel its active transfer. Return True if job found."
+    },
+    {
+        "tox_sendqueue_state", (PyCFunction)ToxCore_tox_sendqueue_state, METH_NOARGS,
+        "tox_sendqueue_state()\n"
+        "Return dict with pending jobs (job_id, friend_number, path, filename), active "
+        "jobs (job_id, friend_number, file_number, offset, size) and limits."
+    },
+    {
+        "tox_recvfile_cache", (PyCFunction)ToxCore_tox_recvfile_cache, METH_VARARGS,
+        "tox_recvfile_cache(path[, limit])\n"
+        "Set directory of received files cache keyed by file_id and its size limit in bytes "
+        "(0 - unlimited). Only files which SHA-256 equals file_id are cached. Incoming transfers "
+        "with cached file_id are canceled and reported to tox_recvfile_cb with cached path. "
+        "None disables cache."
+    },
+    {
+        "tox_file_fd_limit", (PyCFunction)ToxCore_tox_file_fd_limit, METH_VARARGS,
+        "tox_file_fd_limit(limit)\n"
+        "Limit number of file descriptors kept open by native transfers. Least recently "
+        "used files are closed and reopened by path on next chunk. Zero disables limit. "
+        "Return number of open descriptors."
+    },
+    {
+        "tox_file_adaptive_timeout", (PyCFunction)ToxCore_tox_file_adaptive_timeout, METH_VARARGS,
+        "tox_file_adaptive_timeout(multiplier, floor=5)\n"
+        "Expire native transfers idle longer than multiplier times their own smoothed "
+        "chunk inter-arrival time (not less than floor seconds) instead of fixed timeout. "
+        "Zero multiplier disables adaptive mode."
+    },
+    {
+        "tox_transfers_save", (PyCFunction)ToxCore_tox_transfers_save, METH_NOARGS,
+        "tox_transfers_save()\n"
+        "Serialize state of native file transfers into bytes to be stored alongside "
+        "savedata."
+    },
+    {
+        "tox_transfers_restore", (PyCFunction)ToxCore_tox_transfers_restore, METH_VARARGS,
+        "tox_transfers_restore(data)\n"
+        "Restore transfers saved by tox_transfers_save. Sends are restarted when a friend "
+        "comes online, receives are resumed when a friend offers the same file_id. "
+        "Entries not claimed within a day or belonging to deleted friends are dropped. "
+        "Return number of restored entries."
+    },
+    {
+        "tox_file_recv_chunk_coalesce", (PyCFunction)ToxCore_tox_file_recv_chunk_coalesce, METH_VARARGS,
+        "tox_file_recv_chunk_coalesce(block_size)\n"
+        "Buffer consecutive chunks of transfers not handled by tox_recvfile and call "
+        "tox_file_recv_chunk_cb once per block_size bytes. Zero disables coalescing."
+    },
+    {
+        "tox_sendfile_priority", (PyCFunction)ToxCore_tox_sendfile_priority, METH_VARARGS,
+        "tox_sendfile_priority(friend_number, file_number, priority)\n"
+        "Set priority of native send transfer (default 0). Transfers to the same friend "
+        "with lower priority are paused while higher priority ones run."
+    },
+    {
+        "tox_sendfile_priority_budget", (PyCFunction)ToxCore_tox_sendfile_priority_budget, METH_VARARGS,
+        "tox_sendfile_priority_budget(budget)\n"
+        "Set number of highest priority transfers per friend that run before lower "
+        "priority ones are paused (default 1). Zero disables priorities."
     },
 
     {
@@ -3194,6 +6576,51 @@ static PyObject* ToxCore_new(PyTypeObject* type, PyObject* args, PyObject* kwds)
     memset(&self->send_files, 0, sizeof(ToxFileBucket));
     memset(&self->recv_files, 0, sizeof(ToxFileBucket));
 
+    self->avatar = NULL;
+
+    memset(&self->send_limit, 0, sizeof(ToxFileLimit));
+
+    self->friend_limits       = NULL;
+    self->friend_limits_count = 0;
+
+    memset(&self->send_queue, 0, sizeof(ToxFileQueue));
+    self->send_queue.friend_limit = TOX_FILE_QUEUE_FRIEND_LIMIT;
+    self->send_queue.total_limit  = TOX_FILE_QUEUE_TOTAL_LIMIT;
+
+    self->avatar_announces       = NULL;
+    self->avatar_announces_index = 0;
+    self->avatar_announces_count = 0;
+
+    self->priority_budget     = TOX_FILE_PRIORITY_BUDGET;
+    self->priority_index      = 0;
+    self->priority_checkpoint = 0;
+    self->priority_dirty      = false;
+
+    self->cache_path     = NULL;
+    self->cache_path_len = 0;
+    self->cache_limit    = TOX_FILE_CACHE_LIMIT;
+    self->cache_entries  = NULL;
+    self->cache_index    = 0;
+    self->cache_count    = 0;
+    self->cache_total    = 0;
+
+    self->fd_limit = 0;
+    self->fd_lru.head  = NULL;
+    self->fd_lru.tail  = NULL;
+    self->fd_lru.count = 0;
+
+    self->timeout_multiplier = 0;
+    self->timeout_floor      = TOX_FILE_ADAPTIVE_FLOOR;
+
+    self->restores       = NULL;
+    self->restores_index = 0;
+    self->restores_count = 0;
+
+    self->coalesce       = NULL;
+    self->coalesce_index = 0;
+    self->coalesce_count = 0;
+    self->coalesce_size  = 0;
+
     if (init_helper(self, NULL) == -1)
         return NULL;
 
@@ -3346,6 +6773,12 @@ void ToxCore_install_dict(void)
     SET(TOX_RECVFILE_COMPLETED);
     SET(TOX_RECVFILE_TIMEOUT);
     SET(TOX_RECVFILE_ERROR);
+    SET(TOX_RECVFILE_CORRUPTED);
+    SET(TOX_RECVFILE_CACHED);
+
+    // non-api for tox_sendqueue
+    SET(TOX_SENDQUEUE_STARTED);
+    SET(TOX_SENDQUEUE_ERROR);
 
 #undef SET
 
@@ -23,30 +23,187 @@
 #include "pytox.h"
 //----------------------------------------------------------------------------------------------
 typedef struct {
-    int      fd;
+    uint8_t* data;
+    size_t   size;
     char*    path;
     size_t   path_len;
-    uint8_t* filename;
-    size_t   filename_len;
+    uint8_t  hash[TOX_HASH_LENGTH];
+    size_t   refs;
+} ToxBlob;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    uint64_t bytes;
+    uint64_t chunks;
+    uint64_t seeks;
+    double   start;
+    double   last;
+    double   rate;
+} ToxFileStats;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    uint64_t rate;
+    uint64_t burst;
+    double   tokens;
+    double   stamp;
+} ToxFileLimit;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    struct ToxFile* head;
+    struct ToxFile* tail;
+    size_t          count;
+} ToxFileLru;
+//----------------------------------------------------------------------------------------------
+typedef struct ToxFile {
+    int          fd;
+    int          fd_flags;
+    ToxFileLru*  fd_lru;
+    struct ToxFile* fd_prev;
+    struct ToxFile* fd_next;
+    ToxBlob*     blob;
+    Py_buffer*   view;
+    uint8_t*     memory;
+    PyObject*    stream;
+    PyObject*    block;
+    uint64_t     block_position;
+    size_t       block_len;
+    uint64_t     stream_base;
+    bool         stream_eof;
+    char*        path;
+    size_t       path_len;
+    uint8_t*     filename;
+    size_t       filename_len;
+    uint64_t     offset;
+    uint64_t     size;
+    time_t       checkpoint;
+    time_t       timeout;
+    uint32_t     friend_number;
+    uint32_t     file_number;
+    uint32_t     kind;
+    ToxFileStats stats;
+    double       gap_avg;
+    double       gap_dev;
+    uint64_t     deferred_position;
+    uint64_t     deferred_length;
+    size_t       deferred_chunk;
+    bool         paused;
+    bool         remote_paused;
+    uint32_t     job_id;
+    int32_t      priority;
+    bool         preempted;
+    uint8_t*     pipe_buffer;
+    size_t       pipe_len;
+    bool         pipe_eof;
+    bool         pipe_wait;
+    uint64_t     pending_length;
+    size_t       pending_chunk;
+    crypto_hash_sha256_state* hash;
+    uint64_t     hash_offset;
+    bool         verify;
+    bool         cacheable;
+    uint8_t      file_id[TOX_FILE_ID_LENGTH];
+} ToxFile;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    ToxFile**    files;
+    size_t       index;
+    size_t       count;
+    ToxFileStats stats;
+} ToxFileBucket;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    uint32_t friend_number;
+    uint32_t file_number;
+    uint8_t  file_id[TOX_FILE_ID_LENGTH];
+} ToxFileAnnounce;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    bool     send;
+    uint32_t kind;
+    uint8_t  public_key[TOX_PUBLIC_KEY_SIZE];
+    uint8_t  file_id[TOX_FILE_ID_LENGTH];
     uint64_t offset;
     uint64_t size;
-    time_t   checkpoint;
-    time_t   timeout;
+    uint32_t timeout;
+    char*    path;
+    size_t   path_len;
+    uint8_t* filename;
+    size_t   filename_len;
+    time_t   expires;
+} ToxFileRestore;
+//----------------------------------------------------------------------------------------------
+typedef struct {
     uint32_t friend_number;
     uint32_t file_number;
-} ToxFile;
+    uint64_t position;
+    uint8_t* data;
+    size_t   len;
+    time_t   checkpoint;
+} ToxFileCoalesce;
 //----------------------------------------------------------------------------------------------
 typedef struct {
-    ToxFile** files;
-    size_t    index;
-    size_t    count;
-} ToxFileBucket;
+    uint8_t  file_id[TOX_FILE_ID_LENGTH];
+    uint64_t size;
+    time_t   used;
+} ToxFileCacheEntry;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    uint32_t job_id;
+    uint32_t friend_number;
+    uint32_t kind;
+    char*    path;
+    size_t   path_len;
+    uint8_t* filename;
+    size_t   filename_len;
+    uint32_t timeout;
+} ToxFileJob;
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    ToxFileJob* jobs;
+    size_t      index;
+    size_t      count;
+    size_t      friend_limit;
+    size_t      total_limit;
+    uint32_t    next_job_id;
+    size_t      last_index;
+    time_t      checkpoint;
+    bool        dirty;
+} ToxFileQueue;
 //----------------------------------------------------------------------------------------------
 typedef struct {
     PyObject_HEAD
     Tox*          tox;
     ToxFileBucket send_files;
     ToxFileBucket recv_files;
+    ToxBlob*      avatar;
+    ToxFileLimit  send_limit;
+    ToxFileLimit* friend_limits;
+    size_t        friend_limits_count;
+    ToxFileQueue  send_queue;
+    uint32_t      priority_budget;
+    size_t        priority_index;
+    time_t        priority_checkpoint;
+    bool          priority_dirty;
+    char*         cache_path;
+    size_t        cache_path_len;
+    uint64_t      cache_limit;
+    ToxFileCacheEntry* cache_entries;
+    size_t        cache_index;
+    size_t        cache_count;
+    uint64_t      cache_total;
+    double        timeout_multiplier;
+    uint32_t      timeout_floor;
+    ToxFileRestore* restores;
+    size_t        restores_index;
+    size_t        restores_count;
+    ToxFileCoalesce* coalesce;
+    size_t        coalesce_index;
+    size_t        coalesce_count;
+    size_t        coalesce_size;
+    size_t        fd_limit;
+    ToxFileLru    fd_lru;
+    ToxFileAnnounce* avatar_announces;
+    size_t        avatar_announces_index;
+    size_t        avatar_announces_count;
 } ToxCore;
 //----------------------------------------------------------------------------------------------
 extern PyTypeObject ToxCoreType;
@@ -1,10 +1,46 @@
+import os
 import sys
-from distutils.core import setup, Extension
+from distutils.core import setup, Extension, Command
+from distutils.ccompiler import new_compiler
+from distutils.sysconfig import customize_compiler
+from distutils.errors import DistutilsExecError
 
 libraries = ["toxcore", "toxav", "toxdns", "sodium", "vpx", "opus"]
 
 if sys.platform != "darwin":
     libraries.append("rt")
+    libraries.append("m")
+
+class colortest(Command):
+    description  = "build and run color conversion kernels check"
+    user_options = [("benchmark=", "b", "report single thread throughput over given iterations")]
+
+    def initialize_options(self):
+        self.benchmark = None
+
+    def finalize_options(self):
+        if self.benchmark is not None:
+            self.benchmark = str(int(self.benchmark))
+
+    def run(self):
+        compiler = new_compiler()
+        customize_compiler(compiler)
+
+        objects = compiler.compile(
+            ["tests/colortest.c", "tests/colorbench.c", "pytoxcolor.c"],
+            output_dir         = "build",
+            include_dirs       = ["."],
+            extra_preargs      = ["-O2"],
+            extra_postargs     = ["-Wall", "-Werror", "-Wno-declaration-after-statement"]
+        )
+
+        program = os.path.join("build", "colortest")
+        compiler.link_executable(objects, "colortest", output_dir = "build", libraries = ["pthread", "m"])
+
+        args = [program] + ([self.benchmark] if self.benchmark is not None else [])
+        if os.spawnv(os.P_WAIT, program, args) != 0:
+            raise DistutilsExecError("colortest failed")
+
 
 setup(
     name         = "pytoxcore",
@@ -14,10 +50,11 @@ setup(
     author_email = "antonbatenev@yandex.ru",
     url          = "http://github.com/abbat/pytoxcore",
     license      = "GPL",
+    cmdclass     = {"colortest": colortest},
     ext_modules  = [
         Extension(
             "pytoxcore",
-            sources            = ["pytox.c", "pytoxcore.c", "pytoxav.c", "pytoxdns.c"],
+            sources            = ["pytox.c", "pytoxcore.c", "pytoxav.c", "pytoxcolor.c", "pytoxdns.c"],
             define_macros      = [],
             include_dirs       = ["/usr/tox/include"],
             library_dirs       = ["/usr/tox/lib"],
@@ -0,0 +1,249 @@
+/**
+ * pytoxcore
+ *
+ * Copyright (C) 2015 Anton Batenev <antonbatenev@yandex.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+//----------------------------------------------------------------------------------------------
+/*
+ * Accuracy and throughput of a single kernel over a synthetic frame, built only into colortest.
+ * Conversions go through the public API, so the caller picks the conversion pool setting.
+ */
+//----------------------------------------------------------------------------------------------
+#include "colorbench.h"
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/param.h>
+//----------------------------------------------------------------------------------------------
+
+static double colorbench_clamp(double x)
+{
+    return x > 255.0 ? 255.0 : x < 0.0 ? 0.0 : x;
+}
+//----------------------------------------------------------------------------------------------
+
+static double colorbench_psnr(double sse, uint64_t count)
+{
+    if (sse == 0.0)
+        return INFINITY;
+
+    return 10.0 * log10(255.0 * 255.0 * count / sse);
+}
+//----------------------------------------------------------------------------------------------
+
+static double colorbench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+//----------------------------------------------------------------------------------------------
+
+static double colorbench_mpix(uint32_t width, uint32_t height, uint32_t iterations, double elapsed)
+{
+    return (elapsed > 0 ? (double)width * height * iterations / elapsed / 1e6 : 0);
+}
+//----------------------------------------------------------------------------------------------
+
+static void colorbench_pattern(uint8_t* bgr, uint32_t width, uint32_t height)
+{
+    // gradients with hard edges and a noise band to exercise clamping and chroma averaging
+    uint32_t seed = 0x9E3779B9;
+
+    uint32_t i;
+    uint32_t j;
+    for (i = 0; i < height; i++)
+        for (j = 0; j < width; j++) {
+            uint8_t* p = bgr + 3 * ((size_t)i * width + j);
+
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+
+            if (i < height / 4) {
+                p[0] = seed;
+                p[1] = seed >> 8;
+                p[2] = seed >> 16;
+            } else {
+                p[0] = (j * 255) / MAX(width - 1, 1);
+                p[1] = (i * 255) / MAX(height - 1, 1);
+                p[2] = ((i / 8 + j / 8) & 1) ? 255 : ((i + j) & 0xFF);
+            }
+        }
+}
+//----------------------------------------------------------------------------------------------
+
+/**
+ * Double precision BT.601 encode of the frame compared with planes converted by a kernel.
+ */
+static double colorbench_yuv420_sse(const uint8_t* bgr, uint32_t width, uint32_t height, const uint8_t* y, const uint8_t* u, const uint8_t* v, uint64_t* count)
+{
+    double sse = 0.0;
+
+    uint32_t i;
+    uint32_t j;
+    for (i = 0; i < height; i++)
+        for (j = 0; j < width; j++) {
+            const uint8_t* p = bgr + 3 * ((size_t)i * width + j);
+
+            double d = colorbench_clamp(0.299 * p[2] + 0.587 * p[1] + 0.114 * p[0]) - y[(size_t)i * width + j];
+            sse += d * d;
+        }
+
+    uint32_t cw = (width + 1) / 2;
+    uint32_t ch = (height + 1) / 2;
+
+    for (i = 0; i < ch; i++)
+        for (j = 0; j < cw; j++) {
+            double r = 0.0;
+            double g = 0.0;
+            double b = 0.0;
+            int    n = 0;
+
+            uint32_t di;
+            uint32_t dj;
+            for (di = 2 * i; di < MIN(2 * i + 2, height); di++)
+                for (dj = 2 * j; dj < MIN(2 * j + 2, width); dj++) {
+                    const uint8_t* p = bgr + 3 * ((size_t)di * width + dj);
+
+                    b += p[0];
+                    g += p[1];
+                    r += p[2];
+                    n++;
+                }
+
+            r /= n;
+            g /= n;
+            b /= n;
+
+            double du = colorbench_clamp(-0.168736 * r - 0.331264 * g + 0.5 * b + 128.0) - u[(size_t)i * cw + j];
+            double dv = colorbench_clamp(0.5 * r - 0.418688 * g - 0.081312 * b + 128.0) - v[(size_t)i * cw + j];
+
+            sse += du * du + dv * dv;
+        }
+
+    *count = (uint64_t)width * height + 2 * (uint64_t)cw * ch;
+
+    return sse;
+}
+//----------------------------------------------------------------------------------------------
+
+/**
+ * Double precision BT.601 (studio swing) decode of the planes compared with pixels converted
+ * by a kernel.
+ */
+static double colorbench_rgb_sse(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t width, uint32_t height, const uint8_t* bgr, uint64_t* count)
+{
+    double sse = 0.0;
+
+    uint32_t cw = (width + 1) / 2;
+
+    uint32_t i;
+    uint32_t j;
+    for (i = 0; i < height; i++)
+        for (j = 0; j < width; j++) {
+            const uint8_t* p = bgr + 3 * ((size_t)i * width + j);
+
+            double l  = 1.164383 * (MAX(y[(size_t)i * width + j], 16) - 16);
+            double cu = u[(size_t)(i / 2) * cw + j / 2] - 128.0;
+            double cv = v[(size_t)(i / 2) * cw + j / 2] - 128.0;
+
+            double db = colorbench_clamp(l + 2.017232 * cu) - p[0];
+            double dg = colorbench_clamp(l - 0.391762 * cu - 0.812968 * cv) - p[1];
+            double dr = colorbench_clamp(l + 1.596027 * cv) - p[2];
+
+            sse += db * db + dg * dg + dr * dr;
+        }
+
+    *count = 3 * (uint64_t)width * height;
+
+    return sse;
+}
+//----------------------------------------------------------------------------------------------
+
+bool colorbench_run(const ToxColorKernel* kernel, uint32_t width, uint32_t height, uint32_t iterations, ColorBenchResult* result)
+{
+    bool success = false;
+
+    uint32_t cw     = (width + 1) / 2;
+    uint32_t ch     = (height + 1) / 2;
+    size_t   pixels = (size_t)width * height;
+    uint8_t* bgr    = calloc(pixels, 3);
+    uint8_t* pack   = malloc(3 * pixels);
+    uint8_t* yuv    = malloc(pixels + 2 * (size_t)cw * ch);
+
+    if (bgr == NULL || pack == NULL || yuv == NULL)
+        goto EXIT;
+
+    uint8_t* u = yuv + pixels;
+    uint8_t* v = u + (size_t)cw * ch;
+
+    colorbench_pattern(bgr, width, height);
+
+    uint64_t samples;
+    double   sse;
+
+    toxcolor_to_yuv420(kernel, TOXCOLOR_FORMAT_BGR, width, height, bgr, 3 * width, yuv, u, v, width, cw, cw);
+
+    sse = colorbench_yuv420_sse(bgr, width, height, yuv, u, v, &samples);
+    result->yuv420_psnr = colorbench_psnr(sse, samples);
+
+    toxcolor_from_yuv420(kernel, TOXCOLOR_FORMAT_BGR, width, height, yuv, u, v, width, cw, cw, pack, 3 * width);
+
+    sse = colorbench_rgb_sse(yuv, u, v, width, height, pack, &samples);
+    result->rgb_psnr = colorbench_psnr(sse, samples);
+
+    result->yuv420_mpix = 0;
+    result->rgb_mpix    = 0;
+    result->scale_mpix  = 0;
+
+    if (iterations > 0) {
+        uint32_t i;
+
+        double started = colorbench_now();
+        for (i = 0; i < iterations; i++)
+            toxcolor_to_yuv420(kernel, TOXCOLOR_FORMAT_BGR, width, height, bgr, 3 * width, yuv, u, v, width, cw, cw);
+        result->yuv420_mpix = colorbench_mpix(width, height, iterations, colorbench_now() - started);
+
+        started = colorbench_now();
+        for (i = 0; i < iterations; i++)
+            toxcolor_from_yuv420(kernel, TOXCOLOR_FORMAT_BGR, width, height, yuv, u, v, width, cw, cw, pack, 3 * width);
+        result->rgb_mpix = colorbench_mpix(width, height, iterations, colorbench_now() - started);
+
+        // scaled planes fit into the full size ones
+        uint32_t sw  = MAX(3 * width / 4, 1);
+        uint32_t sh  = MAX(3 * height / 4, 1);
+        uint32_t scw = (sw + 1) / 2;
+
+        started = colorbench_now();
+        for (i = 0; i < iterations; i++)
+            if (toxcolor_scale_to_yuv420(kernel, TOXCOLOR_FORMAT_BGR, width, height, bgr, 3 * width, sw, sh, yuv, u, v, sw, scw, scw) == false)
+                goto EXIT;
+        result->scale_mpix = colorbench_mpix(width, height, iterations, colorbench_now() - started);
+    }
+
+    success = true;
+
+EXIT:
+
+    free(bgr);
+    free(pack);
+    free(yuv);
+
+    return success;
+}
+//----------------------------------------------------------------------------------------------
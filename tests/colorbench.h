@@ -0,0 +1,36 @@
+/**
+ * pytoxcore
+ *
+ * Copyright (C) 2015 Anton Batenev <antonbatenev@yandex.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+//----------------------------------------------------------------------------------------------
+#ifndef _colorbench_h_
+#define _colorbench_h_
+//----------------------------------------------------------------------------------------------
+#include "pytoxcolor.h"
+//----------------------------------------------------------------------------------------------
+typedef struct {
+    double yuv420_psnr;    // BGR to YUV420 against double precision reference, dB
+    double rgb_psnr;       // YUV420 to BGR against double precision reference, dB
+    double yuv420_mpix;    // BGR to YUV420 throughput, Mpix/s
+    double rgb_mpix;       // YUV420 to BGR throughput, Mpix/s
+    double scale_mpix;     // BGR scaled to 3/4 into YUV420 throughput, source Mpix/s
+} ColorBenchResult;
+//----------------------------------------------------------------------------------------------
+bool colorbench_run(const ToxColorKernel* kernel, uint32_t width, uint32_t height, uint32_t iterations, ColorBenchResult* result);
+//----------------------------------------------------------------------------------------------
+#endif   // _colorbench_h_
+//----------------------------------------------------------------------------------------------
@@ -0,0 +1,463 @@
+/**
+ * pytoxcore
+ *
+ * Copyright (C) 2015 Anton Batenev <antonbatenev@yandex.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+//----------------------------------------------------------------------------------------------
+/*
+ * Color conversion kernels check. Every kernel supported by the CPU must match the scalar
+ * reference bit for bit over odd sizes and padded rows, must not write past row ends, must give
+ * the same planes for swapped channel orders and must stay above PSNR floor against double
+ * precision BT.601 at common frame sizes. Exit status is non-zero on failure. Given iterations,
+ * single thread throughput of every kernel at the same frame sizes is reported too.
+ *
+ *   python setup.py colortest [--benchmark=iterations]
+ */
+//----------------------------------------------------------------------------------------------
+#include "pytoxcolor.h"
+#include "colorbench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+//----------------------------------------------------------------------------------------------
+#define COLORTEST_PAD        13     // bytes past the end of every source and destination row
+#define COLORTEST_FILL       0xA5   // destination fill, must survive in row padding
+#define COLORTEST_PSNR_FLOOR 40.0   // dB, both directions over the synthetic pattern
+//----------------------------------------------------------------------------------------------
+static const uint32_t colortest_sizes[][2] = {
+    {    1,   1 }, {   2,   2 }, {   3,   5 }, {   5,   3 }, {  17,   9 }, {  31,   3 },
+    {   33,  17 }, {  63,   5 }, {  65,   7 }, {  97,   9 }, { 101,  77 }, { 130,   4 },
+    {   11,  40 }, { 640, 480 }, { 641, 361 }
+};
+//----------------------------------------------------------------------------------------------
+static const uint32_t colortest_bench_sizes[][2] = {
+    {  320, 240 }, {  640,  480 }, { 1280, 720 }, { 1920, 1080 }, { 641, 361 }
+};
+//----------------------------------------------------------------------------------------------
+static const char* colortest_formats[TOXCOLOR_FORMAT_COUNT] = { "bgr", "rgb", "bgra", "rgba", "yuyv" };
+//----------------------------------------------------------------------------------------------
+static size_t colortest_failures = 0;
+//----------------------------------------------------------------------------------------------
+
+static void colortest_random(uint8_t* data, size_t size)
+{
+    static uint32_t state = 2463534242u;
+
+    size_t i;
+    for (i = 0; i < size; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        data[i] = (uint8_t)state;
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static void colortest_check(bool condition, const ToxColorKernel* kernel, uint32_t width, uint32_t height, const char* what, const char* format)
+{
+    if (condition == true)
+        return;
+
+    printf("FAIL %s %ux%u %s %s\n", kernel->name, width, height, what, (format != NULL ? format : ""));
+
+    colortest_failures++;
+}
+//----------------------------------------------------------------------------------------------
+
+static bool colortest_padding(const uint8_t* data, uint32_t rows, size_t stride, size_t used)
+{
+    uint32_t i;
+    size_t   j;
+    for (i = 0; i < rows; i++)
+        for (j = used; j < stride; j++)
+            if (data[i * stride + j] != COLORTEST_FILL)
+                return false;
+
+    return true;
+}
+//----------------------------------------------------------------------------------------------
+
+/**
+ * Y, U and V planes with padded rows, each chroma plane with its own stride.
+ */
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t ystride;
+    uint32_t ustride;
+    uint32_t vstride;
+    uint8_t* y;
+    uint8_t* u;
+    uint8_t* v;
+    size_t   size;
+} ColorTestPlanes;
+//----------------------------------------------------------------------------------------------
+
+static bool colortest_planes_alloc(ColorTestPlanes* planes, uint32_t width, uint32_t height)
+{
+    uint32_t cw = (width + 1) / 2;
+    uint32_t ch = (height + 1) / 2;
+
+    planes->width   = width;
+    planes->height  = height;
+    planes->ystride = width + COLORTEST_PAD;
+    planes->ustride = cw + COLORTEST_PAD;
+    planes->vstride = cw + COLORTEST_PAD + 3;
+    planes->size    = (size_t)planes->ystride * height + (size_t)planes->ustride * ch + (size_t)planes->vstride * ch;
+
+    planes->y = malloc(planes->size);
+    if (planes->y == NULL)
+        return false;
+
+    planes->u = planes->y + (size_t)planes->ystride * height;
+    planes->v = planes->u + (size_t)planes->ustride * ch;
+
+    memset(planes->y, COLORTEST_FILL, planes->size);
+
+    return true;
+}
+//----------------------------------------------------------------------------------------------
+
+static bool colortest_planes_padding(const ColorTestPlanes* planes)
+{
+    uint32_t cw = (planes->width + 1) / 2;
+    uint32_t ch = (planes->height + 1) / 2;
+
+    return colortest_padding(planes->y, planes->height, planes->ystride, planes->width) &&
+           colortest_padding(planes->u, ch, planes->ustride, cw) &&
+           colortest_padding(planes->v, ch, planes->vstride, cw);
+}
+//----------------------------------------------------------------------------------------------
+
+static void colortest_packed(const ToxColorKernel* kernel, const ToxColorKernel* reference, uint32_t width, uint32_t height)
+{
+    ColorTestPlanes planes     = { 0 };
+    ColorTestPlanes planes_ref = { 0 };
+
+    size_t   stride  = 4 * (size_t)width + COLORTEST_PAD;
+    uint8_t* src     = malloc(stride * height);
+    uint8_t* dst     = malloc(stride * height);
+    uint8_t* dst_ref = malloc(stride * height);
+
+    if (src == NULL || dst == NULL || dst_ref == NULL || colortest_planes_alloc(&planes, width, height) == false || colortest_planes_alloc(&planes_ref, width, height) == false) {
+        colortest_check(false, kernel, width, height, "allocation", NULL);
+        goto EXIT;
+    }
+
+    int format;
+    for (format = 0; format < TOXCOLOR_FORMAT_COUNT; format++) {
+        const char* name  = colortest_formats[format];
+        size_t      bpp   = toxcolor_format_bpp(format);
+        size_t      row   = bpp * width;
+        size_t      pitch = row + COLORTEST_PAD;
+
+        // YUYV pixel pairs share chroma, odd width is rejected before conversion
+        if (format == TOXCOLOR_FORMAT_YUYV && width % 2 != 0)
+            continue;
+
+        colortest_random(src, pitch * height);
+
+        memset(planes.y, COLORTEST_FILL, planes.size);
+        memset(planes_ref.y, COLORTEST_FILL, planes_ref.size);
+
+        toxcolor_to_yuv420(kernel,    format, width, height, src, pitch, planes.y,     planes.u,     planes.v,     planes.ystride,     planes.ustride,     planes.vstride);
+        toxcolor_to_yuv420(reference, format, width, height, src, pitch, planes_ref.y, planes_ref.u, planes_ref.v, planes_ref.ystride, planes_ref.ustride, planes_ref.vstride);
+
+        colortest_check(memcmp(planes.y, planes_ref.y, planes.size) == 0, kernel, width, height, "to_yuv420", name);
+        colortest_check(colortest_planes_padding(&planes), kernel, width, height, "to_yuv420 padding", name);
+
+        // YUYV is encode only and can not be scaled
+        if (reference->from_yuv420[format] == NULL)
+            continue;
+
+        memset(dst, COLORTEST_FILL, stride * height);
+        memset(dst_ref, COLORTEST_FILL, stride * height);
+
+        toxcolor_from_yuv420(kernel,    format, width, height, planes_ref.y, planes_ref.u, planes_ref.v, planes_ref.ystride, planes_ref.ustride, planes_ref.vstride, dst,     pitch);
+        toxcolor_from_yuv420(reference, format, width, height, planes_ref.y, planes_ref.u, planes_ref.v, planes_ref.ystride, planes_ref.ustride, planes_ref.vstride, dst_ref, pitch);
+
+        colortest_check(memcmp(dst, dst_ref, stride * height) == 0, kernel, width, height, "from_yuv420", name);
+        colortest_check(colortest_padding(dst, height, pitch, row), kernel, width, height, "from_yuv420 padding", name);
+
+        // 3/4 both ways, 2/3 horizontally and 3/4 vertically only, covering blend and resample rows
+        const uint32_t scales[][2] = {
+            { MAX(3 * width / 4, 1), MAX(3 * height / 4, 1) },
+            { MAX(2 * width / 3, 1), height },
+            { width, MAX(3 * height / 4, 1) }
+        };
+
+        size_t i;
+        for (i = 0; i < sizeof(scales) / sizeof(scales[0]); i++) {
+            ColorTestPlanes scaled     = { 0 };
+            ColorTestPlanes scaled_ref = { 0 };
+
+            if (colortest_planes_alloc(&scaled, scales[i][0], scales[i][1]) == false || colortest_planes_alloc(&scaled_ref, scales[i][0], scales[i][1]) == false) {
+                colortest_check(false, kernel, width, height, "allocation", NULL);
+                free(scaled.y);
+                free(scaled_ref.y);
+                break;
+            }
+
+            bool result     = toxcolor_scale_to_yuv420(kernel,    format, width, height, src, pitch, scaled.width,     scaled.height,     scaled.y,     scaled.u,     scaled.v,     scaled.ystride,     scaled.ustride,     scaled.vstride);
+            bool result_ref = toxcolor_scale_to_yuv420(reference, format, width, height, src, pitch, scaled_ref.width, scaled_ref.height, scaled_ref.y, scaled_ref.u, scaled_ref.v, scaled_ref.ystride, scaled_ref.ustride, scaled_ref.vstride);
+
+            colortest_check(result == true && result_ref == true, kernel, width, height, "scale_to_yuv420 result", name);
+            colortest_check(memcmp(scaled.y, scaled_ref.y, scaled.size) == 0, kernel, width, height, "scale_to_yuv420", name);
+            colortest_check(colortest_planes_padding(&scaled), kernel, width, height, "scale_to_yuv420 padding", name);
+
+            free(scaled.y);
+            free(scaled_ref.y);
+        }
+    }
+
+EXIT:
+
+    free(src);
+    free(dst);
+    free(dst_ref);
+    free(planes.y);
+    free(planes_ref.y);
+}
+//----------------------------------------------------------------------------------------------
+
+static void colortest_planar(const ToxColorKernel* kernel, const ToxColorKernel* reference, uint32_t width, uint32_t height)
+{
+    ColorTestPlanes planes     = { 0 };
+    ColorTestPlanes planes_ref = { 0 };
+
+    uint32_t cw = (width + 1) / 2;
+
+    // NV12 luma and interleaved chroma, I422 full height chroma, all rows padded
+    size_t   ypitch  = width + COLORTEST_PAD;
+    size_t   uvpitch = 2 * (size_t)cw + COLORTEST_PAD;
+    size_t   cpitch  = cw + COLORTEST_PAD;
+    uint8_t* ysrc    = malloc(ypitch * height);
+    uint8_t* uvsrc   = malloc(uvpitch * height);
+    uint8_t* usrc    = malloc(cpitch * height);
+    uint8_t* vsrc    = malloc(cpitch * height);
+
+    if (ysrc == NULL || uvsrc == NULL || usrc == NULL || vsrc == NULL || colortest_planes_alloc(&planes, width, height) == false || colortest_planes_alloc(&planes_ref, width, height) == false) {
+        colortest_check(false, kernel, width, height, "allocation", NULL);
+        goto EXIT;
+    }
+
+    colortest_random(ysrc, ypitch * height);
+    colortest_random(uvsrc, uvpitch * height);
+    colortest_random(usrc, cpitch * height);
+    colortest_random(vsrc, cpitch * height);
+
+    toxcolor_nv12_to_yuv420(kernel,    width, height, ysrc, uvsrc, ypitch, uvpitch, planes.y,     planes.u,     planes.v,     planes.ystride,     planes.ustride,     planes.vstride);
+    toxcolor_nv12_to_yuv420(reference, width, height, ysrc, uvsrc, ypitch, uvpitch, planes_ref.y, planes_ref.u, planes_ref.v, planes_ref.ystride, planes_ref.ustride, planes_ref.vstride);
+
+    colortest_check(memcmp(planes.y, planes_ref.y, planes.size) == 0, kernel, width, height, "nv12_to_yuv420", NULL);
+    colortest_check(colortest_planes_padding(&planes), kernel, width, height, "nv12_to_yuv420 padding", NULL);
+
+    memset(planes.y, COLORTEST_FILL, planes.size);
+    memset(planes_ref.y, COLORTEST_FILL, planes_ref.size);
+
+    toxcolor_i422_to_yuv420(kernel,    width, height, ysrc, usrc, vsrc, ypitch, cpitch, cpitch, planes.y,     planes.u,     planes.v,     planes.ystride,     planes.ustride,     planes.vstride);
+    toxcolor_i422_to_yuv420(reference, width, height, ysrc, usrc, vsrc, ypitch, cpitch, cpitch, planes_ref.y, planes_ref.u, planes_ref.v, planes_ref.ystride, planes_ref.ustride, planes_ref.vstride);
+
+    colortest_check(memcmp(planes.y, planes_ref.y, planes.size) == 0, kernel, width, height, "i422_to_yuv420", NULL);
+    colortest_check(colortest_planes_padding(&planes), kernel, width, height, "i422_to_yuv420 padding", NULL);
+
+EXIT:
+
+    free(ysrc);
+    free(uvsrc);
+    free(usrc);
+    free(vsrc);
+    free(planes.y);
+    free(planes_ref.y);
+}
+//----------------------------------------------------------------------------------------------
+
+/**
+ * RGB input is BGR with R and B swapped, both orders must give the same planes.
+ */
+static void colortest_swapped(const ToxColorKernel* kernel, uint32_t width, uint32_t height)
+{
+    ColorTestPlanes planes     = { 0 };
+    ColorTestPlanes planes_ref = { 0 };
+
+    size_t   pitch   = 4 * (size_t)width + COLORTEST_PAD;
+    uint8_t* src     = malloc(pitch * height);
+    uint8_t* swapped = malloc(pitch * height);
+
+    if (src == NULL || swapped == NULL || colortest_planes_alloc(&planes, width, height) == false || colortest_planes_alloc(&planes_ref, width, height) == false) {
+        colortest_check(false, kernel, width, height, "allocation", NULL);
+        goto EXIT;
+    }
+
+    const TOXCOLOR_FORMAT pairs[][2] = {
+        { TOXCOLOR_FORMAT_BGR,  TOXCOLOR_FORMAT_RGB  },
+        { TOXCOLOR_FORMAT_BGRA, TOXCOLOR_FORMAT_RGBA }
+    };
+
+    size_t i;
+    for (i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+        size_t bpp = toxcolor_format_bpp(pairs[i][0]);
+
+        colortest_random(src, pitch * height);
+        memcpy(swapped, src, pitch * height);
+
+        uint32_t row;
+        uint32_t col;
+        for (row = 0; row < height; row++)
+            for (col = 0; col < width; col++) {
+                uint8_t* p = swapped + row * pitch + col * bpp;
+                uint8_t  b = p[0];
+
+                p[0] = p[2];
+                p[2] = b;
+            }
+
+        memset(planes.y, COLORTEST_FILL, planes.size);
+        memset(planes_ref.y, COLORTEST_FILL, planes_ref.size);
+
+        toxcolor_to_yuv420(kernel, pairs[i][1], width, height, swapped, pitch, planes.y,     planes.u,     planes.v,     planes.ystride,     planes.ustride,     planes.vstride);
+        toxcolor_to_yuv420(kernel, pairs[i][0], width, height, src,     pitch, planes_ref.y, planes_ref.u, planes_ref.v, planes_ref.ystride, planes_ref.ustride, planes_ref.vstride);
+
+        colortest_check(memcmp(planes.y, planes_ref.y, planes.size) == 0, kernel, width, height, "swapped to_yuv420", colortest_formats[pairs[i][1]]);
+    }
+
+EXIT:
+
+    free(src);
+    free(swapped);
+    free(planes.y);
+    free(planes_ref.y);
+}
+//----------------------------------------------------------------------------------------------
+
+static void colortest_accuracy(const ToxColorKernel* kernel)
+{
+    size_t i;
+    for (i = 0; i < sizeof(colortest_bench_sizes) / sizeof(colortest_bench_sizes[0]); i++) {
+        uint32_t width  = colortest_bench_sizes[i][0];
+        uint32_t height = colortest_bench_sizes[i][1];
+
+        ColorBenchResult report;
+
+        // synthetic pattern: noise band, gradients and hard edges
+        if (colorbench_run(kernel, width, height, 0, &report) == false) {
+            colortest_check(false, kernel, width, height, "allocation", NULL);
+            continue;
+        }
+
+        colortest_check(report.yuv420_psnr >= COLORTEST_PSNR_FLOOR, kernel, width, height, "yuv420 psnr", NULL);
+        colortest_check(report.rgb_psnr >= COLORTEST_PSNR_FLOOR, kernel, width, height, "rgb psnr", NULL);
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+static void colortest_report(const ToxColorKernel* kernels, size_t count, uint32_t iterations)
+{
+    size_t i;
+    for (i = 0; i < sizeof(colortest_bench_sizes) / sizeof(colortest_bench_sizes[0]); i++) {
+        uint32_t width  = colortest_bench_sizes[i][0];
+        uint32_t height = colortest_bench_sizes[i][1];
+
+        printf("\n%ux%u, %u iterations, single thread\n", width, height, iterations);
+        printf("%-8s %12s %12s %12s %12s %12s\n", "kernel", "yuv420 dB", "rgb dB", "yuv420 Mpx/s", "rgb Mpx/s", "scale Mpx/s");
+
+        size_t j;
+        for (j = 0; j < count; j++) {
+            if (kernels[j].supported() == false) {
+                printf("%-8s %12s\n", kernels[j].name, "unsupported");
+                continue;
+            }
+
+            ColorBenchResult report;
+
+            if (colorbench_run(&kernels[j], width, height, iterations, &report) == false) {
+                colortest_check(false, &kernels[j], width, height, "allocation", NULL);
+                continue;
+            }
+
+            printf("%-8s %12.2f %12.2f %12.1f %12.1f %12.1f%s\n", kernels[j].name, report.yuv420_psnr, report.rgb_psnr,
+                report.yuv420_mpix, report.rgb_mpix, report.scale_mpix, (&kernels[j] == toxcolor_kernel ? " *" : ""));
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    if (argc != 1 && argc != 2) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 2;
+    }
+
+    toxcolor_init();
+
+    size_t count;
+    const ToxColorKernel* kernels   = toxcolor_kernels(&count);
+    const ToxColorKernel* reference = kernels + count - 1;
+
+    // banded pool conversion must not change a single byte either
+    int pass;
+    for (pass = 0; pass < 2; pass++) {
+        if (toxcolor_threads_set(pass == 0 ? 0 : 3, 0) == false) {
+            printf("FAIL conversion threads\n");
+            return 1;
+        }
+
+        size_t i;
+        for (i = 0; i < count; i++) {
+            if (kernels[i].supported() == false) {
+                if (pass == 0)
+                    printf("skip %s: not supported by CPU\n", kernels[i].name);
+                continue;
+            }
+
+            size_t j;
+            for (j = 0; j < sizeof(colortest_sizes) / sizeof(colortest_sizes[0]); j++) {
+                colortest_packed(&kernels[i], reference, colortest_sizes[j][0], colortest_sizes[j][1]);
+                colortest_planar(&kernels[i], reference, colortest_sizes[j][0], colortest_sizes[j][1]);
+                colortest_swapped(&kernels[i], colortest_sizes[j][0], colortest_sizes[j][1]);
+            }
+
+            if (pass == 0)
+                colortest_accuracy(&kernels[i]);
+        }
+    }
+
+    toxcolor_threads_set(0, TOXCOLOR_POOL_THRESHOLD);
+
+    if (argc == 2) {
+        uint32_t iterations = strtoul(argv[1], NULL, 10);
+
+        if (iterations < 1) {
+            fprintf(stderr, "invalid iterations\n");
+            return 2;
+        }
+
+        colortest_report(kernels, count, iterations);
+    }
+
+    if (colortest_failures != 0) {
+        printf("%zu checks FAILED\n", colortest_failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+
+    return 0;
+}
+//----------------------------------------------------------------------------------------------